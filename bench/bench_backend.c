@@ -0,0 +1,157 @@
+// Measure the toggles per second and the edge events per second of the GPIO layer (see gpio.h).
+//
+// Build the program once per backend (cmake -DGPIOD_API=1 / -DGPIOD_API=2) and compare the results.
+//
+// On a Raspberry Pi, with the wiring of example 2 (GPIO16 -> GPIO21), the output line generates the input edges:
+//
+//     $ ./bench_backend -c gpiochip0 -o 16 -i 21
+//
+// On gpio-sim, the input edges are generated through the `pull` attribute of the simulated input line:
+//
+//     $ ./bench_backend -c gpiochip2 -o 16 -i 21 -s /sys/devices/platform/gpio-sim.0/gpiochip2/sim_gpio21/pull
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../gpio.h"
+#include "../gpio_sim.h"
+#include "../timing.h"
+
+#define EVENT_BUFFER_SIZE 64
+
+struct generator_args {
+    struct gpio_output *output;
+    int                sim_fd;
+    long               count;
+};
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+/**
+ * Generate `count` edges on the input line, as fast as possible.
+ */
+
+void* generator_thread(void *in_args) {
+    struct generator_args *args = (struct generator_args*)in_args;
+
+    for (long i=0; i<args->count; i++) {
+        int value = (i & 0x1) == 0;
+        int status = -1 != args->sim_fd ? gpio_sim_set(args->sim_fd, value)
+                                        : gpio_output_set_value(args->output, 0, value);
+        if (-1 == status) {
+            error("cannot generate an edge");
+        }
+    }
+    return NULL;
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s -c chip -o output -i input [-s pull] [-n count]\n", program);
+    fprintf(stderr, "  -s pull:  the gpio-sim `pull` attribute of the input line (default: loopback wiring).\n");
+    fprintf(stderr, "  -n count: the number of toggles and edges (default: 100000).\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *chip_name = NULL;
+    const char *pull_path = NULL;
+    unsigned int output_offset = 0, input_offset = 0;
+    int has_output = 0, has_input = 0;
+    long count = 100000;
+    int option;
+    struct gpio_chip *chip;
+    struct gpio_output *output;
+    struct gpio_input *input;
+    struct gpio_event events[EVENT_BUFFER_SIZE];
+    struct generator_args generator;
+    pthread_t thread;
+    int initial_value = 0;
+    long received = 0, batches = 0;
+    int64_t start, elapsed;
+
+    while (-1 != (option = getopt(argc, argv, "c:o:i:s:n:"))) {
+        switch (option) {
+            case 'c': chip_name = optarg; break;
+            case 'o': output_offset = (unsigned int)atoi(optarg); has_output = 1; break;
+            case 'i': input_offset = (unsigned int)atoi(optarg); has_input = 1; break;
+            case 's': pull_path = optarg; break;
+            case 'n': count = atol(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (NULL == chip_name || !has_output || !has_input || count < 1) {
+        usage(argv[0]);
+    }
+
+    chip = gpio_chip_open(chip_name);
+    if (NULL == chip) {
+        error("cannot open the chip");
+    }
+    output = gpio_output_request(chip, "bench", &output_offset, 1, &initial_value);
+    if (NULL == output) {
+        error("cannot request the output");
+    }
+    printf("Backend: %s\n", gpio_backend_name());
+
+    // Toggles.
+    start = timing_now();
+    for (long i=0; i<count; i++) {
+        if (-1 == gpio_output_set_value(output, 0, (i & 0x1) == 0)) {
+            error("cannot change the value of the output");
+        }
+    }
+    elapsed = timing_now() - start;
+    printf("toggles: %ld in %.3f s => %.0f toggles/s\n", count, (double)elapsed / NSEC_PER_SEC,
+           (double)count * NSEC_PER_SEC / (double)elapsed);
+    gpio_output_set_value(output, 0, 0);
+
+    // Events.
+    input = gpio_input_request(chip, "bench", &input_offset, 1, EVENT_BUFFER_SIZE);
+    if (NULL == input) {
+        error("cannot request the input");
+    }
+    generator.output = output;
+    generator.count  = count;
+    generator.sim_fd = -1;
+    if (NULL != pull_path && -1 == (generator.sim_fd = gpio_sim_open(pull_path))) {
+        error("cannot open the gpio-sim pull attribute");
+    }
+
+    start = timing_now();
+    if (0 != pthread_create(&thread, NULL, &generator_thread, &generator)) {
+        error("cannot create the generator thread");
+    }
+    while (received < count) {
+        int status = gpio_input_wait(input, NSEC_PER_SEC);
+        int read;
+
+        if (-1 == status) {
+            error("error while waiting for events");
+        }
+        if (0 == status) {
+            break; // No event for 1 second: the remaining edges have been lost.
+        }
+        if (-1 == (read = gpio_input_read(input, events, EVENT_BUFFER_SIZE))) {
+            error("error while reading events");
+        }
+        received += read;
+        batches++;
+    }
+    elapsed = timing_now() - start;
+    pthread_join(thread, NULL);
+    printf("events:  %ld/%ld in %.3f s => %.0f events/s, %.1f events per read, %ld lost\n",
+           received, count, (double)elapsed / NSEC_PER_SEC, (double)received * NSEC_PER_SEC / (double)elapsed,
+           batches > 0 ? (double)received / (double)batches : 0.0, count - received);
+
+    if (-1 != generator.sim_fd) {
+        close(generator.sim_fd);
+    }
+    gpio_input_release(input);
+    gpio_output_release(output);
+    gpio_chip_close(chip);
+    return 0;
+}
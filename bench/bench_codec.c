@@ -0,0 +1,226 @@
+// Measure the compression ratio and the speed of the event codec (see event_codec.h).
+//
+//     $ ./bench_codec [journal...]
+//
+// With journals (recorded by `gpio2 -J`), each journal is encoded. Otherwise, the program generates synthetic
+// traces shaped like the output of gpio1 (two LEDs blinking at 2 Hz and 3 Hz) and gpio2 (a line toggled every
+// 100 us, and the edges seen on the loopback line 60 us later), with a jitter of a few micro seconds.
+//
+// The events are encoded in blocks of 64 KB. For each trace, the program reports the size of the encoded stream
+// relative to the journal records and to the GPIO events (`struct gpio_event`), the encoding and decoding times per
+// event, and checks that the decoded events are the original ones.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../event_codec.h"
+#include "../gpio.h"
+#include "../journal.h"
+#include "../timing.h"
+
+#define BLOCK_SIZE      (64 * 1024)
+#define SYNTHETIC_COUNT 1000000
+#define MAX_BLOCKS      4096
+
+struct trace {
+    const char *name;
+    int64_t    *timestamps;
+    uint32_t   *line_ids;
+    int        *values;
+    long       count;
+    long       capacity;
+};
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+void trace_init(struct trace *trace, const char *name) {
+    trace->name       = name;
+    trace->timestamps = NULL;
+    trace->line_ids   = NULL;
+    trace->values     = NULL;
+    trace->count      = 0;
+    trace->capacity   = 0;
+}
+
+void trace_add(struct trace *trace, int64_t timestamp, uint32_t line_id, int value) {
+    if (trace->count == trace->capacity) {
+        trace->capacity   = 0 == trace->capacity ? 4096 : 2 * trace->capacity;
+        trace->timestamps = realloc(trace->timestamps, trace->capacity * sizeof(int64_t));
+        trace->line_ids   = realloc(trace->line_ids, trace->capacity * sizeof(uint32_t));
+        trace->values     = realloc(trace->values, trace->capacity * sizeof(int));
+        if (NULL == trace->timestamps || NULL == trace->line_ids || NULL == trace->values) {
+            error("out of memory");
+        }
+    }
+    trace->timestamps[trace->count] = timestamp;
+    trace->line_ids[trace->count]   = line_id;
+    trace->values[trace->count]     = value;
+    trace->count++;
+}
+
+void trace_terminate(struct trace *trace) {
+    free(trace->timestamps);
+    free(trace->line_ids);
+    free(trace->values);
+}
+
+/** A jitter of +/- `amplitude` nano seconds (xorshift, so that the traces are the same on every run). */
+int64_t jitter(uint64_t *state, int64_t amplitude) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return (int64_t)(*state % (uint64_t)(2 * amplitude + 1)) - amplitude;
+}
+
+/**
+ * Generate the transitions of periodic lines, merged by timestamp.
+ * @param line_ids The ID of each line.
+ * @param periods The period of each line.
+ * @param delays The delay of each line relative to its period.
+ */
+
+void generate(struct trace *trace, int count, const uint32_t *line_ids, const int64_t *periods,
+              const int64_t *delays, int64_t amplitude) {
+    int64_t next[4];
+    int values[4] = { 0, 0, 0, 0 };
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    int64_t origin = 12345 * NSEC_PER_SEC;
+
+    for (int line=0; line<count; line++) {
+        next[line] = origin + delays[line];
+    }
+    while (trace->count < SYNTHETIC_COUNT) {
+        int line = 0;
+
+        for (int i=1; i<count; i++) {
+            if (next[i] < next[line]) {
+                line = i;
+            }
+        }
+        values[line] = !values[line];
+        trace_add(trace, next[line] + jitter(&state, amplitude), line_ids[line], values[line]);
+        next[line] += periods[line] / 2;
+    }
+}
+
+void load_journal(struct trace *trace, const char *path) {
+    struct journal_reader reader;
+    struct journal_record record;
+    int status;
+
+    if (-1 == journal_reader_open(&reader, path)) {
+        error("cannot open the journal");
+    }
+    while (1 == (status = journal_reader_next(&reader, &record))) {
+        trace_add(trace, record.timestamp, record.line_id, record.value);
+    }
+    if (-1 == status) {
+        error("cannot read the journal");
+    }
+    journal_reader_close(&reader);
+}
+
+/**
+ * Encode a trace, decode it and check the result.
+ */
+
+void measure(const struct trace *trace) {
+    static uint8_t blocks[MAX_BLOCKS][BLOCK_SIZE];
+    static size_t sizes[MAX_BLOCKS];
+    struct event_encoder encoder;
+    struct event_decoder decoder;
+    int block_count = 1;
+    size_t encoded = 0;
+    long index = 0;
+    int64_t start, encode_time, decode_time;
+
+    if (0 == trace->count) {
+        printf("%-16s empty\n", trace->name);
+        return;
+    }
+
+    start = timing_now();
+    event_encoder_init(&encoder, blocks[0], BLOCK_SIZE);
+    for (long i=0; i<trace->count; i++) {
+        if (-1 == event_encode(&encoder, trace->timestamps[i], trace->line_ids[i], trace->values[i])) {
+            if (0 == encoder.events || MAX_BLOCKS == block_count) {
+                error("cannot encode the trace");
+            }
+            sizes[block_count - 1] = encoder.size;
+            event_encoder_init(&encoder, blocks[block_count++], BLOCK_SIZE);
+            i--;
+        }
+    }
+    sizes[block_count - 1] = encoder.size;
+    encode_time = timing_now() - start;
+
+    start = timing_now();
+    for (int block=0; block<block_count; block++) {
+        int64_t timestamp;
+        uint32_t line_id;
+        int value, status;
+
+        event_decoder_init(&decoder, blocks[block], sizes[block]);
+        while (1 == (status = event_decode(&decoder, &timestamp, &line_id, &value))) {
+            if (index == trace->count || timestamp != trace->timestamps[index] || line_id != trace->line_ids[index]
+                || value != (0 != trace->values[index])) {
+                error("the decoded events differ from the original ones");
+            }
+            index++;
+        }
+        if (-1 == status) {
+            error("cannot decode the trace");
+        }
+        encoded += sizes[block];
+    }
+    decode_time = timing_now() - start;
+    if (index != trace->count) {
+        error("events are missing in the decoded trace");
+    }
+
+    printf("%-16s %8ld events, %3d blocks: %5.2f bytes/event, ratio %5.1fx (journal) %5.1fx (events), "
+           "encode %5.1f ns/event, decode %5.1f ns/event\n", trace->name, trace->count, block_count,
+           (double)encoded / (double)trace->count,
+           (double)(trace->count * (long)sizeof(struct journal_record)) / (double)encoded,
+           (double)(trace->count * (long)sizeof(struct gpio_event)) / (double)encoded,
+           (double)encode_time / (double)trace->count, (double)decode_time / (double)trace->count);
+}
+
+int main(int argc, char *argv[]) {
+    struct trace trace;
+
+    if (argc > 1) {
+        for (int i=1; i<argc; i++) {
+            trace_init(&trace, argv[i]);
+            load_journal(&trace, argv[i]);
+            measure(&trace);
+            trace_terminate(&trace);
+        }
+        return 0;
+    }
+
+    printf("Synthetic traces (record real ones with `gpio2 -J`):\n");
+    {
+        int64_t periods[] = { NSEC_PER_SEC / 2, NSEC_PER_SEC / 3 };
+        int64_t delays[]  = { 0, 0 };
+        uint32_t line_ids[] = { 16, 17 };
+
+        trace_init(&trace, "gpio1 (2 LEDs)");
+        generate(&trace, 2, line_ids, periods, delays, 50000);
+        measure(&trace);
+        trace_terminate(&trace);
+    }
+    {
+        int64_t periods[] = { 200000, 200000 };
+        int64_t delays[]  = { 0, 60000 };
+        uint32_t line_ids[] = { 16, 21 };
+
+        trace_init(&trace, "gpio2 (loopback)");
+        generate(&trace, 2, line_ids, periods, delays, 5000);
+        measure(&trace);
+        trace_terminate(&trace);
+    }
+    return 0;
+}
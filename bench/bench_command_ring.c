@@ -0,0 +1,266 @@
+// Measure the throughput of the shared-memory command ring (see command_ring.h) for 1, 2, 4 and 8 client processes.
+//
+// The engine runs in a thread of the main process. The clients are child processes (the ring is an anonymous shared
+// mapping): each one submits `count` commands (mostly sets of its own line, with a pulse and a two-line pattern
+// every 16 commands), with up to a full queue of commands in flight, and checks the completions. The program
+// reports the commands per second, the commands per bulk write, the sleeps of the engine and the doorbells rung by
+// the clients (the only system calls of the submission path).
+//
+// With a chip, the same number of commands is also written one by one by a single process (one ioctl per command),
+// for comparison.
+//
+//     $ ./bench_command_ring [-c chip] [-o first] [-n count]
+//
+// With `-c`, the lines are those of a gpio-sim chip (outputs, requested at once and written in bulk). Otherwise,
+// the lines are simulated in memory (this measures the ring alone).
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "../command_ring.h"
+#include "../gpio.h"
+#include "../timing.h"
+
+#define NUMBER_OF_LINES   8
+#define MAX_CLIENTS       8
+#define DEFAULT_COUNT     1000000
+/** The time spent by the engine polling before sleeping. */
+#define ENGINE_SPIN_NS    50000
+/** The number of empty polls of the completion queue before a client sleeps. */
+#define CLIENT_SPIN       1000
+#define PULSE_DURATION_NS 10000
+
+/**
+ * The lines driven by the engine: a GPIO request, or an array in memory.
+ */
+
+struct bench_lines {
+    struct gpio_output *output;
+    int                values[NUMBER_OF_LINES];
+};
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-c chip] [-o first] [-n count]\n", program);
+    fprintf(stderr, "  -c chip:  a gpio-sim chip with at least %d lines (default: lines in memory).\n",
+            NUMBER_OF_LINES);
+    fprintf(stderr, "  -o first: the offset of the first line (default: 0).\n");
+    fprintf(stderr, "  -n count: the number of commands per client (default: %d).\n", DEFAULT_COUNT);
+    exit(1);
+}
+
+int lines_set_values(void *context, int count, const int *line_ids, const int *values) {
+    struct bench_lines *lines = (struct bench_lines*)context;
+
+    for (int i=0; i<count; i++) {
+        lines->values[line_ids[i]] = values[i];
+    }
+    return NULL == lines->output ? 0 : gpio_output_set_values(lines->output, lines->values);
+}
+
+int lines_set_value(void *context, int line_id, int value) {
+    return lines_set_values(context, 1, &line_id, &value);
+}
+
+void* engine_thread(void *in_engine) {
+    command_engine_run((struct command_engine*)in_engine, ENGINE_SPIN_NS);
+    return NULL;
+}
+
+/**
+ * Build the command N of a client.
+ */
+
+void build_command(struct command *command, int client, long n) {
+    int line = client % NUMBER_OF_LINES;
+    int value = (int)(n & 1);
+
+    if (15 == n % 16) {
+        command_pulse(command, (uint64_t)n, line, 1, PULSE_DURATION_NS);
+    } else if (7 == n % 16) {
+        int other = (line + NUMBER_OF_LINES / 2) % NUMBER_OF_LINES;
+
+        command_pattern(command, (uint64_t)n, UINT64_C(1) << line | UINT64_C(1) << other,
+                        (uint64_t)value << line | (uint64_t)!value << other);
+    } else {
+        command_set(command, (uint64_t)n, line, value);
+    }
+}
+
+/**
+ * Submit `count` commands and reap their completions (in a child process).
+ * @return The exit status of the process.
+ */
+
+int run_client(struct command_ring *ring, int start_fd, int index, long count) {
+    struct command_client client;
+    struct command commands[COMMAND_RING_DEPTH];
+    struct command_completion completions[COMMAND_RING_DEPTH];
+    long submitted = 0, completed = 0;
+    int idle = 0;
+    char byte;
+
+    if (-1 == command_client_attach(&client, ring)) {
+        return 1;
+    }
+    // Wait for the start of the measure (the end of the pipe is closed by the parent).
+    while (0 < read(start_fd, &byte, 1));
+
+    while (completed < count) {
+        int batch = (int)(count - submitted < COMMAND_RING_DEPTH ? count - submitted : COMMAND_RING_DEPTH);
+        int reaped;
+
+        for (int i=0; i<batch; i++) {
+            build_command(&commands[i], index, submitted + i);
+        }
+        submitted += batch > 0 ? command_client_submit(&client, commands, batch) : 0;
+
+        reaped = command_client_reap(&client, completions, COMMAND_RING_DEPTH);
+        for (int i=0; i<reaped; i++) {
+            if (0 != completions[i].status || (long)completions[i].user_data != completed + i) {
+                return 1;
+            }
+        }
+        completed += reaped;
+        idle = 0 == reaped ? idle + 1 : 0;
+        if (idle > CLIENT_SPIN && -1 == command_client_wait(&client)) {
+            return 1;
+        }
+    }
+    command_client_detach(&client);
+    return 0;
+}
+
+void measure(struct bench_lines *lines, int clients, long count) {
+    int line_ids[NUMBER_OF_LINES];
+    struct output_backend backend = { lines, &lines_set_value, &lines_set_values };
+    struct command_ring ring;
+    struct command_engine engine;
+    pid_t pids[MAX_CLIENTS];
+    pthread_t thread;
+    uint64_t doorbells = 0;
+    int start_pipe[2];
+    int failed = 0;
+    int64_t start, elapsed;
+
+    for (int i=0; i<NUMBER_OF_LINES; i++) {
+        line_ids[i] = i;
+    }
+    if (-1 == command_ring_create(&ring, NULL, clients, NUMBER_OF_LINES)
+        || -1 == command_engine_init(&engine, &ring, &backend, line_ids, NUMBER_OF_LINES)) {
+        error("cannot create the ring");
+    }
+    if (-1 == pipe(start_pipe)) {
+        error("cannot create the pipe");
+    }
+    for (int i=0; i<clients; i++) {
+        pids[i] = fork();
+        if (-1 == pids[i]) {
+            error("cannot create the client processes");
+        }
+        if (0 == pids[i]) {
+            close(start_pipe[1]);
+            _exit(run_client(&ring, start_pipe[0], i, count));
+        }
+    }
+    close(start_pipe[0]);
+
+    if (0 != pthread_create(&thread, NULL, &engine_thread, &engine)) {
+        error("cannot create the engine thread");
+    }
+    start = timing_now();
+    close(start_pipe[1]);
+    for (int i=0; i<clients; i++) {
+        int status;
+
+        if (-1 == waitpid(pids[i], &status, 0) || !WIFEXITED(status) || 0 != WEXITSTATUS(status)) {
+            failed++;
+        }
+    }
+    elapsed = timing_now() - start;
+    command_engine_stop(&engine);
+    pthread_join(thread, NULL);
+    if (failed > 0) {
+        error("a client failed (rejected or unexpected completion)");
+    }
+
+    for (int i=0; i<clients; i++) {
+        doorbells += ring.shared->channels[i].doorbells;
+    }
+    printf("%d client(s): %9.0f commands/s, %6.1f commands per write, %6ld engine sleeps, %6llu doorbells\n",
+           clients, (double)engine.commands * NSEC_PER_SEC / (double)elapsed,
+           (double)engine.commands / (double)(engine.commits > 0 ? engine.commits : 1), engine.sleeps,
+           (unsigned long long)doorbells);
+    command_engine_terminate(&engine);
+    command_ring_close(&ring);
+}
+
+void measure_direct(struct bench_lines *lines, long count) {
+    int64_t start = timing_now();
+
+    for (long i=0; i<count; i++) {
+        if (-1 == gpio_output_set_value(lines->output, 0, (int)(i & 1))) {
+            error("cannot write the line");
+        }
+    }
+    printf("direct:      %9.0f commands/s (one ioctl per command)\n",
+           (double)count * NSEC_PER_SEC / (double)(timing_now() - start));
+}
+
+int main(int argc, char *argv[]) {
+    int all_clients[] = { 1, 2, 4, 8 };
+    const char *chip_name = NULL;
+    struct gpio_chip *chip = NULL;
+    struct bench_lines lines;
+    unsigned int first = 0;
+    long count = DEFAULT_COUNT;
+    int option;
+
+    while (-1 != (option = getopt(argc, argv, "c:o:n:"))) {
+        switch (option) {
+            case 'c': chip_name = optarg; break;
+            case 'o': first = (unsigned int)atoi(optarg); break;
+            case 'n': count = atol(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (count < 1) {
+        usage(argv[0]);
+    }
+
+    lines.output = NULL;
+    for (int i=0; i<NUMBER_OF_LINES; i++) {
+        lines.values[i] = 0;
+    }
+    if (NULL != chip_name) {
+        unsigned int offsets[NUMBER_OF_LINES];
+
+        if (NULL == (chip = gpio_chip_open(chip_name))) {
+            error("cannot open the chip");
+        }
+        for (int i=0; i<NUMBER_OF_LINES; i++) {
+            offsets[i] = first + (unsigned int)i;
+        }
+        lines.output = gpio_output_request(chip, "bench", offsets, NUMBER_OF_LINES, lines.values);
+        if (NULL == lines.output) {
+            error("cannot request the output lines");
+        }
+    }
+
+    printf("Lines: %s, %ld commands per client\n", NULL == chip ? "memory" : gpio_backend_name(), count);
+    for (size_t i=0; i<sizeof(all_clients)/sizeof(int); i++) {
+        measure(&lines, all_clients[i], count);
+    }
+    if (NULL != chip) {
+        measure_direct(&lines, count);
+        gpio_output_release(lines.output);
+        gpio_chip_close(chip);
+    }
+    return 0;
+}
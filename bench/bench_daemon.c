@@ -0,0 +1,234 @@
+// Measure the operations per second of gpio_daemon (see gpio_daemon.c), compared with spawning gpioset for each
+// operation.
+//
+// The daemon must be running. The requests toggle an output line, one at a time (a round trip per operation), then
+// with up to 64 requests in flight (pipelined). Then gpioset (libgpiod tools, with the syntax of the backend the
+// program is built with) is spawned to toggle another line, which must not be used by the daemon.
+//
+//     $ ./gpio_daemon -c gpiochip0 &
+//     $ ./bench_daemon -c gpiochip0 -l 16 -g 17
+
+#include <errno.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "../daemon_protocol.h"
+#include "../gpio.h"
+#include "../timing.h"
+
+#define DEFAULT_SOCKET "/tmp/gpio_daemon.sock"
+#define DEFAULT_COUNT  100000
+/** The number of requests in flight, in pipelined mode. */
+#define WINDOW         64
+/** The number of spawned processes, relative to the number of requests. */
+#define SPAWN_RATIO    100
+
+extern char **environ;
+
+/** The replies received but not yet handled, possibly ending with a partial message. */
+struct reception {
+    uint8_t buffer[WINDOW * sizeof(struct daemon_message)];
+    size_t  size;
+};
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s -c chip -l line [-g line] [-s socket] [-n count]\n", program);
+    fprintf(stderr, "  -l line:   the output line toggled through the daemon.\n");
+    fprintf(stderr, "  -g line:   the output line toggled by gpioset (default: none, gpioset is not measured).\n");
+    fprintf(stderr, "  -s socket: the socket of the daemon (default: %s).\n", DEFAULT_SOCKET);
+    fprintf(stderr, "  -n count:  the number of requests (default: %d).\n", DEFAULT_COUNT);
+    exit(1);
+}
+
+int connect_daemon(const char *path) {
+    struct sockaddr_un address;
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+    if (-1 == fd || strlen(path) >= sizeof(address.sun_path)) {
+        error("cannot create the socket");
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    if (-1 == connect(fd, (struct sockaddr*)&address, sizeof(address))) {
+        error("cannot connect to the daemon (is it running?)");
+    }
+    return fd;
+}
+
+void send_all(int fd, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t*)data;
+
+    while (size > 0) {
+        ssize_t written = write(fd, bytes, size);
+
+        if (-1 == written && EINTR == errno) {
+            continue;
+        }
+        if (written <= 0) {
+            error("cannot send the requests");
+        }
+        bytes += written;
+        size  -= (size_t)written;
+    }
+}
+
+/**
+ * Receive at least one reply, and check all the replies received.
+ * @return The number of replies.
+ */
+
+long receive(int fd, struct reception *reception) {
+    size_t count;
+    ssize_t size = read(fd, &reception->buffer[reception->size], sizeof(reception->buffer) - reception->size);
+
+    if (size <= 0) {
+        error("cannot receive the replies");
+    }
+    reception->size += (size_t)size;
+    count = reception->size / sizeof(struct daemon_message);
+    for (size_t i=0; i<count; i++) {
+        struct daemon_message message;
+
+        memcpy(&message, &reception->buffer[i * sizeof(message)], sizeof(message));
+        if (0 != message.status) {
+            fprintf(stderr, "request #%u: error %d (%s)\n", message.id, -message.status, strerror(-message.status));
+            error("the daemon rejected a request");
+        }
+    }
+    reception->size -= count * sizeof(struct daemon_message);
+    memmove(reception->buffer, &reception->buffer[count * sizeof(struct daemon_message)], reception->size);
+    return (long)count;
+}
+
+void request_set(struct daemon_request *request, long index, unsigned int offset) {
+    memset(request, 0, sizeof(*request));
+    request->id     = (uint32_t)(index + 1);
+    request->opcode = DAEMON_SET;
+    request->value  = (uint8_t)(index & 1);
+    request->offset = offset;
+}
+
+void report(const char *name, long count, int64_t elapsed) {
+    printf("%-10s %8ld operations in %7.3f s => %10.0f operations/s, %8.2f us/operation\n", name, count,
+           (double)elapsed / NSEC_PER_SEC, (double)count * NSEC_PER_SEC / (double)elapsed,
+           (double)elapsed / 1000.0 / (double)count);
+}
+
+void measure_sequential(int fd, unsigned int offset, long count) {
+    struct reception reception = { { 0 }, 0 };
+    int64_t start = timing_now();
+
+    for (long i=0; i<count; i++) {
+        struct daemon_request request;
+
+        request_set(&request, i, offset);
+        send_all(fd, &request, sizeof(request));
+        while (0 == receive(fd, &reception)) {
+            // A partial reply.
+        }
+    }
+    report("sequential", count, timing_now() - start);
+}
+
+void measure_pipelined(int fd, unsigned int offset, long count) {
+    struct reception reception = { { 0 }, 0 };
+    struct daemon_request requests[WINDOW];
+    long sent = 0, received = 0;
+    int64_t start = timing_now();
+
+    while (received < count) {
+        long batch = received + WINDOW - sent;
+
+        if (batch > count - sent) {
+            batch = count - sent;
+        }
+        for (long i=0; i<batch; i++) {
+            request_set(&requests[i], sent + i, offset);
+        }
+        if (batch > 0) {
+            send_all(fd, requests, (size_t)batch * sizeof(struct daemon_request));
+            sent += batch;
+        }
+        received += receive(fd, &reception);
+    }
+    report("pipelined", count, timing_now() - start);
+}
+
+/**
+ * Spawn gpioset to set a line, with the syntax of the libgpiod version of the backend.
+ * @return 0, or -1 if gpioset cannot be run or fails.
+ */
+
+int spawn_gpioset(const char *chip_name, unsigned int offset, int value) {
+    char assignment[32];
+    char *v1_arguments[] = { "gpioset", (char*)chip_name, assignment, NULL };
+    char *v2_arguments[] = { "gpioset", "-c", (char*)chip_name, "-t", "0", assignment, NULL };
+    int v2 = NULL != strstr(gpio_backend_name(), "v2");
+    pid_t pid;
+    int status;
+
+    snprintf(assignment, sizeof(assignment), "%u=%d", offset, value);
+    if (0 != posix_spawnp(&pid, "gpioset", NULL, NULL, v2 ? v2_arguments : v1_arguments, environ)
+        || -1 == waitpid(pid, &status, 0)) {
+        return -1;
+    }
+    return WIFEXITED(status) && 0 == WEXITSTATUS(status) ? 0 : -1;
+}
+
+void measure_spawn(const char *chip_name, unsigned int offset, long count) {
+    int64_t start = timing_now();
+
+    for (long i=0; i<count; i++) {
+        if (-1 == spawn_gpioset(chip_name, offset, (int)(i & 1))) {
+            printf("%-10s unavailable (cannot run gpioset, or it failed)\n", "gpioset");
+            return;
+        }
+    }
+    report("gpioset", count, timing_now() - start);
+}
+
+int main(int argc, char *argv[]) {
+    const char *chip_name = NULL;
+    const char *path = DEFAULT_SOCKET;
+    unsigned int offset = 0, spawn_offset = 0;
+    int has_offset = 0, has_spawn_offset = 0;
+    long count = DEFAULT_COUNT;
+    int option;
+    int fd;
+
+    while (-1 != (option = getopt(argc, argv, "c:l:g:s:n:"))) {
+        switch (option) {
+            case 'c': chip_name = optarg; break;
+            case 'l': offset = (unsigned int)atoi(optarg); has_offset = 1; break;
+            case 'g': spawn_offset = (unsigned int)atoi(optarg); has_spawn_offset = 1; break;
+            case 's': path = optarg; break;
+            case 'n': count = atol(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (NULL == chip_name || !has_offset || count < 1) {
+        usage(argv[0]);
+    }
+
+    fd = connect_daemon(path);
+    printf("Toggling line #%u through the daemon (%s)\n", offset, path);
+    measure_sequential(fd, offset, count);
+    measure_pipelined(fd, offset, count);
+    close(fd);
+    if (has_spawn_offset) {
+        printf("Toggling line #%u of %s with gpioset (%s syntax)\n", spawn_offset, chip_name, gpio_backend_name());
+        measure_spawn(chip_name, spawn_offset, count / SPAWN_RATIO > 10 ? count / SPAWN_RATIO : 10);
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+// Measure the effect of the per-cycle messages on the jitter of a toggle loop (the loop of `led_thread`, gpio1.c).
+//
+// The loop toggles an in-memory line at a fixed period, and logs every change of state: not at all (off), with
+// printf in the loop (sync), or through the asynchronous logger (async). The messages are printed to the standard
+// output, and the lateness of the cycles to the standard error. Compare the results on a terminal, and redirected
+// to a file:
+//
+//     $ ./bench_logger [period in nano seconds] [count]
+//     $ ./bench_logger 100000 20000 > /tmp/log.txt
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../histogram.h"
+#include "../logger.h"
+#include "../timing.h"
+
+void format_toggle(FILE *stream, const struct log_record *record) {
+    fprintf(stream, "G [%4ld] Set %s (late %lld ns)\n", record->cycle, record->value ? "up" : "down",
+            (long long)record->extra);
+}
+
+void run(const char *name, int mode, int64_t period, long count) {
+    struct deadline schedule;
+    struct histogram lateness;
+    struct log_buffer *log;
+    volatile int line = 0;
+    int64_t late = 0;
+
+    if (-1 == logger_start(stdout, mode)) {
+        fprintf(stderr, "ERROR: cannot start the logger\n");
+        exit(1);
+    }
+    log = logger_register();
+    histogram_init(&lateness);
+
+    deadline_init(&schedule, timing_now(), period / NSEC_PER_SEC, period % NSEC_PER_SEC);
+    for (long cycle=0; cycle<count; cycle++) {
+        int value = (cycle & 0x1) != 0;
+
+        log_write(log, &format_toggle, cycle, 0, value, late);
+        line = value;
+        deadline_wait(&schedule, &late);
+        histogram_record(&lateness, late);
+    }
+    (void)line;
+    logger_stop();
+    histogram_print(stderr, name, &lateness);
+}
+
+int main(int argc, char *argv[]) {
+    int64_t period = argc > 1 ? atoll(argv[1]) : 100000;
+    long count = argc > 2 ? atol(argv[2]) : 20000;
+
+    if (period <= 0 || count <= 0) {
+        fprintf(stderr, "Usage: %s [period in nano seconds] [count]\n", argv[0]);
+        return 1;
+    }
+    fprintf(stderr, "Period: %lld ns, %ld cycles\n", (long long)period, count);
+    run("lateness, log off (ns)", LOGGER_OFF, period, count);
+    run("lateness, log sync (ns)", LOGGER_SYNC, period, count);
+    run("lateness, log async (ns)", LOGGER_ASYNC, period, count);
+    return 0;
+}
@@ -0,0 +1,275 @@
+// Compare "one thread per input line" with the single-thread monitor (see monitor.h), for 1, 8 and 48 lines.
+//
+// The edges are generated on gpio-sim, through the `pull` attributes of the simulated lines, one line after the
+// other. For each number of lines, the program reports the dispatch latency (from the kernel timestamp of an edge to
+// the call of its handler) and the CPU usage of the whole process.
+//
+//     $ ./bench_monitor -c gpiochip2 -s /sys/devices/platform/gpio-sim.0/gpiochip2 [-o first] [-n count] [-t period]
+//
+// The chip must have at least 48 lines, starting at the offset `first` (ex: `num_lines` = 64 in configfs).
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "../gpio.h"
+#include "../gpio_sim.h"
+#include "../histogram.h"
+#include "../monitor.h"
+#include "../timing.h"
+
+#define MAX_LINES         48
+#define EVENT_BUFFER_SIZE 64
+/** Time to wait for the last edges once the generator has stopped. */
+#define DRAIN_TIMEOUT_NS  (100 * 1000 * 1000)
+
+struct bench {
+    struct gpio_chip *chip;
+    unsigned int     offsets[MAX_LINES];
+    int              sim_fds[MAX_LINES];
+    int              number_of_lines;
+    long             count;
+    int64_t          period;
+    /** Set once all the edges have been generated. */
+    int              generated;
+    long             received;
+    struct histogram latency;
+};
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+void record(struct bench *bench, const struct gpio_event *event) {
+    histogram_record(&bench->latency, timing_now() - event->timestamp);
+    __atomic_fetch_add(&bench->received, 1, __ATOMIC_RELAXED);
+}
+
+/**
+ * Generate `count` edges, one line after the other, every `period` nano seconds.
+ */
+
+void* generator_thread(void *in_args) {
+    struct bench *bench = (struct bench*)in_args;
+    struct deadline schedule;
+
+    deadline_init(&schedule, timing_now(), bench->period / NSEC_PER_SEC, bench->period % NSEC_PER_SEC);
+    for (long i=0; i<bench->count; i++) {
+        int line = (int)(i % bench->number_of_lines);
+        int value = ((i / bench->number_of_lines) & 0x1) == 0;
+
+        if (-1 == gpio_sim_set(bench->sim_fds[line], value)) {
+            error("cannot generate an edge");
+        }
+        deadline_wait(&schedule, NULL);
+    }
+    __atomic_store_n(&bench->generated, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+/**
+ * Wait for events, until the generator has stopped and no event has been received for DRAIN_TIMEOUT_NS.
+ * @return 1 if events are pending, 0 when the measure is over.
+ */
+
+int wait_events(struct bench *bench, struct gpio_input *input) {
+    for (;;) {
+        int status = gpio_input_wait(input, DRAIN_TIMEOUT_NS);
+
+        if (-1 == status) {
+            error("error while waiting for events");
+        }
+        if (1 == status) {
+            return 1;
+        }
+        if (__atomic_load_n(&bench->generated, __ATOMIC_ACQUIRE)) {
+            return 0;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------
+// THREADS
+// ---------------------------------------------------------------------------------
+
+struct line_args {
+    struct bench *bench;
+    unsigned int offset;
+};
+
+void* line_thread(void *in_args) {
+    struct line_args *args = (struct line_args*)in_args;
+    struct gpio_event events[EVENT_BUFFER_SIZE];
+    struct gpio_input *input = gpio_input_request(args->bench->chip, "bench", &args->offset, 1, EVENT_BUFFER_SIZE);
+
+    if (NULL == input) {
+        error("cannot request an input line");
+    }
+    while (wait_events(args->bench, input)) {
+        int count = gpio_input_read(input, events, EVENT_BUFFER_SIZE);
+
+        if (-1 == count) {
+            error("error while reading events");
+        }
+        for (int i=0; i<count; i++) {
+            record(args->bench, &events[i]);
+        }
+    }
+    gpio_input_release(input);
+    return NULL;
+}
+
+void run_threads(struct bench *bench) {
+    pthread_t threads[MAX_LINES];
+    struct line_args args[MAX_LINES];
+
+    for (int i=0; i<bench->number_of_lines; i++) {
+        args[i].bench  = bench;
+        args[i].offset = bench->offsets[i];
+        if (0 != pthread_create(&threads[i], NULL, &line_thread, &args[i])) {
+            error("cannot create a line thread");
+        }
+    }
+    // Let the threads request their lines before the first edge.
+    usleep(100000);
+    generator_thread(bench);
+    for (int i=0; i<bench->number_of_lines; i++) {
+        pthread_join(threads[i], NULL);
+    }
+}
+
+// ---------------------------------------------------------------------------------
+// MONITOR
+// ---------------------------------------------------------------------------------
+
+void on_edge(void *context, const struct gpio_event *event) {
+    record((struct bench*)context, event);
+}
+
+void* monitor_thread(void *in_args) {
+    struct bench *bench = (struct bench*)in_args;
+    struct monitor monitor;
+
+    if (-1 == monitor_init(&monitor, bench->number_of_lines)) {
+        error("cannot create the monitor");
+    }
+    for (int i=0; i<bench->number_of_lines; i++) {
+        monitor_add(&monitor, bench->offsets[i], &on_edge, bench);
+    }
+    if (-1 == monitor_start(&monitor, bench->chip, "bench", EVENT_BUFFER_SIZE)) {
+        error("cannot request the input lines");
+    }
+    while (wait_events(bench, monitor.input)) {
+        if (-1 == monitor_process(&monitor)) {
+            error("error while reading events");
+        }
+    }
+    monitor_terminate(&monitor);
+    return NULL;
+}
+
+void run_monitor(struct bench *bench) {
+    pthread_t thread;
+
+    if (0 != pthread_create(&thread, NULL, &monitor_thread, bench)) {
+        error("cannot create the monitor thread");
+    }
+    usleep(100000);
+    generator_thread(bench);
+    pthread_join(thread, NULL);
+}
+
+int64_t cpu_time(struct rusage *usage) {
+    return ((int64_t)usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * NSEC_PER_SEC
+           + ((int64_t)usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) * 1000;
+}
+
+void measure(const char *mode, struct bench *bench, void (*run)(struct bench*)) {
+    struct rusage before, after;
+    int64_t start;
+    double elapsed;
+
+    // All lines low, before the lines are requested: no edge.
+    for (int i=0; i<bench->number_of_lines; i++) {
+        gpio_sim_set(bench->sim_fds[i], 0);
+    }
+    bench->generated = 0;
+    bench->received  = 0;
+    histogram_init(&bench->latency);
+
+    getrusage(RUSAGE_SELF, &before);
+    start = timing_now();
+    run(bench);
+    elapsed = (double)(timing_now() - start) / NSEC_PER_SEC;
+    getrusage(RUSAGE_SELF, &after);
+
+    printf("%-7s %2d lines: %ld/%ld events, latency p50 %7lld ns, p99 %7lld ns, max %8lld ns, CPU %6.2f%%\n",
+           mode, bench->number_of_lines, bench->received, bench->count,
+           (long long)histogram_percentile(&bench->latency, 50.0),
+           (long long)histogram_percentile(&bench->latency, 99.0),
+           (long long)bench->latency.max,
+           100.0 * (double)(cpu_time(&after) - cpu_time(&before)) / NSEC_PER_SEC / elapsed);
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s -c chip -s sim_directory [-o first] [-n count] [-t period]\n", program);
+    fprintf(stderr, "  -s sim_directory: the gpio-sim directory of the chip (contains sim_gpio<offset>/pull).\n");
+    fprintf(stderr, "  -o first:  the offset of the first line (default: 0).\n");
+    fprintf(stderr, "  -n count:  the number of edges, for each number of lines (default: 10000).\n");
+    fprintf(stderr, "  -t period: the time between two edges, in nano seconds (default: 100000).\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int all_numbers_of_lines[] = { 1, 8, MAX_LINES };
+    const char *chip_name = NULL;
+    const char *sim_directory = NULL;
+    unsigned int first = 0;
+    struct bench bench;
+    int option;
+
+    bench.count  = 10000;
+    bench.period = 100000;
+    while (-1 != (option = getopt(argc, argv, "c:s:o:n:t:"))) {
+        switch (option) {
+            case 'c': chip_name = optarg; break;
+            case 's': sim_directory = optarg; break;
+            case 'o': first = (unsigned int)atoi(optarg); break;
+            case 'n': bench.count = atol(optarg); break;
+            case 't': bench.period = atoll(optarg); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (NULL == chip_name || NULL == sim_directory || bench.count < 1 || bench.period < 1) {
+        usage(argv[0]);
+    }
+
+    bench.chip = gpio_chip_open(chip_name);
+    if (NULL == bench.chip) {
+        error("cannot open the chip");
+    }
+    for (int i=0; i<MAX_LINES; i++) {
+        char path[512];
+
+        bench.offsets[i] = first + (unsigned int)i;
+        snprintf(path, sizeof(path), "%s/sim_gpio%u/pull", sim_directory, bench.offsets[i]);
+        if (-1 == (bench.sim_fds[i] = gpio_sim_open(path))) {
+            error("cannot open a gpio-sim pull attribute");
+        }
+    }
+
+    printf("Backend: %s, %ld edges, one every %lld ns\n", gpio_backend_name(), bench.count, (long long)bench.period);
+    for (size_t i=0; i<sizeof(all_numbers_of_lines)/sizeof(int); i++) {
+        bench.number_of_lines = all_numbers_of_lines[i];
+        measure("threads", &bench, &run_threads);
+        measure("monitor", &bench, &run_monitor);
+    }
+
+    for (int i=0; i<MAX_LINES; i++) {
+        close(bench.sim_fds[i]);
+    }
+    gpio_chip_close(bench.chip);
+    return 0;
+}
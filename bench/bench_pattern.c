@@ -0,0 +1,263 @@
+// Measure the maximum step rate of the pattern player (see pattern.h), and the latency of the triggered playback.
+//
+// Step rate: a pattern of 8 lines (a walking bit, one step every `spacing` nano seconds) is played in a loop, with
+// the sleep-only timing and with the precision timing (sleep, then spin). For each spacing, the program reports the
+// steps per second, the lateness of the steps and the overruns (steps committed after the deadline of the next
+// one). The maximum step rate is the highest rate with less than 1% of overruns.
+//
+// Triggered playback: another thread triggers a one-step pattern through an eventfd; the program reports the time
+// from the trigger to the completion of the write.
+//
+//     $ ./bench_pattern [-c chip] [-o first] [-d duration]
+//
+// With `-c`, the lines are those of a gpio-sim chip (outputs, requested at once and written in bulk). Otherwise,
+// the lines are simulated in memory (this measures the player alone).
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "../gpio.h"
+#include "../pattern.h"
+#include "../timing.h"
+
+#define NUMBER_OF_LINES   8
+#define TRIGGER_COUNT     2000
+#define TRIGGER_PERIOD_NS 1000000
+/** The tolerated proportion of overruns for a step rate to be sustained (1%). */
+#define MAX_OVERRUNS      0.01
+
+/**
+ * The lines driven by the player: a GPIO request, or an array in memory.
+ */
+
+struct bench_lines {
+    struct gpio_output *output;
+    int                line_ids[NUMBER_OF_LINES];
+    int                values[NUMBER_OF_LINES];
+};
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+int lines_set_values(void *context, int count, const int *line_ids, const int *values) {
+    struct bench_lines *lines = (struct bench_lines*)context;
+
+    for (int i=0; i<count; i++) {
+        lines->values[line_ids[i]] = values[i];
+    }
+    return NULL == lines->output ? 0 : gpio_output_set_values(lines->output, lines->values);
+}
+
+int lines_set_value(void *context, int line_id, int value) {
+    return lines_set_values(context, 1, &line_id, &value);
+}
+
+/**
+ * Build a walking bit: at step N, the line N % 8 goes up and the previous one goes down.
+ */
+
+void build_walking_bit(struct pattern *pattern, const struct bench_lines *lines, int64_t spacing) {
+    if (-1 == pattern_init(pattern, lines->line_ids, NUMBER_OF_LINES)) {
+        error("cannot create the pattern");
+    }
+    for (int step=0; step<NUMBER_OF_LINES; step++) {
+        int previous = (step + NUMBER_OF_LINES - 1) % NUMBER_OF_LINES;
+        uint32_t mask = (1U << step) | (1U << previous);
+
+        if (-1 == pattern_add(pattern, step * spacing, mask, 1U << step)) {
+            error("cannot add a step");
+        }
+    }
+    if (-1 == pattern_compile(pattern, NUMBER_OF_LINES * spacing)) {
+        error("cannot compile the pattern");
+    }
+}
+
+/**
+ * Play the walking bit for `duration` nano seconds.
+ * @return The proportion of overruns.
+ */
+
+double measure_rate(struct bench_lines *lines, int64_t spacing, int64_t spin_margin, int64_t duration) {
+    struct output_backend backend = { lines, &lines_set_value, &lines_set_values };
+    struct pattern pattern;
+    struct pattern_player player;
+    long passes = duration / (NUMBER_OF_LINES * spacing);
+    int64_t start;
+    double elapsed, overruns;
+
+    build_walking_bit(&pattern, lines, spacing);
+    pattern_player_init(&player, &pattern, &backend, spin_margin);
+    start = timing_now();
+    if (-1 == pattern_play(&player, start, passes > 0 ? passes : 1)) {
+        error("cannot play the pattern");
+    }
+    elapsed = (double)(timing_now() - start) / NSEC_PER_SEC;
+    overruns = (double)player.overruns / (double)player.steps;
+
+    printf("%-5s spacing %7lld ns: %10.0f steps/s, lateness p50 %7lld ns, p99 %7lld ns, max %8lld ns, "
+           "overruns %5.1f%%\n",
+           spin_margin > 0 ? "spin" : "sleep", (long long)spacing, (double)player.steps / elapsed,
+           (long long)histogram_percentile(&player.lateness, 50.0),
+           (long long)histogram_percentile(&player.lateness, 99.0), (long long)player.lateness.max,
+           100.0 * overruns);
+    pattern_terminate(&pattern);
+    return overruns;
+}
+
+// ---------------------------------------------------------------------------------
+// TRIGGERED PLAYBACK
+// ---------------------------------------------------------------------------------
+
+struct trigger {
+    int     fd;
+    /** The instant of the last trigger. */
+    int64_t instant;
+};
+
+void* trigger_thread(void *in_args) {
+    struct trigger *trigger = (struct trigger*)in_args;
+    struct deadline schedule;
+    uint64_t one = 1;
+
+    deadline_init(&schedule, timing_now() + TRIGGER_PERIOD_NS, 0, TRIGGER_PERIOD_NS);
+    for (int i=0; i<TRIGGER_COUNT; i++) {
+        deadline_wait(&schedule, NULL);
+        __atomic_store_n(&trigger->instant, timing_now(), __ATOMIC_RELEASE);
+        if (sizeof(one) != write(trigger->fd, &one, sizeof(one))) {
+            error("cannot trigger the pattern");
+        }
+    }
+    // The last trigger stops the playback.
+    __atomic_store_n(&trigger->instant, -1, __ATOMIC_RELEASE);
+    if (sizeof(one) != write(trigger->fd, &one, sizeof(one))) {
+        error("cannot stop the pattern");
+    }
+    return NULL;
+}
+
+int wait_trigger(void *context, int64_t *start) {
+    struct trigger *trigger = (struct trigger*)context;
+    uint64_t count;
+
+    if (sizeof(count) != read(trigger->fd, &count, sizeof(count))) {
+        return -1;
+    }
+    *start = __atomic_load_n(&trigger->instant, __ATOMIC_ACQUIRE);
+    return -1 == *start ? 0 : 1;
+}
+
+void measure_trigger(struct bench_lines *lines) {
+    struct output_backend backend = { lines, &lines_set_value, &lines_set_values };
+    struct pattern pattern;
+    struct pattern_player player;
+    struct trigger trigger;
+    pthread_t thread;
+
+    if (-1 == pattern_init(&pattern, lines->line_ids, NUMBER_OF_LINES) || -1 == pattern_add(&pattern, 0, 0xff, 0x55)
+        || -1 == pattern_compile(&pattern, 0)) {
+        error("cannot create the pattern");
+    }
+    pattern_player_init(&player, &pattern, &backend, 0);
+    if (-1 == (trigger.fd = eventfd(0, EFD_CLOEXEC))) {
+        error("cannot create the eventfd");
+    }
+    if (0 != pthread_create(&thread, NULL, &trigger_thread, &trigger)) {
+        error("cannot create the trigger thread");
+    }
+    if (-1 == pattern_play_triggered(&player, &wait_trigger, &trigger)) {
+        error("cannot play the pattern");
+    }
+    pthread_join(thread, NULL);
+
+    printf("triggered: %ld passes, trigger to write p50 %7lld ns, p99 %7lld ns, max %8lld ns\n",
+           player.passes, (long long)histogram_percentile(&player.lateness, 50.0),
+           (long long)histogram_percentile(&player.lateness, 99.0), (long long)player.lateness.max);
+    close(trigger.fd);
+    pattern_terminate(&pattern);
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-c chip] [-o first] [-d duration]\n", program);
+    fprintf(stderr, "  -c chip:     the gpio-sim chip (default: lines simulated in memory).\n");
+    fprintf(stderr, "  -o first:    the offset of the first of the %d lines (default: 0).\n", NUMBER_OF_LINES);
+    fprintf(stderr, "  -d duration: the duration of each measure, in seconds (default: 1).\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int64_t all_spacings[] = { 100000, 20000, 10000, 5000, 2000, 1000, 500, 200 };
+    const char *chip_name = NULL;
+    struct gpio_chip *chip = NULL;
+    struct bench_lines lines;
+    unsigned int first = 0;
+    int64_t duration = NSEC_PER_SEC;
+    int64_t all_margins[2];
+    int option;
+
+    while (-1 != (option = getopt(argc, argv, "c:o:d:"))) {
+        switch (option) {
+            case 'c': chip_name = optarg; break;
+            case 'o': first = (unsigned int)atoi(optarg); break;
+            case 'd': duration = (int64_t)(atof(optarg) * NSEC_PER_SEC); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (duration < 1) {
+        usage(argv[0]);
+    }
+
+    lines.output = NULL;
+    for (int i=0; i<NUMBER_OF_LINES; i++) {
+        lines.line_ids[i] = i;
+        lines.values[i]   = 0;
+    }
+    if (NULL != chip_name) {
+        unsigned int offsets[NUMBER_OF_LINES];
+
+        if (NULL == (chip = gpio_chip_open(chip_name))) {
+            error("cannot open the chip");
+        }
+        for (int i=0; i<NUMBER_OF_LINES; i++) {
+            offsets[i] = first + (unsigned int)i;
+        }
+        lines.output = gpio_output_request(chip, "bench", offsets, NUMBER_OF_LINES, lines.values);
+        if (NULL == lines.output) {
+            error("cannot request the output lines");
+        }
+    }
+
+    all_margins[0] = 0;
+    if (-1 == (all_margins[1] = timing_calibrate(CALIBRATION_SAMPLES))) {
+        error("cannot calibrate the precision timing mode");
+    }
+    printf("Lines: %s, spin margin %lld ns\n", NULL == chip ? "memory" : gpio_backend_name(),
+           (long long)all_margins[1]);
+    for (int i=0; i<2; i++) {
+        int64_t max_rate = 0;
+
+        for (size_t j=0; j<sizeof(all_spacings)/sizeof(int64_t); j++) {
+            double overruns = measure_rate(&lines, all_spacings[j], all_margins[i], duration);
+
+            if (overruns < MAX_OVERRUNS) {
+                max_rate = NSEC_PER_SEC / all_spacings[j];
+            } else if (overruns > 0.5) {
+                // The player does not skip the late steps: the shorter spacings would only accumulate lateness.
+                break;
+            }
+        }
+        printf("%-5s maximum step rate (overruns < %.0f%%): %lld steps/s\n\n", 0 == i ? "sleep" : "spin",
+               100.0 * MAX_OVERRUNS, (long long)max_rate);
+    }
+    measure_trigger(&lines);
+
+    if (NULL != chip) {
+        gpio_output_release(lines.output);
+        gpio_chip_close(chip);
+    }
+    return 0;
+}
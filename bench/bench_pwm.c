@@ -0,0 +1,160 @@
+// Measure the achievable frequency and the duty resolution of the PWM engine (see pwm.h), versus the number of
+// channels.
+//
+// For each number of channels and each frequency, the engine drives all the channels for `duration` seconds (the
+// duty cycles are spread between 10% and 90%) and the program reports the lateness of the edges. The duty resolution
+// is the p99 lateness relative to the period: the duty cycle of a channel cannot be set more precisely than that.
+// The achievable frequency is the highest frequency whose duty resolution is better than 1%.
+//
+// The lines are those of a gpio-sim chip (outputs, requested at once and written in bulk):
+//
+//     $ ./bench_pwm -c gpiochip2 [-o first] [-d duration]
+//
+// Without `-c`, the lines are simulated in memory (this measures the engine alone).
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "../gpio.h"
+#include "../pwm.h"
+#include "../timing.h"
+
+#define MAX_CHANNELS      64
+/** The duty resolution required for a frequency to be "achievable" (1%). */
+#define TARGET_RESOLUTION 0.01
+
+/**
+ * The lines driven by the engine: the first `count` lines of a GPIO request, or an array in memory.
+ */
+
+struct bench_lines {
+    struct gpio_output *output;
+    int                values[MAX_CHANNELS];
+};
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+int lines_set_values(void *context, int count, const int *line_ids, const int *values) {
+    struct bench_lines *lines = (struct bench_lines*)context;
+
+    for (int i=0; i<count; i++) {
+        lines->values[line_ids[i]] = values[i];
+    }
+    return NULL == lines->output ? 0 : gpio_output_set_values(lines->output, lines->values);
+}
+
+int lines_set_value(void *context, int line_id, int value) {
+    return lines_set_values(context, 1, &line_id, &value);
+}
+
+/**
+ * Drive `count` channels at `frequency` for `duration` nano seconds.
+ * @return The duty resolution (p99 lateness / period).
+ */
+
+double measure(struct gpio_chip *chip, unsigned int first, int count, int64_t frequency, int64_t duration) {
+    struct bench_lines lines;
+    struct output_backend backend = { &lines, &lines_set_value, &lines_set_values };
+    struct pwm pwm;
+    int64_t period = NSEC_PER_SEC / frequency;
+    int64_t p99;
+    double resolution;
+
+    lines.output = NULL;
+    for (int i=0; i<count; i++) {
+        lines.values[i] = 0;
+    }
+    if (NULL != chip) {
+        unsigned int offsets[MAX_CHANNELS];
+
+        for (int i=0; i<count; i++) {
+            offsets[i] = first + (unsigned int)i;
+        }
+        lines.output = gpio_output_request(chip, "bench", offsets, count, lines.values);
+        if (NULL == lines.output) {
+            error("cannot request the output lines");
+        }
+    }
+
+    if (-1 == pwm_init(&pwm, count, &backend)) {
+        error("cannot create the PWM engine");
+    }
+    for (int i=0; i<count; i++) {
+        int percent = count > 1 ? 10 + 80 * i / (count - 1) : 50;
+
+        if (-1 == pwm_add(&pwm, i, period, period * percent / 100)) {
+            error("cannot add a channel");
+        }
+    }
+    if (-1 == pwm_run(&pwm, timing_now() + 1000000, duration)) {
+        error("cannot change the value of the lines");
+    }
+
+    p99 = histogram_percentile(&pwm.lateness, 99.0);
+    resolution = (double)p99 / (double)period;
+    printf("%2d channels, %6lld Hz: %8ld edges, %6.2f edges/commit, lateness p50 %7lld ns, p99 %7lld ns, "
+           "max %8lld ns, duty resolution %6.2f%%\n",
+           count, (long long)frequency, pwm.edges, pwm.commits > 0 ? (double)pwm.edges / (double)pwm.commits : 0.0,
+           (long long)histogram_percentile(&pwm.lateness, 50.0), (long long)p99, (long long)pwm.lateness.max,
+           100.0 * resolution);
+
+    pwm_terminate(&pwm);
+    if (NULL != lines.output) {
+        gpio_output_release(lines.output);
+    }
+    return resolution;
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-c chip] [-o first] [-d duration]\n", program);
+    fprintf(stderr, "  -c chip:     the gpio-sim chip (default: lines simulated in memory).\n");
+    fprintf(stderr, "  -o first:    the offset of the first line (default: 0). The chip needs %d lines.\n", MAX_CHANNELS);
+    fprintf(stderr, "  -d duration: the duration of each measure, in seconds (default: 1).\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    int all_counts[] = { 1, 8, 32, MAX_CHANNELS };
+    int64_t all_frequencies[] = { 10, 100, 1000, 2000, 5000, 10000, 20000 };
+    const char *chip_name = NULL;
+    struct gpio_chip *chip = NULL;
+    unsigned int first = 0;
+    int64_t duration = NSEC_PER_SEC;
+    int option;
+
+    while (-1 != (option = getopt(argc, argv, "c:o:d:"))) {
+        switch (option) {
+            case 'c': chip_name = optarg; break;
+            case 'o': first = (unsigned int)atoi(optarg); break;
+            case 'd': duration = (int64_t)(atof(optarg) * NSEC_PER_SEC); break;
+            default: usage(argv[0]);
+        }
+    }
+    if (duration < 1) {
+        usage(argv[0]);
+    }
+    if (NULL != chip_name && NULL == (chip = gpio_chip_open(chip_name))) {
+        error("cannot open the chip");
+    }
+
+    printf("Lines: %s\n", NULL == chip ? "memory" : gpio_backend_name());
+    for (size_t i=0; i<sizeof(all_counts)/sizeof(int); i++) {
+        int64_t achievable = 0;
+
+        for (size_t j=0; j<sizeof(all_frequencies)/sizeof(int64_t); j++) {
+            if (measure(chip, first, all_counts[i], all_frequencies[j], duration) < TARGET_RESOLUTION) {
+                achievable = all_frequencies[j];
+            }
+        }
+        printf("%2d channels: achievable frequency (duty resolution < %.0f%%): %lld Hz\n\n",
+               all_counts[i], 100.0 * TARGET_RESOLUTION, (long long)achievable);
+    }
+
+    if (NULL != chip) {
+        gpio_chip_close(chip);
+    }
+    return 0;
+}
@@ -0,0 +1,191 @@
+// Compare a receiver that reacts to the edges inline with a receiver split into a capture thread and a processing
+// thread linked by the lock-free ring (see event_ring.h).
+//
+// The edges are simulated, so the benchmark runs anywhere (no GPIO chip is required). They arrive in bursts, and
+// they are queued in a simulated kernel queue of 16 events (the size of the queue of a line): events that arrive
+// while the queue is full are lost, as they would be in the kernel. Reading the queue costs READ_COST_NS and
+// reacting to an event costs the processing cost (the equivalent of a printf and a write to the controller line).
+//
+// For each configuration, the program reports the sustained rate of processed events and the lost events.
+//
+//     $ ./bench_ring [number of bursts]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../event_ring.h"
+#include "../timing.h"
+
+#define KERNEL_QUEUE_SIZE 16
+#define READ_COST_NS      1000
+#define BURST_SPACING_NS  1000
+#define RING_CAPACITY     4096
+#define BATCH_SIZE        64
+
+/**
+ * Simulated line: the events of a burst are BURST_SPACING_NS apart, and the bursts are `burst_period` apart.
+ */
+
+struct source {
+    int64_t epoch;
+    int64_t burst_period;
+    long    burst_size;
+    long    total;
+    /** The index of the next event to arrive in the queue. */
+    long    next;
+    /** The number of events in the queue. */
+    long    queued;
+    long    lost;
+};
+
+int64_t arrival_of(const struct source *source, long index) {
+    return source->epoch + (index / source->burst_size) * source->burst_period
+           + (index % source->burst_size) * BURST_SPACING_NS;
+}
+
+void spin_for(int64_t duration) {
+    int64_t end = timing_now() + duration;
+    while (timing_now() < end);
+}
+
+/**
+ * Move the events that have arrived into the queue. The events that arrive while the queue is full are lost.
+ */
+
+void source_update(struct source *source) {
+    int64_t now = timing_now();
+
+    while (source->next < source->total && arrival_of(source, source->next) <= now) {
+        if (source->queued < KERNEL_QUEUE_SIZE) {
+            source->queued++;
+        } else {
+            source->lost++;
+        }
+        source->next++;
+    }
+}
+
+/**
+ * The equivalent of `gpio_input_wait()` followed by `gpio_input_read()`.
+ * @return The number of events read, or 0 when all the events have arrived and have been read (or lost).
+ */
+
+int source_read(struct source *source, struct gpio_event *events, int max) {
+    int count;
+
+    source_update(source);
+    while (0 == source->queued) {
+        if (source->next >= source->total) {
+            return 0;
+        }
+        timing_sleep_until(arrival_of(source, source->next));
+        source_update(source);
+    }
+    spin_for(READ_COST_NS);
+    source_update(source);
+
+    count = source->queued < max ? (int)source->queued : max;
+    for (int i=0; i<count; i++) {
+        events[i].timestamp    = timing_now();
+        events[i].offset       = 0;
+        events[i].rising       = 0;
+        events[i].global_seqno = 0;
+        events[i].line_seqno   = 0;
+    }
+    source->queued -= count;
+    return count;
+}
+
+struct consumer_args {
+    struct event_ring *ring;
+    int64_t process_cost;
+    long    processed;
+};
+
+void* consumer_thread(void *in_args) {
+    struct consumer_args *args = (struct consumer_args*)in_args;
+    struct gpio_event events[BATCH_SIZE];
+
+    while (1 == event_ring_wait(args->ring)) {
+        int count = event_ring_pop(args->ring, events, BATCH_SIZE);
+
+        spin_for(count * args->process_cost);
+        args->processed += count;
+    }
+    return NULL;
+}
+
+void report(const char *mode, const struct source *source, int64_t process_cost, int64_t start, long processed) {
+    double elapsed = (double)(timing_now() - start) / NSEC_PER_SEC;
+
+    printf("%-6s burst %4ld, processing %5lld ns: %9.0f events/s processed, %6ld lost (%5.1f%%)\n",
+           mode, source->burst_size, (long long)process_cost, (double)processed / elapsed,
+           source->lost, 100.0 * (double)source->lost / (double)source->total);
+}
+
+void run_inline(struct source *source, int64_t process_cost) {
+    struct gpio_event events[BATCH_SIZE];
+    long processed = 0;
+    int64_t start = timing_now();
+    int count;
+
+    source->epoch = start;
+    while (0 != (count = source_read(source, events, BATCH_SIZE))) {
+        spin_for(count * process_cost);
+        processed += count;
+    }
+    report("inline", source, process_cost, start, processed);
+}
+
+void run_ring(struct source *source, int64_t process_cost) {
+    struct event_ring ring;
+    struct consumer_args args = { &ring, process_cost, 0 };
+    struct gpio_event events[BATCH_SIZE];
+    pthread_t consumer;
+    int64_t start;
+    int count;
+
+    if (-1 == event_ring_init(&ring, RING_CAPACITY)) {
+        fprintf(stderr, "ERROR: cannot create the ring\n");
+        exit(1);
+    }
+    if (0 != pthread_create(&consumer, NULL, &consumer_thread, &args)) {
+        fprintf(stderr, "ERROR: cannot create the consumer thread\n");
+        exit(1);
+    }
+
+    start = timing_now();
+    source->epoch = start;
+    while (0 != (count = source_read(source, events, BATCH_SIZE))) {
+        event_ring_push(&ring, events, count);
+    }
+    event_ring_close(&ring);
+    pthread_join(consumer, NULL);
+    source->lost += ring.overflows;
+    report("ring", source, process_cost, start, args.processed);
+    event_ring_terminate(&ring);
+}
+
+int main(int argc, char *argv[]) {
+    long all_burst_sizes[] = { 8, 64, 256 };
+    int64_t all_process_costs[] = { 2000, 10000 };
+    long bursts = argc > 1 ? atol(argv[1]) : 50;
+
+    printf("Kernel queue: %d events, read: %d ns, %ld bursts of events %d ns apart\n",
+           KERNEL_QUEUE_SIZE, READ_COST_NS, bursts, BURST_SPACING_NS);
+    for (size_t i=0; i<sizeof(all_burst_sizes)/sizeof(long); i++) {
+        for (size_t j=0; j<sizeof(all_process_costs)/sizeof(int64_t); j++) {
+            // The period of the bursts leaves enough time to process a whole burst.
+            struct source source = { 0, 0, all_burst_sizes[i], all_burst_sizes[i] * bursts, 0, 0, 0 };
+
+            source.burst_period = 2 * source.burst_size * (all_process_costs[j] + BURST_SPACING_NS);
+            run_inline(&source, all_process_costs[j]);
+
+            source.next   = 0;
+            source.queued = 0;
+            source.lost   = 0;
+            run_ring(&source, all_process_costs[j]);
+        }
+    }
+    return 0;
+}
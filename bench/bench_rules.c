@@ -0,0 +1,163 @@
+// Measure the dispatch cost of the rule engine (see rules.h), per edge, for 1, 64 and 512 rules.
+//
+// The rules are spread over 64 input lines (mirror, invert, toggle, pulse, latch and unlatch, in turn) and drive
+// up to 256 output lines. The edges are simulated in memory and applied in batches of 64, each batch being
+// committed with a single (bulk) write to an in-memory backend: this measures the engine alone.
+//
+// The compiled engine (one indexed lookup per edge) is compared with a scan of all the rules for every edge.
+//
+//     $ ./bench_rules [edges]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../rules.h"
+#include "../timing.h"
+
+#define NUMBER_OF_INPUTS  64
+#define NUMBER_OF_OUTPUTS 256
+#define FIRST_OUTPUT      100
+#define BATCH_SIZE        64
+#define PULSE_DURATION_NS 1000000
+/** The time between two simulated edges. */
+#define EDGE_SPACING_NS   1000
+#define DEFAULT_EDGES     (4 * 1024 * 1024)
+
+struct memory_lines {
+    int  values[FIRST_OUTPUT + NUMBER_OF_OUTPUTS];
+    long writes;
+};
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+int memory_set_values(void *context, int count, const int *line_ids, const int *values) {
+    struct memory_lines *lines = (struct memory_lines*)context;
+
+    for (int i=0; i<count; i++) {
+        lines->values[line_ids[i]] = values[i];
+    }
+    lines->writes++;
+    return 0;
+}
+
+int memory_set_value(void *context, int line_id, int value) {
+    return memory_set_values(context, 1, &line_id, &value);
+}
+
+/**
+ * Generate edges on the inputs used by the rules: the inputs are picked at random, each one alternates rising and
+ * falling edges.
+ */
+
+struct gpio_event *generate_edges(long count, int inputs) {
+    struct gpio_event *events = malloc((size_t)count * sizeof(struct gpio_event));
+    int levels[NUMBER_OF_INPUTS] = { 0 };
+    uint64_t state = 0x2545f4914f6cdd1dULL;
+
+    if (NULL == events) {
+        error("out of memory");
+    }
+    for (long i=0; i<count; i++) {
+        int input;
+
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        input = (int)(state % (uint64_t)inputs);
+        levels[input] = !levels[input];
+        events[i].timestamp    = (i + 1) * EDGE_SPACING_NS;
+        events[i].offset       = (unsigned int)input;
+        events[i].rising       = levels[input];
+        events[i].global_seqno = 0;
+        events[i].line_seqno   = 0;
+    }
+    return events;
+}
+
+/**
+ * Apply the rules without the dispatch table: every edge scans all the rules (this is what a direct interpretation
+ * of the configuration costs). Only the mirror and invert rules are evaluated, the cost being in the scan.
+ */
+
+void scan_rules(const struct rule_engine *engine, const int *outputs, int *values, const struct gpio_event *event) {
+    for (size_t i=0; i<engine->size; i++) {
+        const struct rule *rule = &engine->rules[i];
+
+        if (rule->input == event->offset) {
+            values[outputs[i]] = RULE_INVERT == rule->kind ? !event->rising : event->rising;
+        }
+    }
+}
+
+void measure(int rule_count, const struct gpio_event *events, long count) {
+    struct memory_lines lines = { { 0 }, 0 };
+    struct output_backend backend = { &lines, &memory_set_value, &memory_set_values };
+    struct rule_engine engine;
+    int *outputs;
+    int64_t start, compiled, scanned;
+
+    rules_init(&engine);
+    for (int i=0; i<rule_count; i++) {
+        unsigned int output = FIRST_OUTPUT + (unsigned int)(i % NUMBER_OF_OUTPUTS);
+
+        if (-1 == rules_add(&engine, (unsigned int)(i % NUMBER_OF_INPUTS), i % (RULE_UNLATCH + 1), output,
+                            PULSE_DURATION_NS)) {
+            error("cannot add a rule");
+        }
+    }
+    if (-1 == rules_compile(&engine)) {
+        error("cannot compile the rules");
+    }
+    rules_attach(&engine, &backend);
+
+    start = timing_now();
+    for (long i=0; i<count; i+=BATCH_SIZE) {
+        int size = count - i < BATCH_SIZE ? (int)(count - i) : BATCH_SIZE;
+
+        rules_dispatch(&engine, &events[i], size);
+        rules_expire(&engine, events[i + size - 1].timestamp);
+        if (-1 == rules_commit(&engine)) {
+            error("cannot write the outputs");
+        }
+    }
+    compiled = timing_now() - start;
+
+    outputs = malloc(engine.size * sizeof(int));
+    if (NULL == outputs) {
+        error("out of memory");
+    }
+    for (size_t i=0; i<engine.size; i++) {
+        outputs[i] = (int)engine.rules[i].output;
+    }
+    start = timing_now();
+    for (long i=0; i<count; i++) {
+        scan_rules(&engine, outputs, lines.values, &events[i]);
+    }
+    scanned = timing_now() - start;
+
+    printf("%4d rules: compiled %6.1f ns/edge (%4.2f actions/edge, %ld writes), scan %7.1f ns/edge\n",
+           rule_count, (double)compiled / (double)count, (double)engine.triggered / (double)engine.events,
+           lines.writes, (double)scanned / (double)count);
+    free(outputs);
+    rules_terminate(&engine);
+}
+
+int main(int argc, char *argv[]) {
+    int all_counts[] = { 1, 64, 512 };
+    long count = argc > 1 ? atol(argv[1]) : DEFAULT_EDGES;
+
+    if (count < 1) {
+        fprintf(stderr, "Usage: %s [edges]\n", argv[0]);
+        return 1;
+    }
+    for (size_t i=0; i<sizeof(all_counts)/sizeof(int); i++) {
+        int inputs = all_counts[i] < NUMBER_OF_INPUTS ? all_counts[i] : NUMBER_OF_INPUTS;
+        struct gpio_event *events = generate_edges(count, inputs);
+
+        measure(all_counts[i], events, count);
+        free(events);
+    }
+    return 0;
+}
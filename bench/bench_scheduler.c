@@ -0,0 +1,161 @@
+// Compare the "one thread per line" layout of gpio1 with the single-thread scheduler.
+//
+// The lines are simulated in memory, so the benchmark runs anywhere (no GPIO chip is required). For each number
+// of lines, the program reports the number of wakeups per second and the CPU usage.
+//
+//     $ ./bench_scheduler [duration in seconds]
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include "../timing.h"
+#include "../scheduler.h"
+
+#define BASE_PERIOD_NS   10000000 // 10 ms
+#define PERIOD_STEP_NS    1000000 //  1 ms
+#define DISTINCT_PERIODS  10
+#define THREAD_STACK_SIZE (64 * 1024)
+
+/**
+ * In-memory backend: the value of a line is stored in an array.
+ */
+
+struct memory_lines {
+    int *values;
+    long writes;
+};
+
+int memory_set_value(void *context, int line_id, int value) {
+    struct memory_lines *lines = (struct memory_lines*)context;
+    lines->values[line_id] = value;
+    __atomic_fetch_add(&lines->writes, 1, __ATOMIC_RELAXED);
+    return 0;
+}
+
+struct line_args {
+    struct memory_lines *lines;
+    int64_t epoch;
+    int64_t period;
+    long    count;
+    int     line_id;
+    long    wakeups;
+};
+
+/**
+ * The equivalent of `led_thread` (gpio1.c), without the printf.
+ */
+
+void* line_thread(void *in_args) {
+    struct line_args *args = (struct line_args*)in_args;
+    struct deadline schedule;
+
+    deadline_init(&schedule, args->epoch, args->period / NSEC_PER_SEC, args->period % NSEC_PER_SEC);
+    for (long cycle=0; cycle<args->count; cycle++) {
+        memory_set_value(args->lines, args->line_id, (cycle & 0x1) != 0);
+        deadline_wait(&schedule, NULL);
+    }
+    memory_set_value(args->lines, args->line_id, 0);
+    args->wakeups = schedule.waits;
+    return NULL;
+}
+
+int64_t period_of(int line_id) {
+    return BASE_PERIOD_NS + (int64_t)(line_id % DISTINCT_PERIODS) * PERIOD_STEP_NS;
+}
+
+int64_t cpu_time(struct rusage *usage) {
+    return ((int64_t)usage->ru_utime.tv_sec + usage->ru_stime.tv_sec) * NSEC_PER_SEC
+           + ((int64_t)usage->ru_utime.tv_usec + usage->ru_stime.tv_usec) * 1000;
+}
+
+void report(const char *mode, int number_of_lines, int64_t start, long wakeups, struct rusage *before) {
+    struct rusage after;
+    double elapsed = (double)(timing_now() - start) / NSEC_PER_SEC;
+
+    getrusage(RUSAGE_SELF, &after);
+    printf("%-9s %5d lines: %9.0f wakeups/s, %9.0f context switches/s, CPU %6.2f%%\n",
+           mode, number_of_lines, (double)wakeups / elapsed,
+           (double)(after.ru_nvcsw + after.ru_nivcsw - before->ru_nvcsw - before->ru_nivcsw) / elapsed,
+           100.0 * (double)(cpu_time(&after) - cpu_time(before)) / NSEC_PER_SEC / elapsed);
+}
+
+void run_threads(struct memory_lines *lines, int number_of_lines, double duration) {
+    pthread_t *threads = calloc(number_of_lines, sizeof(pthread_t));
+    struct line_args *args = calloc(number_of_lines, sizeof(struct line_args));
+    pthread_attr_t attributes;
+    struct rusage before;
+    int64_t start;
+    long wakeups = 0;
+
+    if (NULL == threads || NULL == args) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    // With the default stack size (8 MB), 1024 threads do not even fit in the address space of a 32 bits Pi.
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, THREAD_STACK_SIZE);
+
+    getrusage(RUSAGE_SELF, &before);
+    start = timing_now();
+    for (int i=0; i<number_of_lines; i++) {
+        args[i].lines   = lines;
+        args[i].epoch   = start;
+        args[i].period  = period_of(i);
+        args[i].count   = (long)(duration * NSEC_PER_SEC / (double)args[i].period);
+        args[i].line_id = i;
+        if (0 != pthread_create(&threads[i], &attributes, &line_thread, &args[i])) {
+            fprintf(stderr, "ERROR: cannot create thread #%d\n", i);
+            exit(1);
+        }
+    }
+    for (int i=0; i<number_of_lines; i++) {
+        pthread_join(threads[i], NULL);
+        wakeups += args[i].wakeups;
+    }
+    report("threads", number_of_lines, start, wakeups, &before);
+
+    pthread_attr_destroy(&attributes);
+    free(args);
+    free(threads);
+}
+
+void run_scheduler(struct memory_lines *lines, int number_of_lines, double duration) {
+    struct output_backend backend = { lines, &memory_set_value, NULL };
+    struct scheduler scheduler;
+    struct rusage before;
+    int64_t start;
+
+    if (-1 == scheduler_init(&scheduler, number_of_lines, &backend)) {
+        fprintf(stderr, "ERROR: cannot create the scheduler\n");
+        exit(1);
+    }
+    for (int i=0; i<number_of_lines; i++) {
+        int64_t period = period_of(i);
+        scheduler_add(&scheduler, period / NSEC_PER_SEC, period % NSEC_PER_SEC,
+                      (long)(duration * NSEC_PER_SEC / (double)period), i, NULL);
+    }
+
+    getrusage(RUSAGE_SELF, &before);
+    start = timing_now();
+    scheduler_run(&scheduler, start);
+    report("scheduler", number_of_lines, start, scheduler.wakeups, &before);
+    scheduler_terminate(&scheduler);
+}
+
+int main(int argc, char *argv[]) {
+    int all_numbers_of_lines[] = { 2, 64, 1024 };
+    double duration = argc > 1 ? atof(argv[1]) : 2.0;
+
+    printf("Periods: %d distinct values from %d ms, duration: %.1f s\n",
+           DISTINCT_PERIODS, BASE_PERIOD_NS / 1000000, duration);
+    for (size_t i=0; i<sizeof(all_numbers_of_lines)/sizeof(int); i++) {
+        int number_of_lines = all_numbers_of_lines[i];
+        struct memory_lines lines = { calloc(number_of_lines, sizeof(int)), 0 };
+
+        run_threads(&lines, number_of_lines, duration);
+        run_scheduler(&lines, number_of_lines, duration);
+        free(lines.values);
+    }
+    return 0;
+}
@@ -0,0 +1,308 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "capture.h"
+
+#define TIME_BITS 56
+#define TIME_MASK ((1ULL << TIME_BITS) - 1)
+
+static uint64_t pack(int64_t time, int index, int value) {
+    return ((uint64_t)time << 8) | ((uint64_t)index << 1) | (uint64_t)(value != 0);
+}
+
+static int64_t unpack_time(uint64_t record) {
+    return (int64_t)(record >> 8);
+}
+
+static int unpack_index(uint64_t record) {
+    return (int)((record >> 1) & 0x7f);
+}
+
+static int unpack_value(uint64_t record) {
+    return (int)(record & 0x1);
+}
+
+/**
+ * Initialise a capture.
+ * @param capture The capture to initialise.
+ * @param offsets The offsets of the captured lines.
+ * @param count The number of lines (at most CAPTURE_MAX_LINES).
+ * @param pretrigger The number of edges kept before the trigger (rounded up to a power of two).
+ * @param writer The object that stores the captured edges.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int capture_init(struct capture *capture, const unsigned int *offsets, int count, size_t pretrigger,
+                 const struct capture_writer *writer) {
+    size_t capacity = 1;
+
+    if (count < 1 || count > CAPTURE_MAX_LINES) {
+        errno = EINVAL;
+        return -1;
+    }
+    while (capacity < pretrigger) {
+        capacity <<= 1;
+    }
+    memset(capture->base, -1, sizeof(capture->base));
+    memset(capture->values, -1, sizeof(capture->values));
+    capture->indexes_size = 0;
+    for (int i=0; i<count; i++) {
+        capture->offsets[i] = offsets[i];
+        if (offsets[i] + 1 > capture->indexes_size) {
+            capture->indexes_size = offsets[i] + 1;
+        }
+    }
+    capture->line_count      = count;
+    capture->condition_count = 0;
+    capture->indexes         = malloc(capture->indexes_size);
+    capture->ring            = malloc(capacity * sizeof(uint64_t));
+    capture->mask            = capacity - 1;
+    capture->head            = 0;
+    capture->tail            = 0;
+    capture->origin          = 0;
+    capture->trigger         = 0;
+    capture->post_duration   = 0;
+    capture->post_events     = 0;
+    capture->writer          = *writer;
+    capture->events          = 0;
+    capture->written         = 0;
+    capture->post_written    = 0;
+    if (NULL == capture->indexes || NULL == capture->ring) {
+        capture_terminate(capture);
+        errno = ENOMEM;
+        return -1;
+    }
+    memset(capture->indexes, -1, capture->indexes_size);
+    for (int i=0; i<count; i++) {
+        if (-1 != capture->indexes[offsets[i]]) {
+            capture_terminate(capture);
+            errno = EEXIST;
+            return -1;
+        }
+        capture->indexes[offsets[i]] = (int8_t)i;
+    }
+    return 0;
+}
+
+/**
+ * Set the values of the lines before the first edge (ex: read when the lines are requested). Otherwise, the value
+ * of a line is unknown until its first edge: a level condition on it cannot be met.
+ * @param capture The capture.
+ * @param values The values of the lines (0 or 1), in the order of the offsets given to `capture_init()`.
+ */
+
+void capture_set_levels(struct capture *capture, const int *values) {
+    for (int i=0; i<capture->line_count; i++) {
+        capture->base[i]   = (int8_t)(0 != values[i]);
+        capture->values[i] = capture->base[i];
+    }
+}
+
+/**
+ * Add a trigger condition.
+ * @param capture The capture.
+ * @param offset The offset of a captured line.
+ * @param kind CAPTURE_RISING, CAPTURE_FALLING, CAPTURE_EDGE, CAPTURE_HIGH or CAPTURE_LOW.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int capture_add_condition(struct capture *capture, unsigned int offset, int kind) {
+    if (capture->condition_count == CAPTURE_MAX_CONDITIONS) {
+        errno = ENOSPC;
+        return -1;
+    }
+    if (offset >= capture->indexes_size || -1 == capture->indexes[offset] || kind < CAPTURE_RISING
+        || kind > CAPTURE_LOW) {
+        errno = EINVAL;
+        return -1;
+    }
+    capture->conditions[capture->condition_count].index = capture->indexes[offset];
+    capture->conditions[capture->condition_count].kind  = kind;
+    capture->condition_count++;
+    return 0;
+}
+
+/**
+ * Add a trigger condition given as text: `<offset>:rising`, `falling`, `edge`, `high` or `low`.
+ * @param capture The capture.
+ * @param text The condition.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int capture_parse_condition(struct capture *capture, const char *text) {
+    static const char *all_kinds[] = { "rising", "falling", "edge", "high", "low" };
+    char *end;
+    unsigned long offset = strtoul(text, &end, 10);
+
+    if (end != text && ':' == *end) {
+        for (int kind=CAPTURE_RISING; kind<=CAPTURE_LOW; kind++) {
+            if (0 == strcmp(end + 1, all_kinds[kind])) {
+                return capture_add_condition(capture, (unsigned int)offset, kind);
+            }
+        }
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+/**
+ * Set the end of the capture, after the trigger.
+ * @param capture The capture.
+ * @param post_duration The duration of the capture after the trigger, in nano seconds (0: no limit).
+ * @param post_events The number of edges captured after the trigger (0: no limit).
+ */
+
+void capture_set_limits(struct capture *capture, int64_t post_duration, long post_events) {
+    capture->post_duration = post_duration;
+    capture->post_events   = post_events;
+}
+
+static int triggered_by(const struct capture *capture, int index, int rising) {
+    for (int i=0; i<capture->condition_count; i++) {
+        const struct capture_condition *condition = &capture->conditions[i];
+
+        switch (condition->kind) {
+            case CAPTURE_RISING:  if (condition->index != index || !rising) return 0; break;
+            case CAPTURE_FALLING: if (condition->index != index || rising) return 0; break;
+            case CAPTURE_EDGE:    if (condition->index != index) return 0; break;
+            case CAPTURE_HIGH:    if (1 != capture->values[condition->index]) return 0; break;
+            default:              if (0 != capture->values[condition->index]) return 0; break;
+        }
+    }
+    return 1;
+}
+
+/**
+ * Write the content of the pre-trigger ring, and start streaming.
+ * @param capture The capture.
+ * @param trigger The time of the trigger (0: the capture ends before the trigger).
+ * @param now The time to use as origin if the ring is empty.
+ */
+
+static int flush_ring(struct capture *capture, int64_t trigger, int64_t now) {
+    int8_t initial[CAPTURE_MAX_LINES];
+    int64_t origin = capture->head != capture->tail
+                     ? capture->origin + unpack_time(capture->ring[capture->tail & capture->mask]) : now;
+
+    // The value of a line before its first edge is the opposite of the edge.
+    memcpy(initial, capture->base, sizeof(initial));
+    for (size_t i=capture->tail; i!=capture->head; i++) {
+        uint64_t record = capture->ring[i & capture->mask];
+
+        if (-1 == initial[unpack_index(record)]) {
+            initial[unpack_index(record)] = (int8_t)!unpack_value(record);
+        }
+    }
+    if (-1 == capture->writer.begin(capture->writer.context, capture, origin, trigger, initial)) {
+        return -1;
+    }
+    for (; capture->tail!=capture->head; capture->tail++) {
+        uint64_t record = capture->ring[capture->tail & capture->mask];
+
+        if (-1 == capture->writer.change(capture->writer.context, capture->origin + unpack_time(record),
+                                         unpack_index(record), unpack_value(record))) {
+            return -1;
+        }
+        capture->written++;
+    }
+    return 0;
+}
+
+/**
+ * Record an edge.
+ * @param capture The capture.
+ * @param event The edge (the edges of the lines that are not captured are ignored).
+ * @return 1 if the capture is complete (the edge is after the end of the capture, or is its last edge), 0 if the
+ *         capture goes on, or -1 if the writer has failed (`errno` is set).
+ */
+
+int capture_record(struct capture *capture, const struct gpio_event *event) {
+    int rising = event->rising != 0;
+    int index;
+
+    if (event->offset >= capture->indexes_size || -1 == (index = capture->indexes[event->offset])) {
+        return 0;
+    }
+
+    // After the trigger: stream.
+    if (0 != capture->trigger) {
+        if ((capture->post_duration > 0 && event->timestamp >= capture->trigger + capture->post_duration)
+            || (capture->post_events > 0 && capture->post_written >= capture->post_events)) {
+            return 1;
+        }
+        capture->events++;
+        capture->post_written++;
+        capture->values[index] = (int8_t)rising;
+        if (-1 == capture->writer.change(capture->writer.context, event->timestamp, index, rising)) {
+            return -1;
+        }
+        capture->written++;
+        return capture->post_events > 0 && capture->post_written >= capture->post_events;
+    }
+
+    // Before the trigger: the oldest edge of a full ring is overwritten.
+    if (0 == capture->events) {
+        capture->origin = event->timestamp;
+    }
+    capture->events++;
+    if (capture->head - capture->tail > capture->mask) {
+        uint64_t oldest = capture->ring[capture->tail & capture->mask];
+
+        capture->base[unpack_index(oldest)] = (int8_t)unpack_value(oldest);
+        capture->tail++;
+    }
+    capture->ring[capture->head & capture->mask] = pack((event->timestamp - capture->origin) & TIME_MASK, index,
+                                                        rising);
+    capture->head++;
+    capture->values[index] = (int8_t)rising;
+
+    if (triggered_by(capture, index, rising)) {
+        capture->trigger = event->timestamp;
+        if (-1 == flush_ring(capture, capture->trigger, event->timestamp)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Tell whether the post-trigger duration has elapsed (call it while no edge arrives).
+ * @param capture The capture.
+ * @param now The current time (see `timing_now()`).
+ * @return 1 if the capture is complete, 0 otherwise.
+ */
+
+int capture_expired(const struct capture *capture, int64_t now) {
+    return 0 != capture->trigger && capture->post_duration > 0 && now >= capture->trigger + capture->post_duration;
+}
+
+/**
+ * Terminate the output of a capture. If the capture has not been triggered, the content of the pre-trigger ring is
+ * written (without trigger).
+ * @param capture The capture.
+ * @param end The end of the capture (ex: `timing_now()`). It is limited to the post-trigger duration.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int capture_finish(struct capture *capture, int64_t end) {
+    if (0 == capture->trigger && -1 == flush_ring(capture, 0, end)) {
+        capture->writer.end(capture->writer.context, end);
+        return -1;
+    }
+    if (0 != capture->trigger && capture->post_duration > 0 && end > capture->trigger + capture->post_duration) {
+        end = capture->trigger + capture->post_duration;
+    }
+    return capture->writer.end(capture->writer.context, end);
+}
+
+/**
+ * Free the resources allocated by a capture.
+ * @param capture The capture.
+ */
+
+void capture_terminate(struct capture *capture) {
+    free(capture->indexes);
+    free(capture->ring);
+    capture->indexes = NULL;
+    capture->ring    = NULL;
+}
@@ -0,0 +1,110 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "gpio.h"
+
+/** The maximum number of lines of a capture. */
+#define CAPTURE_MAX_LINES      64
+/** The maximum number of trigger conditions. */
+#define CAPTURE_MAX_CONDITIONS 8
+
+/** Trigger conditions (see `capture_add_condition()`). */
+#define CAPTURE_RISING  0
+#define CAPTURE_FALLING 1
+#define CAPTURE_EDGE    2
+#define CAPTURE_HIGH    3
+#define CAPTURE_LOW     4
+
+struct capture;
+
+/**
+ * The object that stores the captured edges (ex: a VCD file). The times are kernel timestamps, in nano seconds.
+ * All the functions must return 0 upon successful completion, or -1 in case of error.
+ */
+
+struct capture_writer {
+    /** Opaque data passed to the functions below. */
+    void *context;
+    /**
+     * Start the output.
+     * @param origin The time of the first edge of the output (the oldest pre-trigger edge).
+     * @param trigger The time of the trigger.
+     * @param values The values of the lines at `origin`, before its edge (1, 0, or -1: unknown).
+     */
+    int (*begin)(void *context, const struct capture *capture, int64_t origin, int64_t trigger,
+                 const int8_t *values);
+    /** Change the value of a line (`index` is the index of the line in the capture). */
+    int (*change)(void *context, int64_t time, int index, int value);
+    /** Terminate the output (`time` is the end of the capture) and free the writer. */
+    int (*end)(void *context, int64_t time);
+};
+
+struct capture_condition {
+    /** The index of the line in the capture. */
+    int index;
+    /** CAPTURE_RISING, CAPTURE_FALLING, CAPTURE_EDGE, CAPTURE_HIGH or CAPTURE_LOW. */
+    int kind;
+};
+
+/**
+ * Logic-analyzer capture of the edges of a set of lines.
+ *
+ * Until the trigger, the edges are kept in a ring of fixed size (the pre-trigger buffer), as packed 64-bit
+ * records: the time since the first edge (56 bits), the index of the line (7 bits) and the value (1 bit). The
+ * oldest edges are overwritten. When the trigger conditions are met, the ring is written to the writer, then the
+ * following edges are streamed to it, so that the memory used by a capture does not depend on its duration.
+ *
+ * The trigger fires on an edge that satisfies all the conditions: the edge conditions (rising, falling, any edge)
+ * apply to the edge itself, the level conditions (high, low) to the values of the lines once the edge is applied.
+ * Without condition, the capture is triggered by the first edge.
+ */
+
+struct capture {
+    unsigned int offsets[CAPTURE_MAX_LINES];
+    int          line_count;
+    /** The index of each line, by offset (-1: not captured). */
+    int8_t       *indexes;
+    unsigned int indexes_size;
+    struct capture_condition conditions[CAPTURE_MAX_CONDITIONS];
+    int          condition_count;
+    /** The pre-trigger ring. */
+    uint64_t     *ring;
+    size_t       mask;
+    size_t       head;
+    size_t       tail;
+    /** The timestamp of the first edge: the origin of the times of the ring. */
+    int64_t      origin;
+    /** The values of the lines before the oldest edge of the ring (-1: unknown). */
+    int8_t       base[CAPTURE_MAX_LINES];
+    /** The current values of the lines (-1: unknown). */
+    int8_t       values[CAPTURE_MAX_LINES];
+    /** After the trigger: the time of the trigger (0: not triggered yet). */
+    int64_t      trigger;
+    /** The post-trigger limits: a duration in nano seconds and a number of edges (0: no limit). */
+    int64_t      post_duration;
+    long         post_events;
+    struct capture_writer writer;
+    /** The number of edges captured, written to the writer, and written after the trigger. */
+    long         events;
+    long         written;
+    long         post_written;
+};
+
+int capture_init(struct capture *capture, const unsigned int *offsets, int count, size_t pretrigger,
+                 const struct capture_writer *writer);
+void capture_set_levels(struct capture *capture, const int *values);
+int capture_add_condition(struct capture *capture, unsigned int offset, int kind);
+int capture_parse_condition(struct capture *capture, const char *text);
+void capture_set_limits(struct capture *capture, int64_t post_duration, long post_events);
+int capture_record(struct capture *capture, const struct gpio_event *event);
+int capture_expired(const struct capture *capture, int64_t now);
+int capture_finish(struct capture *capture, int64_t end);
+void capture_terminate(struct capture *capture);
+
+int capture_vcd_open(struct capture_writer *writer, const char *path);
+int capture_sigrok_open(struct capture_writer *writer, const char *path, int64_t samplerate);
+
+#endif // CAPTURE_H
@@ -0,0 +1,415 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+#include "capture.h"
+
+// ---------------------------------------------------------------------------------
+// VCD
+// ---------------------------------------------------------------------------------
+
+// Value Change Dump (IEEE 1364): a text file that lists the changes of value of the lines, with their times in nano
+// seconds. It can be opened by GTKWave, PulseView (sigrok)...
+
+struct vcd_writer {
+    FILE    *file;
+    /** The time of the first edge: the times of the file are relative to it. */
+    int64_t origin;
+    /** The time of the last change written to the file (relative). */
+    int64_t last_time;
+};
+
+/** The VCD identifier of a line: a printable character. */
+static char vcd_identifier(int index) {
+    return (char)('!' + index);
+}
+
+static int vcd_begin(void *context, const struct capture *capture, int64_t origin, int64_t trigger,
+                     const int8_t *values) {
+    struct vcd_writer *writer = (struct vcd_writer*)context;
+
+    writer->origin    = origin;
+    writer->last_time = 0;
+    fprintf(writer->file, "$comment %d GPIO lines $end\n", capture->line_count);
+    if (0 != trigger) {
+        fprintf(writer->file, "$comment trigger at %lld ns $end\n", (long long)(trigger - origin));
+    }
+    fprintf(writer->file, "$timescale 1ns $end\n$scope module gpio $end\n");
+    for (int i=0; i<capture->line_count; i++) {
+        fprintf(writer->file, "$var wire 1 %c gpio%u $end\n", vcd_identifier(i), capture->offsets[i]);
+    }
+    fprintf(writer->file, "$upscope $end\n$enddefinitions $end\n#0\n$dumpvars\n");
+    for (int i=0; i<capture->line_count; i++) {
+        fprintf(writer->file, "%c%c\n", -1 == values[i] ? 'x' : '0' + values[i], vcd_identifier(i));
+    }
+    fprintf(writer->file, "$end\n");
+    return ferror(writer->file) ? -1 : 0;
+}
+
+static int vcd_change(void *context, int64_t time, int index, int value) {
+    struct vcd_writer *writer = (struct vcd_writer*)context;
+    int64_t relative = time - writer->origin;
+
+    if (relative != writer->last_time) {
+        fprintf(writer->file, "#%lld\n", (long long)relative);
+        writer->last_time = relative;
+    }
+    return fprintf(writer->file, "%d%c\n", value, vcd_identifier(index)) < 0 ? -1 : 0;
+}
+
+static int vcd_end(void *context, int64_t time) {
+    struct vcd_writer *writer = (struct vcd_writer*)context;
+    int64_t relative = time - writer->origin;
+    int status;
+
+    if (relative > writer->last_time) {
+        fprintf(writer->file, "#%lld\n", (long long)relative);
+    }
+    status = ferror(writer->file) ? -1 : 0;
+    if (0 != fclose(writer->file)) {
+        status = -1;
+    }
+    free(writer);
+    return status;
+}
+
+/**
+ * Create a writer that stores a capture in a VCD file.
+ * @param writer The writer to initialise.
+ * @param path The path of the file.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int capture_vcd_open(struct capture_writer *writer, const char *path) {
+    struct vcd_writer *vcd = malloc(sizeof(struct vcd_writer));
+
+    if (NULL == vcd) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (NULL == (vcd->file = fopen(path, "w"))) {
+        free(vcd);
+        return -1;
+    }
+    writer->context = vcd;
+    writer->begin   = &vcd_begin;
+    writer->change  = &vcd_change;
+    writer->end     = &vcd_end;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------
+// SIGROK
+// ---------------------------------------------------------------------------------
+
+// Sigrok session file (version 2): a ZIP archive that contains a `version` file, a `metadata` file and the samples
+// of the lines (`logic-1-1`), one bit per line, at a fixed sample rate. It can be opened by PulseView and
+// sigrok-cli. The samples are streamed into the archive (stored, without compression): the size of the
+// archive is limited to 4 GB.
+
+#define ZIP_MAX_ENTRIES     3
+#define SIGROK_CHUNK_SIZE   (64 * 1024)
+#define SIGROK_METADATA_SIZE 4096
+
+struct zip_entry {
+    const char *name;
+    uint32_t   crc;
+    uint32_t   size;
+    uint32_t   offset;
+    /** 0x0008: the CRC and the size follow the data (data descriptor). */
+    uint16_t   flags;
+};
+
+struct sigrok_writer {
+    FILE     *file;
+    int64_t  samplerate;
+    int      unitsize;
+    struct zip_entry entries[ZIP_MAX_ENTRIES];
+    int      entry_count;
+    /** The size of the archive so far. */
+    uint64_t offset;
+    /** The time of the first sample, and the index of the next sample to write. */
+    int64_t  origin;
+    int64_t  next_sample;
+    /** The current values of the lines (one bit per line). */
+    uint8_t  state[CAPTURE_MAX_LINES / 8];
+    /** The samples not yet written, and the CRC and the size of the samples already written. */
+    uint8_t  chunk[SIGROK_CHUNK_SIZE];
+    size_t   used;
+    uint32_t crc;
+    uint64_t size;
+    char     metadata[SIGROK_METADATA_SIZE];
+};
+
+static uint32_t crc_table[256];
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t size) {
+    if (0 == crc_table[1]) {
+        for (uint32_t i=0; i<256; i++) {
+            uint32_t c = i;
+
+            for (int bit=0; bit<8; bit++) {
+                c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+            }
+            crc_table[i] = c;
+        }
+    }
+    crc = ~crc;
+    for (size_t i=0; i<size; i++) {
+        crc = crc_table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put16(uint8_t *buffer, uint16_t value) {
+    buffer[0] = (uint8_t)value;
+    buffer[1] = (uint8_t)(value >> 8);
+}
+
+static void put32(uint8_t *buffer, uint32_t value) {
+    put16(buffer, (uint16_t)value);
+    put16(buffer + 2, (uint16_t)(value >> 16));
+}
+
+static int zip_write(struct sigrok_writer *writer, const void *data, size_t size) {
+    if (writer->offset + size > UINT32_MAX) {
+        errno = EFBIG;
+        return -1;
+    }
+    if (size != fwrite(data, 1, size, writer->file)) {
+        return -1;
+    }
+    writer->offset += size;
+    return 0;
+}
+
+/**
+ * Start a file of the archive: write its local header.
+ * If `flags` is 0x0008, the CRC and the size are unknown: they are written after the data (see `zip_end_entry()`).
+ */
+
+static int zip_begin_entry(struct sigrok_writer *writer, const char *name, uint32_t crc, uint32_t size,
+                           uint16_t flags) {
+    struct zip_entry *entry = &writer->entries[writer->entry_count++];
+    uint8_t header[30];
+
+    entry->name   = name;
+    entry->crc    = crc;
+    entry->size   = size;
+    entry->offset = (uint32_t)writer->offset;
+    entry->flags  = flags;
+    put32(header, 0x04034b50);
+    put16(header + 4, 20);      // Version needed: 2.0.
+    put16(header + 6, flags);
+    put16(header + 8, 0);       // Stored.
+    put16(header + 10, 0);      // Time.
+    put16(header + 12, 0x21);   // Date: 1980-01-01.
+    put32(header + 14, crc);
+    put32(header + 18, size);   // Compressed size.
+    put32(header + 22, size);
+    put16(header + 26, (uint16_t)strlen(name));
+    put16(header + 28, 0);      // Extra field.
+    return zip_write(writer, header, sizeof(header)) || zip_write(writer, name, strlen(name)) ? -1 : 0;
+}
+
+static int zip_add_file(struct sigrok_writer *writer, const char *name, const char *content) {
+    size_t size = strlen(content);
+
+    if (-1 == zip_begin_entry(writer, name, crc32_update(0, (const uint8_t*)content, size), (uint32_t)size, 0)) {
+        return -1;
+    }
+    return zip_write(writer, content, size);
+}
+
+/** Write the data descriptor of the streamed file. */
+static int zip_end_entry(struct sigrok_writer *writer, uint32_t crc, uint32_t size) {
+    struct zip_entry *entry = &writer->entries[writer->entry_count - 1];
+    uint8_t descriptor[16];
+
+    entry->crc  = crc;
+    entry->size = size;
+    put32(descriptor, 0x08074b50);
+    put32(descriptor + 4, crc);
+    put32(descriptor + 8, size);
+    put32(descriptor + 12, size);
+    return zip_write(writer, descriptor, sizeof(descriptor));
+}
+
+/** Write the central directory. */
+static int zip_close(struct sigrok_writer *writer) {
+    uint32_t directory = (uint32_t)writer->offset;
+    uint8_t header[46];
+    uint8_t end[22];
+
+    for (int i=0; i<writer->entry_count; i++) {
+        const struct zip_entry *entry = &writer->entries[i];
+
+        memset(header, 0, sizeof(header));
+        put32(header, 0x02014b50);
+        put16(header + 4, 20);  // Version made by.
+        put16(header + 6, 20);  // Version needed.
+        put16(header + 8, entry->flags);
+        put16(header + 14, 0x21);
+        put32(header + 16, entry->crc);
+        put32(header + 20, entry->size);
+        put32(header + 24, entry->size);
+        put16(header + 28, (uint16_t)strlen(entry->name));
+        put32(header + 42, entry->offset);
+        if (-1 == zip_write(writer, header, sizeof(header)) || -1 == zip_write(writer, entry->name, strlen(entry->name))) {
+            return -1;
+        }
+    }
+    memset(end, 0, sizeof(end));
+    put32(end, 0x06054b50);
+    put16(end + 8, (uint16_t)writer->entry_count);
+    put16(end + 10, (uint16_t)writer->entry_count);
+    put32(end + 12, (uint32_t)writer->offset - directory);
+    put32(end + 16, directory);
+    return zip_write(writer, end, sizeof(end));
+}
+
+static int sigrok_flush(struct sigrok_writer *writer) {
+    writer->crc   = crc32_update(writer->crc, writer->chunk, writer->used);
+    writer->size += writer->used;
+    if (-1 == zip_write(writer, writer->chunk, writer->used)) {
+        return -1;
+    }
+    writer->used = 0;
+    return 0;
+}
+
+/** Write the samples up to `sample` (excluded), with the current values of the lines. */
+static int sigrok_fill(struct sigrok_writer *writer, int64_t sample) {
+    for (; writer->next_sample<sample; writer->next_sample++) {
+        if (writer->used + (size_t)writer->unitsize > SIGROK_CHUNK_SIZE && -1 == sigrok_flush(writer)) {
+            return -1;
+        }
+        memcpy(&writer->chunk[writer->used], writer->state, (size_t)writer->unitsize);
+        writer->used += (size_t)writer->unitsize;
+    }
+    return 0;
+}
+
+static int64_t sigrok_sample_of(const struct sigrok_writer *writer, int64_t time) {
+    int64_t relative = time - writer->origin;
+
+    return relative / NSEC_PER_SEC * writer->samplerate + relative % NSEC_PER_SEC * writer->samplerate / NSEC_PER_SEC;
+}
+
+static void format_samplerate(char *buffer, size_t size, int64_t samplerate) {
+    if (0 == samplerate % 1000000000) {
+        snprintf(buffer, size, "%lld GHz", (long long)(samplerate / 1000000000));
+    } else if (0 == samplerate % 1000000) {
+        snprintf(buffer, size, "%lld MHz", (long long)(samplerate / 1000000));
+    } else if (0 == samplerate % 1000) {
+        snprintf(buffer, size, "%lld kHz", (long long)(samplerate / 1000));
+    } else {
+        snprintf(buffer, size, "%lld Hz", (long long)samplerate);
+    }
+}
+
+static int sigrok_begin(void *context, const struct capture *capture, int64_t origin, int64_t trigger,
+                        const int8_t *values) {
+    struct sigrok_writer *writer = (struct sigrok_writer*)context;
+    char samplerate[32];
+    size_t length;
+
+    writer->origin      = origin;
+    writer->next_sample = 0;
+    writer->unitsize    = (capture->line_count + 7) / 8;
+    memset(writer->state, 0, sizeof(writer->state));
+    for (int i=0; i<capture->line_count; i++) {
+        if (1 == values[i]) {
+            writer->state[i / 8] |= (uint8_t)(1 << (i % 8));
+        }
+    }
+
+    format_samplerate(samplerate, sizeof(samplerate), writer->samplerate);
+    length = (size_t)snprintf(writer->metadata, SIGROK_METADATA_SIZE, "[global]\nsigrok version=0.5.2\n\n");
+    if (0 != trigger) {
+        // The format has no trigger key: a comment (ignored by the readers), as in the VCD output.
+        length += (size_t)snprintf(writer->metadata + length, SIGROK_METADATA_SIZE - length,
+                                   "# trigger at %lld ns (sample %lld)\n", (long long)(trigger - origin),
+                                   (long long)sigrok_sample_of(writer, trigger));
+    }
+    length += (size_t)snprintf(writer->metadata + length, SIGROK_METADATA_SIZE - length,
+                               "[device 1]\ncapturefile=logic-1\ntotal probes=%d\nsamplerate=%s\ntotal analog=0\n",
+                               capture->line_count, samplerate);
+    for (int i=0; i<capture->line_count; i++) {
+        length += (size_t)snprintf(writer->metadata + length, SIGROK_METADATA_SIZE - length, "probe%d=gpio%u\n",
+                                   i + 1, capture->offsets[i]);
+    }
+    snprintf(writer->metadata + length, SIGROK_METADATA_SIZE - length, "unitsize=%d\n", writer->unitsize);
+
+    if (-1 == zip_add_file(writer, "version", "2")) {
+        return -1;
+    }
+    return zip_begin_entry(writer, "logic-1-1", 0, 0, 0x0008);
+}
+
+static int sigrok_change(void *context, int64_t time, int index, int value) {
+    struct sigrok_writer *writer = (struct sigrok_writer*)context;
+
+    // Several changes within the same sample: the last one wins.
+    if (-1 == sigrok_fill(writer, sigrok_sample_of(writer, time))) {
+        return -1;
+    }
+    if (value) {
+        writer->state[index / 8] |= (uint8_t)(1 << (index % 8));
+    } else {
+        writer->state[index / 8] &= (uint8_t)~(1 << (index % 8));
+    }
+    return 0;
+}
+
+static int sigrok_end(void *context, int64_t time) {
+    struct sigrok_writer *writer = (struct sigrok_writer*)context;
+    int status = 0;
+
+    if (-1 == sigrok_fill(writer, sigrok_sample_of(writer, time) + 1) || -1 == sigrok_flush(writer)
+        || -1 == zip_end_entry(writer, writer->crc, (uint32_t)writer->size)
+        || -1 == zip_add_file(writer, "metadata", writer->metadata) || -1 == zip_close(writer)) {
+        status = -1;
+    }
+    if (0 != fclose(writer->file)) {
+        status = -1;
+    }
+    free(writer);
+    return status;
+}
+
+/**
+ * Create a writer that stores a capture in a sigrok session file.
+ * @param writer The writer to initialise.
+ * @param path The path of the file (usually `*.sr`).
+ * @param samplerate The sample rate, in Hz. The changes closer than a sample period are merged.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int capture_sigrok_open(struct capture_writer *writer, const char *path, int64_t samplerate) {
+    struct sigrok_writer *sigrok;
+
+    if (samplerate < 1 || samplerate > NSEC_PER_SEC) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (NULL == (sigrok = malloc(sizeof(struct sigrok_writer)))) {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (NULL == (sigrok->file = fopen(path, "wb"))) {
+        free(sigrok);
+        return -1;
+    }
+    sigrok->samplerate  = samplerate;
+    sigrok->entry_count = 0;
+    sigrok->offset      = 0;
+    sigrok->used        = 0;
+    sigrok->crc         = 0;
+    sigrok->size        = 0;
+    writer->context = sigrok;
+    writer->begin   = &sigrok_begin;
+    writer->change  = &sigrok_change;
+    writer->end     = &sigrok_end;
+    return 0;
+}
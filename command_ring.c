@@ -0,0 +1,607 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include "timing.h"
+#include "command_ring.h"
+
+#define DEPTH_MASK (COMMAND_RING_DEPTH - 1)
+
+_Static_assert(0 == (COMMAND_RING_DEPTH & DEPTH_MASK), "the depth of the queues must be a power of two");
+
+// The futexes are shared between processes: the private variants (FUTEX_*_PRIVATE) cannot be used.
+
+static int futex_wait(uint32_t *address, uint32_t value, const struct timespec *timeout) {
+    return (int)syscall(SYS_futex, address, FUTEX_WAIT, value, timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t *address) {
+    syscall(SYS_futex, address, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+static size_t shared_size(int channel_count) {
+    return sizeof(struct command_ring_shared) + (size_t)channel_count * sizeof(struct command_channel);
+}
+
+// ---------------------------------------------------------------------------------
+// SHARED MEMORY
+// ---------------------------------------------------------------------------------
+
+/**
+ * Create the shared memory of a ring.
+ * @param ring The ring to initialise.
+ * @param name The name of the POSIX shared memory object (ex: "/gpio_commands"), or NULL for an anonymous mapping,
+ *        shared with the processes created by `fork()`.
+ * @param channel_count The maximum number of clients.
+ * @param line_count The number of lines of the engine.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int command_ring_create(struct command_ring *ring, const char *name, int channel_count, int line_count) {
+    size_t size = shared_size(channel_count);
+    void *memory;
+
+    if (channel_count < 1 || line_count < 1 || line_count > COMMAND_RING_MAX_LINES) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (NULL == name) {
+        memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    } else {
+        int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR | O_CLOEXEC, 0600);
+
+        if (-1 == fd) {
+            return -1;
+        }
+        memory = MAP_FAILED;
+        if (0 == ftruncate(fd, (off_t)size)) {
+            memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (MAP_FAILED == memory) {
+            int saved = errno;
+            shm_unlink(name);
+            errno = saved;
+        }
+    }
+    if (MAP_FAILED == memory) {
+        return -1;
+    }
+    // The new pages are zeroed: all the indices are 0 and all the channels are free.
+    ring->shared = (struct command_ring_shared*)memory;
+    ring->size   = size;
+    ring->name   = name;
+    ring->shared->channel_count = (uint32_t)channel_count;
+    ring->shared->line_count    = (uint32_t)line_count;
+    __atomic_store_n(&ring->shared->magic, COMMAND_RING_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Map the shared memory of a ring created by another process.
+ * @param ring The ring to initialise.
+ * @param name The name of the POSIX shared memory object.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int command_ring_open(struct command_ring *ring, const char *name) {
+    struct command_ring_shared *shared;
+    struct stat status;
+    int fd = shm_open(name, O_RDWR | O_CLOEXEC, 0);
+
+    if (-1 == fd) {
+        return -1;
+    }
+    if (-1 == fstat(fd, &status)) {
+        close(fd);
+        return -1;
+    }
+    shared = (struct command_ring_shared*)mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (MAP_FAILED == (void*)shared) {
+        return -1;
+    }
+    if ((size_t)status.st_size < sizeof(*shared)
+        || COMMAND_RING_MAGIC != __atomic_load_n(&shared->magic, __ATOMIC_ACQUIRE)
+        || (size_t)status.st_size != shared_size((int)shared->channel_count)) {
+        munmap(shared, (size_t)status.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+    ring->shared = shared;
+    ring->size   = (size_t)status.st_size;
+    ring->name   = NULL;
+    return 0;
+}
+
+/**
+ * Unmap the shared memory of a ring (and remove the shared memory object, in the process that created it).
+ * @param ring The ring.
+ */
+
+void command_ring_close(struct command_ring *ring) {
+    munmap(ring->shared, ring->size);
+    if (NULL != ring->name) {
+        shm_unlink(ring->name);
+    }
+    ring->shared = NULL;
+}
+
+// ---------------------------------------------------------------------------------
+// COMMANDS
+// ---------------------------------------------------------------------------------
+
+/**
+ * Build a command that sets a single line.
+ * @param command The command.
+ * @param user_data The data returned in the completion.
+ * @param line The index of the line in the engine.
+ * @param value The value.
+ */
+
+void command_set(struct command *command, uint64_t user_data, int line, int value) {
+    command_pattern(command, user_data, UINT64_C(1) << line, (uint64_t)(0 != value) << line);
+}
+
+/**
+ * Build a command that sets several lines at once.
+ * @param command The command.
+ * @param user_data The data returned in the completion.
+ * @param mask The lines to set (bit N is the line of index N).
+ * @param values The values of the lines.
+ */
+
+void command_pattern(struct command *command, uint64_t user_data, uint64_t mask, uint64_t values) {
+    command->user_data = user_data;
+    command->opcode    = COMMAND_PATTERN;
+    command->reserved  = 0;
+    command->mask      = mask;
+    command->values    = values & mask;
+    command->duration  = 0;
+}
+
+/**
+ * Build a command that sets a line for a given duration, then sets the opposite value (retriggerable).
+ * @param command The command.
+ * @param user_data The data returned in the completion.
+ * @param line The index of the line in the engine.
+ * @param value The value of the pulse.
+ * @param duration The duration of the pulse, in nano seconds.
+ */
+
+void command_pulse(struct command *command, uint64_t user_data, int line, int value, int64_t duration) {
+    command_set(command, user_data, line, value);
+    command->opcode   = COMMAND_PULSE;
+    command->duration = duration;
+}
+
+// ---------------------------------------------------------------------------------
+// CLIENT
+// ---------------------------------------------------------------------------------
+
+/**
+ * Attach a client to a free channel of a ring.
+ * @param client The client to initialise.
+ * @param ring The ring.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set (EBUSY:
+ *         all the channels are used).
+ */
+
+int command_client_attach(struct command_client *client, struct command_ring *ring) {
+    struct command_ring_shared *shared = ring->shared;
+
+    for (uint32_t i=0; i<shared->channel_count; i++) {
+        struct command_channel *channel = &shared->channels[i];
+        uint32_t expected = 0;
+
+        if (__atomic_compare_exchange_n(&channel->state, &expected, 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+            client->channel         = channel;
+            client->index           = (int)i;
+            client->cached_sq_head  = __atomic_load_n(&channel->sq_head, __ATOMIC_ACQUIRE);
+            client->cached_cq_tail  = __atomic_load_n(&channel->cq_tail, __ATOMIC_ACQUIRE);
+            client->engine_sequence = &shared->engine_sequence;
+            client->engine_sleeping = &shared->engine_sleeping;
+            return 0;
+        }
+    }
+    errno = EBUSY;
+    return -1;
+}
+
+/**
+ * Wake up the engine, if it is sleeping: this is the only system call of the submission path.
+ * @param client The client.
+ */
+
+static void client_doorbell(struct command_client *client) {
+    // Orders the publication of the indices before the read of `engine_sleeping`. The engine does the opposite
+    // (see `command_engine_run()`), so at least one of the two sides sees the other one's write.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(client->engine_sleeping, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(client->engine_sequence, 1, __ATOMIC_RELEASE);
+        futex_wake(client->engine_sequence);
+        client->channel->doorbells++;
+    }
+}
+
+/**
+ * Submit commands. This function never blocks.
+ * @param client The client.
+ * @param commands The commands.
+ * @param count The number of commands.
+ * @return The number of commands submitted (fewer than `count` when the submission queue is full).
+ */
+
+int command_client_submit(struct command_client *client, const struct command *commands, int count) {
+    struct command_channel *channel = client->channel;
+    uint32_t tail = channel->sq_tail;
+    int pushed;
+
+    if (tail + (uint32_t)count - client->cached_sq_head > COMMAND_RING_DEPTH) {
+        client->cached_sq_head = __atomic_load_n(&channel->sq_head, __ATOMIC_ACQUIRE);
+    }
+    pushed = (int)(COMMAND_RING_DEPTH - (tail - client->cached_sq_head));
+    if (pushed > count) {
+        pushed = count;
+    }
+    for (int i=0; i<pushed; i++) {
+        channel->sq[(tail + (uint32_t)i) & DEPTH_MASK] = commands[i];
+    }
+    if (pushed > 0) {
+        __atomic_store_n(&channel->sq_tail, tail + (uint32_t)pushed, __ATOMIC_RELEASE);
+        client_doorbell(client);
+    }
+    return pushed;
+}
+
+/**
+ * Reap completions. This function never blocks.
+ * @param client The client.
+ * @param completions The array that receives the completions.
+ * @param max The maximum number of completions.
+ * @return The number of completions.
+ */
+
+int command_client_reap(struct command_client *client, struct command_completion *completions, int max) {
+    struct command_channel *channel = client->channel;
+    uint32_t head = channel->cq_head;
+    int reaped;
+
+    if (client->cached_cq_tail == head) {
+        client->cached_cq_tail = __atomic_load_n(&channel->cq_tail, __ATOMIC_ACQUIRE);
+    }
+    reaped = (int)(client->cached_cq_tail - head);
+    if (reaped > max) {
+        reaped = max;
+    }
+    for (int i=0; i<reaped; i++) {
+        completions[i] = channel->cq[(head + (uint32_t)i) & DEPTH_MASK];
+    }
+    if (reaped > 0) {
+        __atomic_store_n(&channel->cq_head, head + (uint32_t)reaped, __ATOMIC_RELEASE);
+        // The engine stops consuming the submissions of a full completion queue: it may be sleeping on it.
+        client_doorbell(client);
+    }
+    return reaped;
+}
+
+/**
+ * Wait until completions are available.
+ * @param client The client.
+ * @return 1 if completions are available, -1 on error.
+ */
+
+int command_client_wait(struct command_client *client) {
+    struct command_channel *channel = client->channel;
+    uint32_t head = channel->cq_head;
+
+    for (;;) {
+        client->cached_cq_tail = __atomic_load_n(&channel->cq_tail, __ATOMIC_ACQUIRE);
+        if (client->cached_cq_tail != head) {
+            return 1;
+        }
+        // Announce the wait, then check again: the engine may have posted before it could see the announcement.
+        __atomic_store_n(&channel->cq_waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (-1 == futex_wait(&channel->cq_tail, head, NULL) && EAGAIN != errno && EINTR != errno) {
+            __atomic_store_n(&channel->cq_waiting, 0, __ATOMIC_RELAXED);
+            return -1;
+        }
+        __atomic_store_n(&channel->cq_waiting, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Release the channel of a client. All the completions of the client must have been reaped.
+ * @param client The client.
+ */
+
+void command_client_detach(struct command_client *client) {
+    __atomic_store_n(&client->channel->state, 0, __ATOMIC_RELEASE);
+    client->channel = NULL;
+}
+
+// ---------------------------------------------------------------------------------
+// ENGINE
+// ---------------------------------------------------------------------------------
+
+/**
+ * Initialise an engine.
+ * @param engine The engine to initialise.
+ * @param ring The ring (created with `command_ring_create()`).
+ * @param backend The backend that writes the lines.
+ * @param line_ids The (GPIO) line IDs, by index. All the lines start low.
+ * @param line_count The number of lines: the one given to `command_ring_create()`.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int command_engine_init(struct command_engine *engine, struct command_ring *ring, const struct output_backend *backend,
+                        const int *line_ids, int line_count) {
+    uint32_t channel_count = __atomic_load_n(&ring->shared->channel_count, __ATOMIC_RELAXED);
+    size_t capacity = (size_t)channel_count * COMMAND_RING_DEPTH;
+
+    if ((uint32_t)line_count != ring->shared->line_count || shared_size((int)channel_count) > ring->size) {
+        errno = EINVAL;
+        return -1;
+    }
+    memset(engine, 0, sizeof(*engine));
+    engine->ring          = ring;
+    engine->channel_count = channel_count;
+    engine->backend       = *backend;
+    engine->line_count    = line_count;
+    memcpy(engine->line_ids, line_ids, (size_t)line_count * sizeof(int));
+    engine->pending_channels = malloc(capacity * sizeof(int));
+    engine->pending_data     = malloc(capacity * sizeof(uint64_t));
+    engine->pending_status   = malloc(capacity * sizeof(int32_t));
+    if (NULL == engine->pending_channels || NULL == engine->pending_data || NULL == engine->pending_status) {
+        command_engine_terminate(engine);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+static int32_t apply(struct command_engine *engine, const struct command *command, int64_t now) {
+    uint64_t lines = COMMAND_RING_MAX_LINES == engine->line_count ? ~UINT64_C(0)
+                                                                  : (UINT64_C(1) << engine->line_count) - 1;
+    uint64_t mask = command->mask;
+
+    if (0 == mask || 0 != (mask & ~lines)) {
+        return -EINVAL;
+    }
+    if (COMMAND_PULSE == command->opcode ? command->duration <= 0 : COMMAND_PATTERN != command->opcode) {
+        return -EINVAL;
+    }
+    engine->values  = (engine->values & ~mask) | (command->values & mask);
+    engine->dirty  |= mask;
+    engine->pulses &= ~mask; // A new value cancels the pulse in progress.
+    if (COMMAND_PULSE == command->opcode) {
+        for (int i=0; i<engine->line_count; i++) {
+            if (mask & (UINT64_C(1) << i)) {
+                engine->pulse_ends[i] = now + command->duration;
+            }
+        }
+        engine->pulses |= mask;
+    }
+    return 0;
+}
+
+/**
+ * End the pulses that are due: the lines take the opposite of their value.
+ * @return The end of the next pulse, or 0 if no pulse is in progress.
+ */
+
+static int64_t expire(struct command_engine *engine, int64_t now) {
+    int64_t next = 0;
+
+    for (int i=0; i<engine->line_count && 0 != engine->pulses >> i; i++) {
+        uint64_t bit = UINT64_C(1) << i;
+
+        if (0 == (engine->pulses & bit)) {
+            continue;
+        }
+        if (engine->pulse_ends[i] <= now) {
+            engine->values ^= bit;
+            engine->dirty  |= bit;
+            engine->pulses &= ~bit;
+        } else if (0 == next || engine->pulse_ends[i] < next) {
+            next = engine->pulse_ends[i];
+        }
+    }
+    return next;
+}
+
+/**
+ * Write the lines changed by the batch, with a single call to the backend if it supports bulk writes.
+ * @return 0, or the opposite of an `errno` value.
+ */
+
+static int32_t commit(struct command_engine *engine) {
+    struct output_backend *backend = &engine->backend;
+    int count = 0;
+
+    for (int i=0; i<engine->line_count && 0 != engine->dirty >> i; i++) {
+        if (engine->dirty & (UINT64_C(1) << i)) {
+            engine->write_lines[count]  = engine->line_ids[i];
+            engine->write_values[count] = (int)(engine->values >> i & 1);
+            count++;
+        }
+    }
+    engine->dirty = 0;
+    if (0 == count) {
+        return 0;
+    }
+    if (NULL != backend->set_values) {
+        engine->commits++;
+        return -1 == backend->set_values(backend->context, count, engine->write_lines, engine->write_values)
+               ? -errno : 0;
+    }
+    for (int i=0; i<count; i++) {
+        engine->commits++;
+        if (-1 == backend->set_value(backend->context, engine->write_lines[i], engine->write_values[i])) {
+            return -errno;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Run one batch: consume the submissions of all the clients (as long as their completion queues have room), apply
+ * them to the lines with a single bulk write (with the ends of the pulses that are due), then post the completions.
+ * This function never blocks.
+ * @param engine The engine.
+ * @return The number of commands of the batch.
+ */
+
+int command_engine_poll(struct command_engine *engine) {
+    struct command_ring_shared *shared = engine->ring->shared;
+    int64_t now = timing_now();
+    int count = 0;
+    int32_t status;
+
+    expire(engine, now);
+    for (uint32_t c=0; c<engine->channel_count; c++) {
+        struct command_channel *channel = &shared->channels[c];
+        uint32_t head = channel->sq_head;
+        uint32_t available = __atomic_load_n(&channel->sq_tail, __ATOMIC_ACQUIRE) - head;
+        uint32_t room = COMMAND_RING_DEPTH - (channel->cq_tail - __atomic_load_n(&channel->cq_head, __ATOMIC_ACQUIRE));
+
+        // A client cannot make the engine take more than a queue of commands (the size of the batch arrays).
+        if (room > COMMAND_RING_DEPTH) {
+            room = 0;
+        }
+        if (available > room) {
+            available = room;
+        }
+        for (uint32_t i=0; i<available; i++) {
+            const struct command *command = &channel->sq[(head + i) & DEPTH_MASK];
+
+            engine->pending_channels[count] = (int)c;
+            engine->pending_data[count]     = command->user_data;
+            engine->pending_status[count]   = apply(engine, command, now);
+            count++;
+        }
+        if (available > 0) {
+            __atomic_store_n(&channel->sq_head, head + available, __ATOMIC_RELEASE);
+        }
+    }
+    status = commit(engine);
+    now    = timing_now();
+
+    for (int i=0; i<count; ) {
+        struct command_channel *channel = &shared->channels[engine->pending_channels[i]];
+        uint32_t tail = channel->cq_tail;
+
+        // The commands of a channel are contiguous in the batch: their completions are published at once.
+        for (int c=engine->pending_channels[i]; i<count && c == engine->pending_channels[i]; i++, tail++) {
+            struct command_completion *completion = &channel->cq[tail & DEPTH_MASK];
+
+            completion->user_data = engine->pending_data[i];
+            completion->status    = 0 != engine->pending_status[i] ? engine->pending_status[i] : status;
+            completion->reserved  = 0;
+            completion->timestamp = now;
+        }
+        __atomic_store_n(&channel->cq_tail, tail, __ATOMIC_RELEASE);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&channel->cq_waiting, __ATOMIC_RELAXED)) {
+            futex_wake(&channel->cq_tail);
+        }
+    }
+    engine->commands += count;
+    return count;
+}
+
+/**
+ * Tell whether the engine has work to do: a submission with room for its completion.
+ */
+
+static int has_submissions(struct command_engine *engine) {
+    struct command_ring_shared *shared = engine->ring->shared;
+
+    for (uint32_t c=0; c<engine->channel_count; c++) {
+        struct command_channel *channel = &shared->channels[c];
+
+        if (__atomic_load_n(&channel->sq_tail, __ATOMIC_ACQUIRE) != channel->sq_head
+            && __atomic_load_n(&channel->cq_head, __ATOMIC_ACQUIRE) + COMMAND_RING_DEPTH != channel->cq_tail) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Run an engine until `command_engine_stop()` is called.
+ *
+ * The engine polls the submission queues. Once it has been idle for `spin` nano seconds, it sleeps (on a futex)
+ * until a client rings the doorbell or a pulse ends: while the commands keep coming, no system call is made but the
+ * bulk writes.
+ * @param engine The engine.
+ * @param spin The time spent polling before sleeping, in nano seconds.
+ * @return 0.
+ */
+
+int command_engine_run(struct command_engine *engine, int64_t spin) {
+    struct command_ring_shared *shared = engine->ring->shared;
+    int64_t idle_since = timing_now();
+
+    while (!__atomic_load_n(&engine->stop, __ATOMIC_ACQUIRE)) {
+        uint32_t sequence;
+        int64_t now, next;
+
+        if (command_engine_poll(engine) > 0) {
+            idle_since = timing_now();
+            continue;
+        }
+        now = timing_now();
+        if (now - idle_since < spin) {
+            continue;
+        }
+
+        sequence = __atomic_load_n(&shared->engine_sequence, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&shared->engine_sleeping, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        next = expire(engine, now);
+        if (0 == engine->dirty && !has_submissions(engine) && !__atomic_load_n(&engine->stop, __ATOMIC_ACQUIRE)) {
+            struct timespec timeout;
+
+            if (0 != next) {
+                timing_from_ns(next - now, &timeout);
+            }
+            futex_wait(&shared->engine_sequence, sequence, 0 != next ? &timeout : NULL);
+            engine->sleeps++;
+        }
+        __atomic_store_n(&shared->engine_sleeping, 0, __ATOMIC_RELAXED);
+        idle_since = timing_now();
+    }
+    return 0;
+}
+
+/**
+ * Stop an engine (from another thread).
+ * @param engine The engine.
+ */
+
+void command_engine_stop(struct command_engine *engine) {
+    __atomic_store_n(&engine->stop, 1, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&engine->ring->shared->engine_sequence, 1, __ATOMIC_RELEASE);
+    futex_wake(&engine->ring->shared->engine_sequence);
+}
+
+/**
+ * Free the resources allocated by an engine.
+ * @param engine The engine.
+ */
+
+void command_engine_terminate(struct command_engine *engine) {
+    free(engine->pending_channels);
+    free(engine->pending_data);
+    free(engine->pending_status);
+    engine->pending_channels = NULL;
+    engine->pending_data     = NULL;
+    engine->pending_status   = NULL;
+}
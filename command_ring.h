@@ -0,0 +1,168 @@
+#ifndef COMMAND_RING_H
+#define COMMAND_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "scheduler.h"
+
+#define COMMAND_RING_CACHE_LINE_SIZE 64
+/** The number of entries of the submission and completion queues of a client. */
+#define COMMAND_RING_DEPTH           256
+/** The maximum number of lines of the engine (the size of the masks). */
+#define COMMAND_RING_MAX_LINES       64
+#define COMMAND_RING_MAGIC           0x67706f72
+
+/** Commands. The lines of `mask` take the values of `values` (bit N is the line of index N of the engine). */
+#define COMMAND_PATTERN 1
+/** Same as `COMMAND_PATTERN`, then after `duration` nano seconds, the lines take the opposite values. */
+#define COMMAND_PULSE   2
+
+/**
+ * A command, submitted by a client. A single line is set with a pattern of one bit (see `command_set()`).
+ */
+
+struct command {
+    /** Chosen by the client, and returned in the completion. */
+    uint64_t user_data;
+    uint32_t opcode;
+    uint32_t reserved;
+    uint64_t mask;
+    uint64_t values;
+    int64_t  duration;
+};
+
+/**
+ * The completion of a command: the command has been written to the lines (or rejected).
+ */
+
+struct command_completion {
+    uint64_t user_data;
+    /** 0, or the opposite of an `errno` value. */
+    int32_t  status;
+    uint32_t reserved;
+    /** The end of the bulk write that applied the command (CLOCK_MONOTONIC, in nano seconds). */
+    int64_t  timestamp;
+};
+
+/**
+ * The queues of a client, in the shared memory: a submission queue (client -> engine) and a completion queue
+ * (engine -> client), both single-producer/single-consumer. As in `struct event_ring`, the indices written by each
+ * side live in distinct cache lines. The indices are free-running (the slot is `index % COMMAND_RING_DEPTH`).
+ */
+
+struct command_channel {
+    // Written by the client.
+    uint32_t sq_tail __attribute__((aligned(COMMAND_RING_CACHE_LINE_SIZE)));
+    uint32_t cq_head;
+    /** 1 while the client waits for completions (see `command_client_wait()`). */
+    uint32_t cq_waiting;
+    /** 0: free, 1: attached to a client. */
+    uint32_t state;
+    /** The number of doorbells rung by the client (system calls). */
+    uint64_t doorbells;
+
+    // Written by the engine.
+    uint32_t sq_head __attribute__((aligned(COMMAND_RING_CACHE_LINE_SIZE)));
+    uint32_t cq_tail;
+
+    struct command            sq[COMMAND_RING_DEPTH] __attribute__((aligned(COMMAND_RING_CACHE_LINE_SIZE)));
+    struct command_completion cq[COMMAND_RING_DEPTH] __attribute__((aligned(COMMAND_RING_CACHE_LINE_SIZE)));
+};
+
+/**
+ * The shared memory: a header, then one channel per client.
+ */
+
+struct command_ring_shared {
+    uint32_t magic;
+    uint32_t channel_count;
+    /** The number of lines of the engine. */
+    uint32_t line_count;
+    /** Incremented to wake up the engine (a futex). */
+    uint32_t engine_sequence __attribute__((aligned(COMMAND_RING_CACHE_LINE_SIZE)));
+    /** 1 while the engine sleeps: the clients must ring the doorbell after a submission. */
+    uint32_t engine_sleeping;
+    struct command_channel channels[] __attribute__((aligned(COMMAND_RING_CACHE_LINE_SIZE)));
+};
+
+/**
+ * A mapping of the shared memory, in the engine or in a client process.
+ *
+ * The shared memory is either anonymous (inherited by the client processes created with `fork()`), or a POSIX shared
+ * memory object (see `shm_open()`) that other processes open by name.
+ */
+
+struct command_ring {
+    struct command_ring_shared *shared;
+    size_t     size;
+    /** The name of the shared memory object, to remove it (creator only), or NULL. */
+    const char *name;
+};
+
+/**
+ * A client: submits commands without system calls (the doorbell is only rung when the engine sleeps).
+ */
+
+struct command_client {
+    struct command_channel *channel;
+    int      index;
+    /** The client's copy of `sq_head`, and of `cq_tail`. */
+    uint32_t cached_sq_head;
+    uint32_t cached_cq_tail;
+    uint32_t *engine_sequence;
+    uint32_t *engine_sleeping;
+};
+
+/**
+ * The GPIO engine: consumes the commands of all the clients and applies each batch with a single bulk write.
+ */
+
+struct command_engine {
+    struct command_ring   *ring;
+    /** The number of channels, read once: the shared memory can be written by the clients. */
+    uint32_t              channel_count;
+    struct output_backend backend;
+    int      line_ids[COMMAND_RING_MAX_LINES];
+    int      line_count;
+    /** The values of the lines, by index, and the lines changed since the last commit. */
+    uint64_t values;
+    uint64_t dirty;
+    /** The end of the pulse of each line (0: none). */
+    int64_t  pulse_ends[COMMAND_RING_MAX_LINES];
+    uint64_t pulses;
+    /** The commands of the batch in progress: their channel and user data, and their status. */
+    int      *pending_channels;
+    uint64_t *pending_data;
+    int32_t  *pending_status;
+    int      write_lines[COMMAND_RING_MAX_LINES];
+    int      write_values[COMMAND_RING_MAX_LINES];
+    /** Set by `command_engine_stop()`. */
+    int      stop;
+    /** The number of commands, of calls to the backend and of sleeps. */
+    long     commands;
+    long     commits;
+    long     sleeps;
+};
+
+int command_ring_create(struct command_ring *ring, const char *name, int channel_count, int line_count);
+int command_ring_open(struct command_ring *ring, const char *name);
+void command_ring_close(struct command_ring *ring);
+
+void command_set(struct command *command, uint64_t user_data, int line, int value);
+void command_pattern(struct command *command, uint64_t user_data, uint64_t mask, uint64_t values);
+void command_pulse(struct command *command, uint64_t user_data, int line, int value, int64_t duration);
+
+int command_client_attach(struct command_client *client, struct command_ring *ring);
+int command_client_submit(struct command_client *client, const struct command *commands, int count);
+int command_client_reap(struct command_client *client, struct command_completion *completions, int max);
+int command_client_wait(struct command_client *client);
+void command_client_detach(struct command_client *client);
+
+int command_engine_init(struct command_engine *engine, struct command_ring *ring, const struct output_backend *backend,
+                        const int *line_ids, int line_count);
+int command_engine_poll(struct command_engine *engine);
+int command_engine_run(struct command_engine *engine, int64_t spin);
+void command_engine_stop(struct command_engine *engine);
+void command_engine_terminate(struct command_engine *engine);
+
+#endif // COMMAND_RING_H
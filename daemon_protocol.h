@@ -0,0 +1,63 @@
+#ifndef DAEMON_PROTOCOL_H
+#define DAEMON_PROTOCOL_H
+
+#include <stdint.h>
+
+// The binary protocol of gpio_daemon (see gpio_daemon.c), over a Unix domain stream socket.
+//
+// The client sends fixed-size requests and receives fixed-size messages, in the native byte order (the socket is
+// local). Requests may be pipelined: a client can send many requests before reading the replies. The replies are
+// sent in the order of the requests, with the ID of the request. The edges of the subscribed lines are interleaved
+// with the replies, as messages with ID 0.
+
+/** Set an output line to `value` (the line is requested as an output on first use). */
+#define DAEMON_SET         1
+/** Read the value of a line (an unused line is requested as an input). The reply holds the value. */
+#define DAEMON_GET         2
+/** Set an output line to `value` for `duration` micro seconds, then to the opposite value (retriggerable). */
+#define DAEMON_PULSE       3
+/** Receive the edges of an input line (an unused line is requested as an input). The reply holds the value. */
+#define DAEMON_SUBSCRIBE   4
+/** Stop receiving the edges of an input line. */
+#define DAEMON_UNSUBSCRIBE 5
+
+/** The maximum duration of a pulse, in micro seconds (1 hour). */
+#define DAEMON_MAX_DURATION (3600U * 1000U * 1000U)
+
+/**
+ * A request (16 bytes).
+ */
+
+struct daemon_request {
+    /** Chosen by the client, and returned in the reply (it should not be 0, the ID of the edge messages). */
+    uint32_t id;
+    uint8_t  opcode;
+    /** The value of `DAEMON_SET` and `DAEMON_PULSE` (0 or 1). */
+    uint8_t  value;
+    uint16_t reserved;
+    /** The offset of the line. */
+    uint32_t offset;
+    /** The duration of `DAEMON_PULSE`, in micro seconds. */
+    uint32_t duration;
+};
+
+/**
+ * A reply to a request, or an edge of a subscribed line (24 bytes).
+ */
+
+struct daemon_message {
+    /** The ID of the request, or 0 for an edge. */
+    uint32_t id;
+    /** 0, or the opposite of an `errno` value (ex: `-EBUSY` when the line is used in the other direction). */
+    int32_t  status;
+    uint32_t offset;
+    /** The value of the line (`DAEMON_GET`, `DAEMON_SUBSCRIBE`), or 1 for a rising edge and 0 for a falling edge. */
+    int32_t  value;
+    /** The timestamp of the edge (CLOCK_MONOTONIC, in nano seconds), or the instant of the reply. */
+    int64_t  timestamp;
+};
+
+_Static_assert(16 == sizeof(struct daemon_request), "unexpected size of the requests");
+_Static_assert(24 == sizeof(struct daemon_message), "unexpected size of the messages");
+
+#endif // DAEMON_PROTOCOL_H
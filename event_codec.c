@@ -0,0 +1,223 @@
+#include <errno.h>
+#include <string.h>
+#include "event_codec.h"
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 0x1);
+}
+
+static size_t put_varint(uint8_t *buffer, uint64_t value) {
+    size_t size = 0;
+
+    while (value >= 0x80) {
+        buffer[size++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    buffer[size++] = (uint8_t)value;
+    return size;
+}
+
+/**
+ * Read a varint.
+ * @return 0 on success, -1 if the varint is truncated or too long.
+ */
+
+static int get_varint(struct event_decoder *decoder, uint64_t *value) {
+    uint64_t result = 0;
+
+    for (int shift=0; shift<64; shift+=7) {
+        uint8_t byte;
+
+        if (decoder->position == decoder->size) {
+            return -1;
+        }
+        byte = decoder->buffer[decoder->position++];
+        result |= (uint64_t)(byte & 0x7f) << shift;
+        if (0 == (byte & 0x80)) {
+            *value = result;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/** The value expected for the next event of a line: the opposite of its last value (1 for the first event). */
+static int predicted_value(const struct event_codec_line *line) {
+    return -1 == line->last_value ? 1 : !line->last_value;
+}
+
+/**
+ * Initialise an encoder, and start a block.
+ * @param encoder The encoder to initialise.
+ * @param buffer The buffer that receives the block.
+ * @param capacity The size of the buffer, in bytes.
+ */
+
+void event_encoder_init(struct event_encoder *encoder, uint8_t *buffer, size_t capacity) {
+    encoder->line_count         = 0;
+    encoder->previous_line      = -1;
+    encoder->previous_timestamp = 0;
+    encoder->buffer             = buffer;
+    encoder->capacity           = capacity;
+    encoder->size               = 0;
+    encoder->events             = 0;
+}
+
+/**
+ * Append an event to the block.
+ * @param encoder The encoder.
+ * @param timestamp The timestamp of the event, in nano seconds (the events do not have to be sorted).
+ * @param line_id The (GPIO) line ID.
+ * @param value The value of the line after the event (edge type, or new value).
+ * @return The number of bytes written. If the block is full (ENOSPC) or the event cannot be encoded (EINVAL), the
+ *         function returns -1, `errno` is set, and the block is unchanged: start a new block with
+ *         `event_encoder_init()`.
+ */
+
+int event_encode(struct event_encoder *encoder, int64_t timestamp, uint32_t line_id, int value) {
+    uint8_t encoded[EVENT_CODEC_MAX_EVENT_SIZE];
+    struct event_codec_line new_line;
+    struct event_codec_line *line = NULL;
+    int index = encoder->previous_line;
+    size_t size = 0;
+    int64_t delta;
+    uint64_t dod;
+    int unexpected;
+
+    if (-1 == index || encoder->lines[index].line_id != line_id) {
+        for (index=0; index<encoder->line_count && encoder->lines[index].line_id != line_id; index++);
+    }
+    if (index < encoder->line_count) {
+        line = &encoder->lines[index];
+    } else {
+        if (EVENT_CODEC_MAX_LINES == encoder->line_count) {
+            errno = ENOSPC;
+            return -1;
+        }
+        new_line.line_id        = line_id;
+        new_line.last_timestamp = 0 == encoder->events ? timestamp : encoder->previous_timestamp;
+        new_line.last_delta     = 0;
+        new_line.last_value     = -1;
+        line = &new_line;
+    }
+
+    delta = timestamp - line->last_timestamp;
+    dod   = zigzag(delta - line->last_delta);
+    if (timestamp < 0 || 0 != (dod >> 61)) {
+        errno = EINVAL;
+        return -1;
+    }
+    unexpected = (value != 0) != predicted_value(line);
+
+    if (0 == encoder->events) {
+        size += put_varint(&encoded[size], (uint64_t)timestamp);
+    }
+    size += put_varint(&encoded[size], dod << 2 | (uint64_t)(index != encoder->previous_line) << 1
+                                       | (uint64_t)unexpected);
+    if (index != encoder->previous_line) {
+        size += put_varint(&encoded[size], (uint64_t)index);
+        if (line == &new_line) {
+            size += put_varint(&encoded[size], line_id);
+        }
+    }
+    if (encoder->size + size > encoder->capacity) {
+        errno = ENOSPC;
+        return -1;
+    }
+    memcpy(&encoder->buffer[encoder->size], encoded, size);
+    encoder->size += size;
+
+    if (line == &new_line) {
+        encoder->lines[encoder->line_count++] = new_line;
+        line = &encoder->lines[index];
+    }
+    line->last_timestamp = timestamp;
+    line->last_delta     = delta;
+    line->last_value     = value != 0;
+    encoder->previous_line      = index;
+    encoder->previous_timestamp = timestamp;
+    encoder->events++;
+    return (int)size;
+}
+
+/**
+ * Initialise a decoder.
+ * @param decoder The decoder to initialise.
+ * @param buffer The block.
+ * @param size The size of the block, in bytes.
+ */
+
+void event_decoder_init(struct event_decoder *decoder, const uint8_t *buffer, size_t size) {
+    decoder->line_count         = 0;
+    decoder->previous_line      = -1;
+    decoder->previous_timestamp = 0;
+    decoder->buffer             = buffer;
+    decoder->size               = size;
+    decoder->position           = 0;
+    decoder->events             = 0;
+}
+
+/**
+ * Decode the next event of a block.
+ * @param decoder The decoder.
+ * @param timestamp Receives the timestamp of the event.
+ * @param line_id Receives the (GPIO) line ID.
+ * @param value Receives the value of the line after the event.
+ * @return 1 if an event has been decoded, 0 at the end of the block, or -1 if the block is corrupted (`errno` is set
+ *         to EINVAL).
+ */
+
+int event_decode(struct event_decoder *decoder, int64_t *timestamp, uint32_t *line_id, int *value) {
+    struct event_codec_line *line;
+    uint64_t token, index = (uint64_t)decoder->previous_line;
+    int64_t delta;
+
+    if (decoder->position == decoder->size) {
+        return 0;
+    }
+    if (0 == decoder->events) {
+        uint64_t first;
+
+        if (-1 == get_varint(decoder, &first)) {
+            errno = EINVAL;
+            return -1;
+        }
+        decoder->previous_timestamp = (int64_t)first;
+    }
+    if (-1 == get_varint(decoder, &token) || ((token & 0x2) && -1 == get_varint(decoder, &index))
+        || index > (uint64_t)decoder->line_count || EVENT_CODEC_MAX_LINES == index) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (index == (uint64_t)decoder->line_count) {
+        uint64_t id;
+
+        if (-1 == get_varint(decoder, &id)) {
+            errno = EINVAL;
+            return -1;
+        }
+        line = &decoder->lines[decoder->line_count++];
+        line->line_id        = (uint32_t)id;
+        line->last_timestamp = decoder->previous_timestamp;
+        line->last_delta     = 0;
+        line->last_value     = -1;
+    }
+    line = &decoder->lines[index];
+
+    delta = line->last_delta + unzigzag(token >> 2);
+    line->last_timestamp += delta;
+    line->last_delta      = delta;
+    line->last_value      = (token & 0x1) ? !predicted_value(line) : predicted_value(line);
+
+    *timestamp = line->last_timestamp;
+    *line_id   = line->line_id;
+    *value     = line->last_value;
+    decoder->previous_line      = (int)index;
+    decoder->previous_timestamp = line->last_timestamp;
+    decoder->events++;
+    return 1;
+}
@@ -0,0 +1,71 @@
+#ifndef EVENT_CODEC_H
+#define EVENT_CODEC_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** The maximum number of distinct lines in a block. */
+#define EVENT_CODEC_MAX_LINES 64
+/** The maximum size of an encoded event, in bytes (including the header of the block). */
+#define EVENT_CODEC_MAX_EVENT_SIZE 26
+
+/**
+ * The state of a line in a block: the timestamp of its last event, the last delta between its events and its last
+ * value.
+ */
+
+struct event_codec_line {
+    uint32_t line_id;
+    int64_t  last_timestamp;
+    int64_t  last_delta;
+    int      last_value;
+};
+
+/**
+ * Compressed encoding of a stream of events (timestamp, line, value), for long captures of periodic signals.
+ *
+ * The events are encoded in independent blocks. A block starts with the timestamp of its first event (varint).
+ * Then every event is a single varint token, optionally followed by the index of its line:
+ *
+ *     token = zigzag(delta-of-delta) << 2 | other_line << 1 | unexpected_value
+ *
+ *   - delta-of-delta: the time since the previous event of the same line, minus the time between the two previous
+ *     events of the line. For a periodic signal, it is the jitter: a few bytes, whatever the period.
+ *   - other_line: 0 if the line is the line of the previous event. Otherwise, the index of the line in the block
+ *     follows (varint); a new line is given as its index (the number of lines so far) followed by its ID.
+ *   - unexpected_value: 0 if the value is the opposite of the last value of the line (edges alternate), 1 if not
+ *     (a lost edge, or a transition without change). The first event of a line is expected to be 1.
+ *
+ * The first event of a line is encoded relatively to the previous event of the block.
+ */
+
+struct event_encoder {
+    struct event_codec_line lines[EVENT_CODEC_MAX_LINES];
+    int      line_count;
+    /** The index of the line of the previous event (-1: none). */
+    int      previous_line;
+    int64_t  previous_timestamp;
+    uint8_t  *buffer;
+    size_t   capacity;
+    size_t   size;
+    long     events;
+};
+
+struct event_decoder {
+    struct event_codec_line lines[EVENT_CODEC_MAX_LINES];
+    int      line_count;
+    int      previous_line;
+    int64_t  previous_timestamp;
+    const uint8_t *buffer;
+    size_t   size;
+    size_t   position;
+    long     events;
+};
+
+void event_encoder_init(struct event_encoder *encoder, uint8_t *buffer, size_t capacity);
+int event_encode(struct event_encoder *encoder, int64_t timestamp, uint32_t line_id, int value);
+
+void event_decoder_init(struct event_decoder *decoder, const uint8_t *buffer, size_t size);
+int event_decode(struct event_decoder *decoder, int64_t *timestamp, uint32_t *line_id, int *value);
+
+#endif // EVENT_CODEC_H
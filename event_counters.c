@@ -0,0 +1,163 @@
+#include <string.h>
+#include "timing.h"
+#include "event_counters.h"
+
+/** A silence after a full read is suspect if it is longer than this number of spacings of the edges of the read. */
+#define SUSPECTED_GAP_FACTOR 8
+
+/**
+ * Initialise counters.
+ * @param counters The counters to initialise.
+ * @param buffer_size The maximum number of events returned by a read. See `gpio_input_batch_size()`.
+ */
+
+void event_counters_init(struct event_counters *counters, int buffer_size) {
+    counters->events          = 0;
+    counters->reads           = 0;
+    counters->saturated_reads = 0;
+    counters->dropped         = 0;
+    counters->lost            = 0;
+    counters->sequenced       = 0;
+    counters->suspected_gaps  = 0;
+    counters->peak_depth      = 0;
+    counters->first_timestamp = 0;
+    counters->last_timestamp  = 0;
+    memset(counters->line_lost, 0, sizeof(counters->line_lost));
+    event_counters_restart(counters, buffer_size);
+}
+
+/**
+ * Restart the tracking of the sequences after the lines have been requested again (the kernel numbers the events of
+ * a new request from 1). The counts are kept.
+ * @param counters The counters.
+ * @param buffer_size The maximum number of events returned by a read from the new request.
+ */
+
+void event_counters_restart(struct event_counters *counters, int buffer_size) {
+    counters->buffer_size       = buffer_size;
+    counters->saturated_spacing = 0;
+    counters->last_global_seqno = 0;
+    memset(counters->last_rising, -1, sizeof(counters->last_rising));
+    memset(counters->last_line_seqno, 0, sizeof(counters->last_line_seqno));
+}
+
+/**
+ * Account for a batch of events.
+ * @param counters The counters.
+ * @param events The events.
+ * @param count The number of events.
+ */
+
+void event_counters_update(struct event_counters *counters, const struct gpio_event *events, int count) {
+    long lost = 0;
+    long depth;
+
+    if (count <= 0) {
+        return;
+    }
+    if (0 == counters->events) {
+        counters->first_timestamp = events[0].timestamp;
+    } else if (0 != counters->saturated_spacing
+               && events[0].timestamp - counters->last_timestamp
+                  > SUSPECTED_GAP_FACTOR * counters->saturated_spacing) {
+        counters->suspected_gaps++;
+    }
+    counters->last_timestamp = events[count - 1].timestamp;
+    counters->events += count;
+    counters->reads++;
+
+    for (int i=0; i<count; i++) {
+        const struct gpio_event *event = &events[i];
+
+        if (0 != event->global_seqno) {
+            if (0 != counters->last_global_seqno && event->global_seqno - counters->last_global_seqno > 1) {
+                lost += event->global_seqno - counters->last_global_seqno - 1;
+            }
+            counters->last_global_seqno = event->global_seqno;
+            counters->sequenced++;
+        }
+        if (event->offset < EVENT_COUNTERS_MAX_OFFSET) {
+            int8_t *last = &counters->last_rising[event->offset];
+            uint32_t *last_seqno = &counters->last_line_seqno[event->offset];
+
+            if (*last == event->rising) {
+                counters->dropped++;
+            }
+            *last = (int8_t)event->rising;
+            if (0 != event->line_seqno) {
+                if (0 != *last_seqno && event->line_seqno - *last_seqno > 1) {
+                    counters->line_lost[event->offset] += event->line_seqno - *last_seqno - 1;
+                }
+                *last_seqno = event->line_seqno;
+            }
+        }
+    }
+    counters->lost += lost;
+
+    // The depth of the queue: what has been read and lost or, for a full read, the rate of the burst multiplied by
+    // the age of its oldest event (the queue may have held more events than the buffer could return).
+    depth = count + lost;
+    counters->saturated_spacing = 0;
+    if (count >= counters->buffer_size) {
+        counters->saturated_reads++;
+        if (count > 1 && counters->last_timestamp > events[0].timestamp) {
+            int64_t age = timing_now() - events[0].timestamp;
+
+            counters->saturated_spacing = (counters->last_timestamp - events[0].timestamp) / (count - 1);
+            // A burst faster than the resolution of the timestamps has no spacing (0): only the read is counted.
+            if (counters->saturated_spacing > 0 && age > 0 && age < NSEC_PER_SEC
+                && age / counters->saturated_spacing + 1 > depth) {
+                depth = (long)(age / counters->saturated_spacing) + 1;
+            }
+        }
+    }
+    if (depth > counters->peak_depth) {
+        counters->peak_depth = depth;
+    }
+}
+
+/**
+ * Return the size of buffer suited to the bursts observed so far: twice the peak depth of the queue, rounded up to
+ * a power of two. The size never decreases.
+ * @param counters The counters.
+ * @param max_size The greatest size (ex: the greatest kernel buffer).
+ * @return The recommended size, or the current size if it is enough (or already at the maximum).
+ */
+
+int event_counters_recommended_size(const struct event_counters *counters, int max_size) {
+    int size = counters->buffer_size > 0 ? counters->buffer_size : 1;
+
+    while (size < 2 * counters->peak_depth && 2 * size <= max_size) {
+        size *= 2;
+    }
+    return size;
+}
+
+/**
+ * Print counters.
+ * @param stream The stream to print to.
+ * @param name The name of the input.
+ * @param counters The counters.
+ */
+
+void event_counters_print(FILE *stream, const char *name, const struct event_counters *counters) {
+    int64_t span = counters->last_timestamp - counters->first_timestamp;
+
+    fprintf(stream, "%s: %ld events, %.0f events/s, %ld reads, %.2f events per read, "
+                    "%ld saturated reads (%d events), peak queue depth %ld, ",
+            name, counters->events,
+            span > 0 ? (double)(counters->events - 1) * NSEC_PER_SEC / (double)span : 0.0,
+            counters->reads, counters->reads > 0 ? (double)counters->events / (double)counters->reads : 0.0,
+            counters->saturated_reads, counters->buffer_size, counters->peak_depth);
+    if (counters->sequenced > 0) {
+        fprintf(stream, "%ld events lost (sequence numbers)\n", counters->lost);
+    } else {
+        fprintf(stream, "at least %ld events lost, %ld suspected gaps\n", counters->dropped,
+                counters->suspected_gaps);
+    }
+    for (int offset=0; offset<EVENT_COUNTERS_MAX_OFFSET; offset++) {
+        if (0 != counters->line_lost[offset]) {
+            fprintf(stream, "%s: line %d lost %u edges\n", name, offset, counters->line_lost[offset]);
+        }
+    }
+}
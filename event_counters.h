@@ -0,0 +1,66 @@
+#ifndef EVENT_COUNTERS_H
+#define EVENT_COUNTERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "gpio.h"
+
+/** Lines with a greater offset are not checked for lost edges. */
+#define EVENT_COUNTERS_MAX_OFFSET 256
+
+/**
+ * Counters of the edge events read in batches from an input request.
+ *
+ * When the kernel gives sequence numbers (libgpiod v2), the lost events are counted exactly: a gap in the sequence
+ * numbers of the request is a number of events dropped by the kernel queue, and a gap in the sequence numbers of a
+ * line tells which line has lost them. Otherwise, the number of lost events is estimated from the sequence of edges
+ * of every line: edges alternate, so two consecutive edges of the same type on a line mean that (at least) one edge
+ * has been lost. A read that fills the whole buffer means that the kernel queue may have overflowed: if the next
+ * edge comes after a silence much longer than the spacing of the edges of the full read, the queue has most likely
+ * dropped the end of the burst (a suspected gap).
+ *
+ * The depth of the queue is tracked, to size the kernel buffer from the observed bursts (see
+ * `event_counters_recommended_size()`): the number of events of a read or, for a read that fills the buffer, the
+ * rate of the burst multiplied by the age of its oldest event.
+ */
+
+struct event_counters {
+    /** The number of events. */
+    long    events;
+    /** The number of reads (batches). */
+    long    reads;
+    /** The number of reads that returned as many events as the size of the buffer. */
+    long    saturated_reads;
+    /** The estimated number of lost events (edges of the same type in a row). */
+    long    dropped;
+    /** The number of lost events, from the sequence numbers (only if `sequenced` is not 0). */
+    long    lost;
+    /** The number of events with sequence numbers. */
+    long    sequenced;
+    /** The number of silences after a full read that suggest an overflow of the kernel queue. */
+    long    suspected_gaps;
+    /** The greatest (estimated) number of events pending in the kernel queue. */
+    long    peak_depth;
+    /** The maximum number of events returned by a read. See `gpio_input_batch_size()`. */
+    int     buffer_size;
+    /** The timestamps of the first and the last events (in nano seconds). */
+    int64_t first_timestamp;
+    int64_t last_timestamp;
+    /** The spacing of the edges of the last read, if it has filled the buffer (0 otherwise). */
+    int64_t saturated_spacing;
+    /** The sequence number of the last event of the request (0: none yet). */
+    uint32_t last_global_seqno;
+    /** The type of the last edge of every line: 1 (rising), 0 (falling) or -1 (no edge yet). */
+    int8_t  last_rising[EVENT_COUNTERS_MAX_OFFSET];
+    /** The sequence number of the last edge of every line (0: none yet), and the number of edges it has lost. */
+    uint32_t last_line_seqno[EVENT_COUNTERS_MAX_OFFSET];
+    uint32_t line_lost[EVENT_COUNTERS_MAX_OFFSET];
+};
+
+void event_counters_init(struct event_counters *counters, int buffer_size);
+void event_counters_restart(struct event_counters *counters, int buffer_size);
+void event_counters_update(struct event_counters *counters, const struct gpio_event *events, int count);
+int event_counters_recommended_size(const struct event_counters *counters, int max_size);
+void event_counters_print(FILE *stream, const char *name, const struct event_counters *counters);
+
+#endif // EVENT_COUNTERS_H
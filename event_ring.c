@@ -0,0 +1,175 @@
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include "event_ring.h"
+
+/**
+ * Initialise a ring.
+ * @param ring The ring to initialise.
+ * @param capacity The number of events. It must be a power of two.
+ * @return 0 on success, -1 on error.
+ */
+
+int event_ring_init(struct event_ring *ring, size_t capacity) {
+    if (0 == capacity || 0 != (capacity & (capacity - 1))) {
+        errno = EINVAL;
+        return -1;
+    }
+    ring->head        = 0;
+    ring->cached_tail = 0;
+    ring->overflows   = 0;
+    ring->closed      = 0;
+    ring->tail        = 0;
+    ring->cached_head = 0;
+    ring->waiting     = 0;
+    ring->mask        = capacity - 1;
+    // The size passed to aligned_alloc() must be a multiple of the alignment.
+    ring->slots       = aligned_alloc(EVENT_RING_CACHE_LINE_SIZE,
+                                      (capacity * sizeof(struct gpio_event) + EVENT_RING_CACHE_LINE_SIZE - 1)
+                                      & ~(size_t)(EVENT_RING_CACHE_LINE_SIZE - 1));
+    if (NULL == ring->slots) {
+        return -1;
+    }
+    ring->doorbell = eventfd(0, EFD_CLOEXEC);
+    if (-1 == ring->doorbell) {
+        free(ring->slots);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Free the resources of a ring.
+ * @param ring The ring.
+ */
+
+void event_ring_terminate(struct event_ring *ring) {
+    close(ring->doorbell);
+    free(ring->slots);
+}
+
+/**
+ * Wake up the consumer, if it is waiting.
+ * @param ring The ring.
+ */
+
+static void ring_doorbell(struct event_ring *ring) {
+    uint64_t one = 1;
+
+    // Orders the publication of `head` (or `closed`) before the read of `waiting`. The consumer does the opposite,
+    // so at least one of the two threads sees the other one's write.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED)) {
+        while (-1 == write(ring->doorbell, &one, sizeof(one)) && EINTR == errno);
+    }
+}
+
+/**
+ * Push events (producer only). This function never blocks.
+ * @param ring The ring.
+ * @param events The events.
+ * @param count The number of events.
+ * @return The number of events pushed. The other events are dropped (see `overflows`).
+ */
+
+int event_ring_push(struct event_ring *ring, const struct gpio_event *events, int count) {
+    size_t head = ring->head;
+    size_t capacity = ring->mask + 1;
+    int pushed;
+
+    if (head + (size_t)count - ring->cached_tail > capacity) {
+        ring->cached_tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    }
+    pushed = (int)(capacity - (head - ring->cached_tail));
+    if (pushed > count) {
+        pushed = count;
+    }
+    for (int i=0; i<pushed; i++) {
+        ring->slots[(head + (size_t)i) & ring->mask] = events[i];
+    }
+    if (pushed < count) {
+        __atomic_store_n(&ring->overflows, ring->overflows + (count - pushed), __ATOMIC_RELAXED);
+    }
+    if (pushed > 0) {
+        __atomic_store_n(&ring->head, head + (size_t)pushed, __ATOMIC_RELEASE);
+        ring_doorbell(ring);
+    }
+    return pushed;
+}
+
+/**
+ * Tell the consumer that no more events will be pushed (producer only).
+ * @param ring The ring.
+ */
+
+void event_ring_close(struct event_ring *ring) {
+    __atomic_store_n(&ring->closed, 1, __ATOMIC_RELEASE);
+    ring_doorbell(ring);
+}
+
+/**
+ * Pop events (consumer only). This function never blocks.
+ * @param ring The ring.
+ * @param events The array that receives the events.
+ * @param max The maximum number of events to pop.
+ * @return The number of events popped.
+ */
+
+int event_ring_pop(struct event_ring *ring, struct gpio_event *events, int max) {
+    size_t tail = ring->tail;
+    int popped;
+
+    if (ring->cached_head == tail) {
+        ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    }
+    popped = (int)(ring->cached_head - tail);
+    if (popped > max) {
+        popped = max;
+    }
+    for (int i=0; i<popped; i++) {
+        events[i] = ring->slots[(tail + (size_t)i) & ring->mask];
+    }
+    if (popped > 0) {
+        __atomic_store_n(&ring->tail, tail + (size_t)popped, __ATOMIC_RELEASE);
+    }
+    return popped;
+}
+
+/**
+ * Wait until events are available (consumer only).
+ * @param ring The ring.
+ * @return 1 if events are available, 0 if the ring is empty and closed, -1 on error.
+ */
+
+int event_ring_wait(struct event_ring *ring) {
+    uint64_t value;
+
+    for (;;) {
+        if (ring->cached_head != ring->tail) {
+            return 1;
+        }
+        ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (ring->cached_head != ring->tail) {
+            return 1;
+        }
+        if (__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+            // Events pushed before the ring was closed are visible now.
+            ring->cached_head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            return ring->cached_head != ring->tail ? 1 : 0;
+        }
+
+        // Announce the wait, then check again: the producer may have pushed before it could see the announcement.
+        __atomic_store_n(&ring->waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) == ring->tail
+            && !__atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE)) {
+            if (-1 == read(ring->doorbell, &value, sizeof(value)) && EINTR != errno) {
+                __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+                return -1;
+            }
+        }
+        __atomic_store_n(&ring->waiting, 0, __ATOMIC_RELAXED);
+    }
+}
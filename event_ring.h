@@ -0,0 +1,50 @@
+#ifndef EVENT_RING_H
+#define EVENT_RING_H
+
+#include <stddef.h>
+#include "gpio.h"
+
+#define EVENT_RING_CACHE_LINE_SIZE 64
+
+/**
+ * Lock-free single-producer/single-consumer ring of edge events.
+ *
+ * One thread (the producer) pushes events, one thread (the consumer) pops them. The indices written by the producer
+ * and the indices written by the consumer live in distinct cache lines, so that the two threads do not invalidate
+ * each other's cache lines on every event. Each thread also keeps a copy of the other thread's index, and reads the
+ * shared index only when its copy says that the ring is full (producer) or empty (consumer).
+ *
+ * The producer never blocks: when the ring is full, the events are dropped and counted. The consumer may block
+ * until events are available (see `event_ring_wait()`): it is woken up through an eventfd, which is written only
+ * when the consumer is actually waiting.
+ */
+
+struct event_ring {
+    // Written by the producer.
+    size_t head __attribute__((aligned(EVENT_RING_CACHE_LINE_SIZE)));
+    /** The producer's copy of `tail`. */
+    size_t cached_tail;
+    /** The number of events dropped because the ring was full. */
+    long   overflows;
+    int    closed;
+
+    // Written by the consumer.
+    size_t tail __attribute__((aligned(EVENT_RING_CACHE_LINE_SIZE)));
+    /** The consumer's copy of `head`. */
+    size_t cached_head;
+    int    waiting;
+
+    // Read-only after initialisation.
+    struct gpio_event *slots __attribute__((aligned(EVENT_RING_CACHE_LINE_SIZE)));
+    size_t mask;
+    int    doorbell;
+};
+
+int event_ring_init(struct event_ring *ring, size_t capacity);
+void event_ring_terminate(struct event_ring *ring);
+int event_ring_push(struct event_ring *ring, const struct gpio_event *events, int count);
+void event_ring_close(struct event_ring *ring);
+int event_ring_pop(struct event_ring *ring, struct gpio_event *events, int max);
+int event_ring_wait(struct event_ring *ring);
+
+#endif // EVENT_RING_H
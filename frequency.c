@@ -0,0 +1,148 @@
+#include "timing.h"
+#include "frequency.h"
+
+/**
+ * Initialise a meter.
+ * @param meter The meter to initialise.
+ * @param gate The duration of a gate, in nano seconds.
+ */
+
+void frequency_meter_init(struct frequency_meter *meter, int64_t gate) {
+    meter->gate                 = gate;
+    meter->gate_start           = 0;
+    meter->gate_rising          = 0;
+    meter->gate_first           = 0;
+    meter->gate_last            = 0;
+    meter->gate_period_sum      = 0;
+    meter->gate_high_sum        = 0;
+    meter->last_rising          = 0;
+    meter->last_falling         = 0;
+    meter->last_edge_rising     = -1;
+    meter->period_valid         = 0;
+    meter->last_gate_rising     = 0;
+    meter->gated_frequency      = 0.0;
+    meter->reciprocal_frequency = 0.0;
+    meter->duty_cycle           = 0.0;
+    meter->gates                = 0;
+    meter->min_frequency        = 0.0;
+    meter->max_frequency        = 0.0;
+    meter->discarded            = 0;
+    meter->periods              = 0;
+    meter->period_sum           = 0;
+    meter->high_sum             = 0;
+    histogram_init(&meter->period);
+    histogram_init(&meter->high);
+}
+
+/**
+ * Close the current gate: compute its results and start the next gate.
+ * @param meter The meter.
+ */
+
+static void close_gate(struct frequency_meter *meter) {
+    meter->last_gate_rising = meter->gate_rising;
+    meter->gated_frequency  = (double)meter->gate_rising * NSEC_PER_SEC / (double)meter->gate;
+    meter->reciprocal_frequency = meter->gate_rising > 1 && meter->gate_last > meter->gate_first
+        ? (double)(meter->gate_rising - 1) * NSEC_PER_SEC / (double)(meter->gate_last - meter->gate_first)
+        : meter->gated_frequency;
+    meter->duty_cycle = meter->gate_period_sum > 0
+        ? (double)meter->gate_high_sum / (double)meter->gate_period_sum : 0.0;
+
+    if (0 == meter->gates || meter->reciprocal_frequency < meter->min_frequency) {
+        meter->min_frequency = meter->reciprocal_frequency;
+    }
+    if (0 == meter->gates || meter->reciprocal_frequency > meter->max_frequency) {
+        meter->max_frequency = meter->reciprocal_frequency;
+    }
+    meter->gates++;
+
+    meter->gate_start     += meter->gate;
+    meter->gate_rising     = 0;
+    meter->gate_period_sum = 0;
+    meter->gate_high_sum   = 0;
+}
+
+/**
+ * Account for an edge of the measured line.
+ * @param meter The meter.
+ * @param event The edge.
+ * @return 1 if the edge has closed at least one gate (the results of the last gate have changed), 0 otherwise.
+ */
+
+int frequency_meter_update(struct frequency_meter *meter, const struct gpio_event *event) {
+    int64_t timestamp = event->timestamp;
+    int closed = 0;
+
+    if (NULL == meter) {
+        return 0;
+    }
+    if (0 == meter->gate_start) {
+        meter->gate_start = timestamp;
+    }
+    while (timestamp >= meter->gate_start + meter->gate) {
+        close_gate(meter);
+        closed = 1;
+    }
+
+    if (event->rising) {
+        if (meter->period_valid && 0 == meter->last_edge_rising) {
+            int64_t period = timestamp - meter->last_rising;
+            int64_t high = meter->last_falling - meter->last_rising;
+
+            histogram_record(&meter->period, period);
+            histogram_record(&meter->high, high);
+            meter->periods++;
+            meter->period_sum += period;
+            meter->high_sum   += high;
+            // The period is accounted in the gate where it ends.
+            meter->gate_period_sum += period;
+            meter->gate_high_sum   += high;
+        } else if (1 == meter->last_edge_rising) {
+            meter->discarded++;
+        }
+        // A period is complete only if no edge is lost: rising, falling, then rising.
+        meter->period_valid = 0 == meter->last_edge_rising || -1 == meter->last_edge_rising;
+        meter->last_rising  = timestamp;
+        if (0 == meter->gate_rising) {
+            meter->gate_first = timestamp;
+        }
+        meter->gate_last = timestamp;
+        meter->gate_rising++;
+    } else {
+        if (0 == meter->last_edge_rising) {
+            meter->period_valid = 0;
+            meter->discarded++;
+        }
+        meter->last_falling = timestamp;
+    }
+    meter->last_edge_rising = event->rising != 0;
+    return closed;
+}
+
+/**
+ * Print the results of a meter.
+ * @param stream The stream to print to.
+ * @param meter The meter.
+ */
+
+void frequency_meter_print(FILE *stream, const struct frequency_meter *meter) {
+    double mean_period, mean_high;
+
+    if (NULL == meter) {
+        return;
+    }
+    fprintf(stream, "frequency: %ld gates of %lld ns, last gate: gated %.3f Hz, reciprocal %.3f Hz, duty %.2f%%\n",
+            meter->gates, (long long)meter->gate, meter->gated_frequency, meter->reciprocal_frequency,
+            100.0 * meter->duty_cycle);
+    fprintf(stream, "frequency: reciprocal min %.3f Hz, max %.3f Hz, %ld periods discarded (lost edges)\n",
+            meter->min_frequency, meter->max_frequency, meter->discarded);
+    if (0 == meter->periods) {
+        return;
+    }
+    mean_period = (double)meter->period_sum / (double)meter->periods;
+    mean_high   = (double)meter->high_sum / (double)meter->periods;
+    fprintf(stream, "frequency: %ld periods, mean period %.0f ns (%.3f Hz), mean duty %.2f%%\n",
+            meter->periods, mean_period, NSEC_PER_SEC / mean_period, 100.0 * mean_high / mean_period);
+    histogram_print(stream, "period", &meter->period);
+    histogram_print(stream, "high time", &meter->high);
+}
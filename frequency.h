@@ -0,0 +1,72 @@
+#ifndef FREQUENCY_H
+#define FREQUENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "gpio.h"
+#include "histogram.h"
+
+/**
+ * Frequency counter of an input line, computed from the kernel timestamps of its edges.
+ *
+ * The time is divided into gates of fixed duration. At the end of each gate, the meter computes:
+ *
+ *   - the gated frequency: the number of rising edges in the gate divided by the duration of the gate. Its
+ *     resolution is one edge per gate (10 Hz with a gate of 100 ms).
+ *   - the reciprocal frequency: the number of periods between the first and the last rising edges of the gate,
+ *     divided by the time between these edges. Its resolution only depends on the precision of the timestamps, so
+ *     it is the accurate measure at low frequencies.
+ *   - the duty cycle: the time spent high divided by the duration of the complete periods of the gate.
+ *
+ * The period and the high time of every complete period (rising, falling, rising edges) are also recorded in
+ * histograms. A period that contains a lost edge (two consecutive edges of the same type) is discarded. All the
+ * functions accept a NULL meter, and then do nothing.
+ */
+
+struct frequency_meter {
+    /** The duration of a gate, in nano seconds. */
+    int64_t gate;
+    /** The beginning of the current gate (0: no edge yet). */
+    int64_t gate_start;
+    /** The rising edges of the current gate: count, first and last timestamps. */
+    long    gate_rising;
+    int64_t gate_first;
+    int64_t gate_last;
+    /** The complete periods of the current gate: sum of their durations and of their high times. */
+    int64_t gate_period_sum;
+    int64_t gate_high_sum;
+    /** The timestamps of the last rising and falling edges (0: none). */
+    int64_t last_rising;
+    int64_t last_falling;
+    /** The type of the last edge (-1: none). */
+    int     last_edge_rising;
+    /** 1 if the current period started with a rising edge that follows a falling one (no edge lost). */
+    int     period_valid;
+
+    /** The results of the last complete gate. */
+    long    last_gate_rising;
+    double  gated_frequency;
+    double  reciprocal_frequency;
+    double  duty_cycle;
+
+    /** The number of complete gates. */
+    long    gates;
+    /** The minimum and maximum of the reciprocal frequency, over all the gates (in Hz). */
+    double  min_frequency;
+    double  max_frequency;
+    /** The number of periods discarded because of a lost edge. */
+    long    discarded;
+    /** The number of complete periods, and the sums of their durations and of their high times (in nano seconds). */
+    long    periods;
+    int64_t period_sum;
+    int64_t high_sum;
+    /** The durations of the complete periods and their high times (in nano seconds). */
+    struct histogram period;
+    struct histogram high;
+};
+
+void frequency_meter_init(struct frequency_meter *meter, int64_t gate);
+int frequency_meter_update(struct frequency_meter *meter, const struct gpio_event *event);
+void frequency_meter_print(FILE *stream, const struct frequency_meter *meter);
+
+#endif // FREQUENCY_H
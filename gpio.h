@@ -0,0 +1,82 @@
+#ifndef GPIO_H
+#define GPIO_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Thin layer over libgpiod. Two implementations are available, selected at build time (see CMakeLists.txt):
+//
+// * gpio_v1.c: libgpiod v1 (`gpiod_chip_get_line()`, `gpiod_line_request_output()`, `gpiod_line_event_read()`...).
+// * gpio_v2.c: libgpiod v2 (`gpiod_line_request`, `gpiod_edge_event_buffer`...).
+//
+// All functions follow the conventions of libgpiod: upon error, they return -1 (or NULL) and `errno` is set.
+
+struct gpio_chip;
+
+/**
+ * A set of lines requested as outputs.
+ *
+ * The request keeps the last value written to each of its lines (a shadow of the lines, which no other request can
+ * change): a write that would not change any line is elided (no ioctl), and a bulk write only carries the lines that
+ * change (libgpiod v2; libgpiod v1 can only write all the lines of the request).
+ */
+struct gpio_output;
+
+/**
+ * The writes of an output request.
+ */
+
+struct gpio_output_counters {
+    /** The number of writes passed to the kernel (ioctls). */
+    long issued;
+    /** The number of writes skipped because the lines already had the values. */
+    long elided;
+};
+
+/** A set of lines requested as inputs, with edge detection on both edges. */
+struct gpio_input;
+
+/**
+ * An edge event.
+ */
+
+struct gpio_event {
+    /** The kernel timestamp of the event (CLOCK_MONOTONIC, in nano seconds). */
+    int64_t      timestamp;
+    /** The offset of the line. */
+    unsigned int offset;
+    /** 1 for a rising edge, 0 for a falling edge. */
+    int          rising;
+    /**
+     * The sequence numbers of the event among the events of the request and among the events of the line, as given
+     * by the kernel (they start at 1, and a gap means lost events). 0: not available (libgpiod v1).
+     */
+    uint32_t     global_seqno;
+    uint32_t     line_seqno;
+};
+
+const char *gpio_backend_name(void);
+
+struct gpio_chip *gpio_chip_open(const char *name);
+void gpio_chip_close(struct gpio_chip *chip);
+int gpio_chip_reset_lines(struct gpio_chip *chip, const unsigned int *offsets, int count);
+
+struct gpio_output *gpio_output_request(struct gpio_chip *chip, const char *consumer,
+                                        const unsigned int *offsets, int count, const int *values);
+int gpio_output_set_value(struct gpio_output *output, int index, int value);
+int gpio_output_set_values(struct gpio_output *output, const int *values);
+const struct gpio_output_counters *gpio_output_get_counters(struct gpio_output *output);
+void gpio_output_counters_print(FILE *stream, const char *name, const struct gpio_output_counters *counters);
+void gpio_output_release(struct gpio_output *output);
+
+struct gpio_input *gpio_input_request(struct gpio_chip *chip, const char *consumer,
+                                      const unsigned int *offsets, int count, int event_buffer_size);
+int gpio_input_fd(struct gpio_input *input);
+int gpio_input_batch_size(struct gpio_input *input);
+int gpio_input_resizable(void);
+int gpio_input_wait(struct gpio_input *input, int64_t timeout);
+int gpio_input_read(struct gpio_input *input, struct gpio_event *events, int max);
+int gpio_input_get_values(struct gpio_input *input, int *values);
+void gpio_input_release(struct gpio_input *input);
+
+#endif // GPIO_H
@@ -1,9 +1,19 @@
-#include <gpiod.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <time.h>
 #include <errno.h>
 #include <pthread.h>
+#include "gpio.h"
+#include "timing.h"
+#include "scheduler.h"
+#include "rt.h"
+#include "stats.h"
+#include "logger.h"
+#include "pwm.h"
+#include "pattern.h"
+#include "text_file.h"
 
 // Get the GPIO chip name:
 //
@@ -33,6 +43,28 @@
 
 #define NUMBER_OF_LED 2 // The green LED and the red LED.
 
+#define PWM_PERIOD_NS   1000000    // 1 kHz
+#define PWM_DURATION_NS 5000000000 // 5 seconds
+
+#define PATTERN_PASSES   5
+#define PATTERN_MAX_SIZE (64 * 1024)
+
+/**
+ * The default LED animation (see `pattern_parse()`): line 0 is the green LED, line 1 is the red LED.
+ * The last step has no write: it sets the length of the pattern.
+ */
+
+static const char *DEFAULT_PATTERN =
+    "0     0=1 1=0\n"
+    "100ms 0=0\n"
+    "200ms 0=1\n"
+    "300ms 0=0\n"
+    "500ms 1=1\n"
+    "600ms 1=0\n"
+    "700ms 1=1\n"
+    "800ms 1=0\n"
+    "1s\n";
+
 /**
  * Data passed to the function that implements a thread used to control a LED.
  */
@@ -46,11 +78,17 @@ struct issuer_args {
     long duration_nano_sec;
     /** The number of changes of state. */
     long count;
+    /** The instant of the first change of state (see `timing_now()`). */
+    int64_t epoch;
+    /** The busy-wait margin of the precision timing mode (0: sleep only). See `timing_calibrate()`. */
+    int64_t spin_margin;
     /** The (GPIO) line ID that controls the state of the LED. */
     int line_id;
     const char *name;
     /** The (GPIO) chip ID. */
-    struct gpiod_chip *chip;
+    struct gpio_chip *chip;
+    /** The real-time profile of the thread. */
+    const struct rt_profile *profile;
 };
 
 /**
@@ -63,6 +101,17 @@ void error(char *message) {
     exit(1);
 }
 
+/**
+ * Format the record of a change of state (see `log_write()`).
+ * @param stream The stream to print to.
+ * @param record The record.
+ */
+
+void format_led(FILE *stream, const struct log_record *record) {
+    fprintf(stream, "G [%4ld] Set %s (late %lld ns)\n", record->cycle, record->value ? "up" : "down",
+            (long long)record->extra);
+}
+
 /**
  * Implement the thread that controls a LED.
  * @param in_args Pointer to `struct led_args`.
@@ -70,108 +119,484 @@ void error(char *message) {
 
 void* led_thread(void *in_args) {
     struct issuer_args *args = (struct issuer_args*)in_args;
-    struct gpiod_line  *led;
-    struct timespec duration = { args->duration_sec, args->duration_nano_sec };
-    struct timespec remaining;
-    struct timespec remaining_again;
-    struct timespec *d, *r;
-
-    // Open GPIO lines. Set the line as output.
-    led = gpiod_chip_get_line(args->chip, args->line_id);
-    if (NULL == led) {
-        error("cannot get the line");
-    }
+    struct gpio_output *led;
+    unsigned int       offset = (unsigned int)args->line_id;
+    int                initial_value = 0;
+    struct deadline schedule;
+    struct rt_thread_state rt_state;
+    struct line_stats *stats = stats_register(args->name, args->line_id);
+    struct log_buffer *log = logger_register();
+    int64_t lateness = 0;
 
     // Open LED lines for output
-    if (-1 == gpiod_line_request_output(led, args->name, 0)) {
-        gpiod_line_release(led);
+    led = gpio_output_request(args->chip, args->name, &offset, 1, &initial_value);
+    if (NULL == led) {
         error("cannot request the output");
     }
 
+    rt_thread_enter(args->profile, &rt_state);
+    deadline_init(&schedule, args->epoch, args->duration_sec, args->duration_nano_sec);
+    schedule.spin_margin = args->spin_margin;
     for (long cycle=0; cycle<args->count; cycle++) {
         int state = (cycle & 0x1) != 0;
-        int done;
 
-        d = &duration;
-        r = &remaining;
-        printf("G [%4ld] Set %s\n", cycle, state ? "up" : "down");
-        if (-1 == gpiod_line_set_value(led, state)) {
+        log_write(log, &format_led, cycle, args->line_id, state, lateness);
+        if (-1 == gpio_output_set_value(led, 0, state)) {
             error("cannot change the value of the output");
         }
+        stats_record(stats, schedule.epoch + cycle * schedule.period, timing_now());
 
-        do {
-            done = 1;
-            if (-1 == nanosleep(d, r)) {
-                switch (errno) {
-                    case EINTR: {
-                        d = r;
-                        r = &remaining_again;
-                        done = 0;
-                    }; break;
-                    case EFAULT: error("problem with copying information from user space");
-                    case EINVAL: error("unexpected period duration");
-                    default: error("unexpected errno value");
-                }
-            }
-        } while(! done);
+        if (-1 == deadline_wait(&schedule, &lateness)) {
+            error("cannot wait for the next deadline");
+        }
     }
+    deadline_print(stdout, args->name, &schedule);
+    rt_thread_report(stdout, args->name, &rt_state);
 
     // Avoid useless current drain.
-    if (-1 == gpiod_line_set_value(led, 0)) {
+    if (-1 == gpio_output_set_value(led, 0, 0)) {
         error("cannot change the value of the output");
     }
+    gpio_output_counters_print(stdout, args->name, gpio_output_get_counters(led));
 
-    gpiod_line_release(led);
+    gpio_output_release(led);
     return NULL;
 }
 
 
 
-int main()
+/**
+ * Print the usage and terminate the program.
+ * @param program The name of the program.
+ */
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-m threads|scheduler|bulk|pwm|pattern] [-c chip] [-s line]... [-P policy[:priority]] "
+                    "[-C cpu|auto] [-L] [-O off|sync|async] [-d green,red] [-p file]\n", program);
+    fprintf(stderr, "  -m threads:   one thread per LED (default).\n");
+    fprintf(stderr, "  -m scheduler: all LEDs driven by a single thread, one ioctl per transition.\n");
+    fprintf(stderr, "  -m bulk:      all LEDs driven by a single thread, simultaneous transitions in one ioctl.\n");
+    fprintf(stderr, "  -m pwm:       dim the LEDs with the PWM engine (1 kHz, for 5 seconds).\n");
+    fprintf(stderr, "  -d duty:      the duty cycles of the LEDs, in percents (pwm mode, default: 10,50).\n");
+    fprintf(stderr, "  -m pattern:   play a LED animation %d times (see pattern.h).\n", PATTERN_PASSES);
+    fprintf(stderr, "  -p file:      the animation (pattern mode, line 0: green, line 1: red).\n");
+    fprintf(stderr, "  -c chip:      the GPIO chip (default: %s, %s).\n", CHIP_NAME, gpio_backend_name());
+    fprintf(stderr, "  -s line:      precision timing (sleep, then spin) for the given line (%d or %d), in the\n"
+                    "                threads and pattern modes.\n", GREEN_LED_LINE, RED_LED_LINE);
+    fprintf(stderr, "  -P policy:    scheduling policy of the LED threads: fifo, rr or other (ex: fifo:80).\n");
+    fprintf(stderr, "  -C cpu:       pin the LED threads to a CPU (\"auto\": the first isolated CPU).\n");
+    fprintf(stderr, "  -L:           lock the memory and prefault the stacks.\n");
+    fprintf(stderr, "  -O log:       per-cycle messages: off, sync (printf) or async (default).\n");
+    fprintf(stderr, "Send SIGUSR1 to print the timing statistics of the LEDs.\n");
+    exit(1);
+}
+
+/**
+ * Drive the LEDs using one thread per LED.
+ * @param all_args The LEDs.
+ * @param count The number of LEDs.
+ */
+
+void run_threads(struct issuer_args *all_args, int count) {
+    pthread_t all_threads[NUMBER_OF_LED];
+
+    for (int i=0; i<count; i++) {
+        if (0 != pthread_create(&all_threads[i], NULL, &led_thread, (void*)&all_args[i])) {
+            error("cannot create the thread for a LED");
+        }
+    }
+
+    // Wait for all threads.
+    for (int i=0; i<count; i++) {
+        pthread_join(all_threads[i], NULL);
+    }
+}
+
+/**
+ * The LED lines driven by the scheduler.
+ *
+ * Either each line is a separate request (one ioctl per transition), or all the lines are requested as a single
+ * bulk (the values of all the lines are written with a single ioctl).
+ */
+
+struct leds {
+    /** The requests: one per line, or a single one for all the lines (bulk). */
+    struct gpio_output *outputs[NUMBER_OF_LED];
+    int                line_ids[NUMBER_OF_LED];
+    /** The current value of every line. */
+    int                values[NUMBER_OF_LED];
+    int                count;
+};
+
+int leds_index(struct leds *leds, int line_id) {
+    for (int i=0; i<leds->count; i++) {
+        if (line_id == leds->line_ids[i]) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Change the value of a line. This function is the (per line) backend of the scheduler.
+ * @param context Pointer to `struct leds`.
+ * @param line_id The (GPIO) line ID.
+ * @param value The value.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1.
+ */
+
+int leds_set_value(void *context, int line_id, int value) {
+    struct leds *leds = (struct leds*)context;
+    int index = leds_index(leds, line_id);
+
+    if (-1 == index) {
+        return -1;
+    }
+    leds->values[index] = value;
+    return gpio_output_set_value(leds->outputs[index], 0, value);
+}
+
+/**
+ * Change the values of several lines with a single ioctl. This function is the bulk backend of the scheduler.
+ * @param context Pointer to `struct leds`.
+ * @param count The number of lines to change.
+ * @param line_ids The (GPIO) line IDs.
+ * @param values The values.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1.
+ */
+
+int leds_set_values(void *context, int count, const int *line_ids, const int *values) {
+    struct leds *leds = (struct leds*)context;
+
+    for (int i=0; i<count; i++) {
+        int index = leds_index(leds, line_ids[i]);
+        if (-1 == index) {
+            return -1;
+        }
+        leds->values[index] = values[i];
+    }
+    return gpio_output_set_values(leds->outputs[0], leds->values);
+}
+
+int leds_bulk_set_value(void *context, int line_id, int value) {
+    return leds_set_values(context, 1, &line_id, &value);
+}
+
+/**
+ * Request the LED lines, and set the backend that drives them.
+ * On error, the program terminates.
+ * @param leds The LED lines.
+ * @param backend The backend to set.
+ * @param all_args The LEDs.
+ * @param count The number of LEDs.
+ * @param bulk Tell whether the LEDs must be requested as a single bulk, so that the transitions due at the same
+ *        instant are committed with a single ioctl. Otherwise, each transition is a separate ioctl.
+ */
+
+void leds_open(struct leds *leds, struct output_backend *backend, struct issuer_args *all_args, int count, int bulk) {
+    struct gpio_chip *chip = all_args[0].chip;
+    unsigned int offsets[NUMBER_OF_LED];
+
+    backend->context    = leds;
+    backend->set_value  = &leds_set_value;
+    backend->set_values = NULL;
+    leds->count = count;
+    for (int i=0; i<count; i++) {
+        offsets[i]        = (unsigned int)all_args[i].line_id;
+        leds->line_ids[i] = all_args[i].line_id;
+        leds->values[i]   = 0;
+        if (!bulk) {
+            leds->outputs[i] = gpio_output_request(chip, all_args[i].name, &offsets[i], 1, &leds->values[i]);
+            if (NULL == leds->outputs[i]) {
+                error("cannot request the output");
+            }
+        }
+    }
+    if (bulk) {
+        leds->outputs[0] = gpio_output_request(chip, "leds", offsets, count, leds->values);
+        if (NULL == leds->outputs[0]) {
+            error("cannot request the outputs");
+        }
+        backend->set_value  = &leds_bulk_set_value;
+        backend->set_values = &leds_set_values;
+    }
+}
+
+/**
+ * Release the LED lines.
+ * @param leds The LED lines.
+ * @param bulk Tell whether the LEDs have been requested as a single bulk.
+ */
+
+void leds_close(struct leds *leds, int bulk) {
+    for (int i=0; i<(bulk ? 1 : leds->count); i++) {
+        gpio_output_counters_print(stdout, bulk ? "leds" : "led", gpio_output_get_counters(leds->outputs[i]));
+        gpio_output_release(leds->outputs[i]);
+    }
+}
+
+/**
+ * Drive the LEDs from the calling thread, using the scheduler.
+ * @param all_args The LEDs.
+ * @param count The number of LEDs.
+ * @param bulk Tell whether the LEDs must be requested as a single bulk, so that the transitions due at the same
+ *        instant are committed with a single ioctl. Otherwise, each transition is a separate ioctl.
+ */
+
+void run_scheduler(struct issuer_args *all_args, int count, int bulk) {
+    struct leds leds;
+    struct output_backend backend;
+    struct scheduler scheduler;
+    struct rt_thread_state rt_state;
+
+    leds_open(&leds, &backend, all_args, count, bulk);
+
+    if (-1 == scheduler_init(&scheduler, count, &backend)) {
+        error("cannot create the scheduler");
+    }
+    for (int i=0; i<count; i++) {
+        if (-1 == scheduler_add(&scheduler, all_args[i].duration_sec, all_args[i].duration_nano_sec,
+                                all_args[i].count, all_args[i].line_id,
+                                stats_register(all_args[i].name, all_args[i].line_id))) {
+            error("cannot add the LED to the scheduler");
+        }
+    }
+
+    rt_thread_enter(all_args[0].profile, &rt_state);
+    if (-1 == scheduler_run(&scheduler, all_args[0].epoch)) {
+        error("cannot change the value of the output");
+    }
+    rt_thread_report(stdout, "scheduler", &rt_state);
+    printf("scheduler: %ld wakeups, %ld transitions, %ld ioctls, lateness average %lld ns, max %lld ns\n",
+           scheduler.wakeups, scheduler.transitions, scheduler.commits,
+           (long long)(scheduler.wakeups > 0 ? scheduler.lateness_sum / scheduler.wakeups : 0),
+           (long long)scheduler.lateness_max);
+    histogram_print(stdout, bulk ? "skew of simultaneous transitions, bulk (ns)"
+                                 : "skew of simultaneous transitions, per line (ns)", &scheduler.skew);
+
+    leds_close(&leds, bulk);
+    scheduler_terminate(&scheduler);
+}
+
+/**
+ * Dim the LEDs from the calling thread, using the PWM engine. The LEDs are requested as a single bulk.
+ * @param all_args The LEDs.
+ * @param count The number of LEDs.
+ * @param duty_cycles The duty cycle of every LED, in percents.
+ */
+
+void run_pwm(struct issuer_args *all_args, int count, const int *duty_cycles) {
+    struct leds leds;
+    struct output_backend backend;
+    struct pwm pwm;
+    struct rt_thread_state rt_state;
+
+    leds_open(&leds, &backend, all_args, count, 1);
+    if (-1 == pwm_init(&pwm, count, &backend)) {
+        error("cannot create the PWM engine");
+    }
+    for (int i=0; i<count; i++) {
+        if (-1 == pwm_add(&pwm, all_args[i].line_id, PWM_PERIOD_NS, PWM_PERIOD_NS * duty_cycles[i] / 100)) {
+            error("cannot add the LED to the PWM engine");
+        }
+    }
+
+    rt_thread_enter(all_args[0].profile, &rt_state);
+    if (-1 == pwm_run(&pwm, all_args[0].epoch, PWM_DURATION_NS)) {
+        error("cannot change the value of the output");
+    }
+    rt_thread_report(stdout, "pwm", &rt_state);
+    printf("pwm: %ld wakeups, %ld edges, %ld ioctls\n", pwm.wakeups, pwm.edges, pwm.commits);
+    histogram_print(stdout, "pwm edge lateness (ns)", &pwm.lateness);
+
+    leds_close(&leds, 1);
+    pwm_terminate(&pwm);
+}
+
+/**
+ * Play a LED animation from the calling thread.
+ * @param all_args The LEDs.
+ * @param count The number of LEDs.
+ * @param text The animation (see `pattern_parse()`).
+ */
+
+void run_pattern(struct issuer_args *all_args, int count, const char *text) {
+    struct leds leds;
+    struct output_backend backend;
+    struct pattern pattern;
+    struct pattern_player player;
+    struct rt_thread_state rt_state;
+    int line_ids[NUMBER_OF_LED];
+    int64_t spin_margin = 0;
+
+    for (int i=0; i<count; i++) {
+        line_ids[i] = all_args[i].line_id;
+        if (all_args[i].spin_margin > spin_margin) {
+            spin_margin = all_args[i].spin_margin;
+        }
+    }
+    if (-1 == pattern_init(&pattern, line_ids, count) || -1 == pattern_parse(&pattern, text)
+        || -1 == pattern_compile(&pattern, 0)) {
+        error("invalid pattern");
+    }
+    leds_open(&leds, &backend, all_args, count, 1);
+    pattern_player_init(&player, &pattern, &backend, spin_margin);
+
+    rt_thread_enter(all_args[0].profile, &rt_state);
+    if (-1 == pattern_play(&player, all_args[0].epoch, PATTERN_PASSES)) {
+        error("cannot play the pattern");
+    }
+    rt_thread_report(stdout, "pattern", &rt_state);
+    printf("pattern: %ld passes, %ld steps, %ld ioctls, %ld overruns\n",
+           player.passes, player.steps, player.commits, player.overruns);
+    histogram_print(stdout, "pattern step lateness (ns)", &player.lateness);
+
+    leds_close(&leds, 1);
+    pattern_terminate(&pattern);
+}
+
+int main(int argc, char *argv[])
 {
-    struct gpiod_chip  *chip;
-    struct issuer_args green_args, red_args;
-    pthread_t          all_threads[NUMBER_OF_LED];
-    int       all_threads_index = 0;
+    struct gpio_chip   *chip;
+    struct issuer_args all_args[NUMBER_OF_LED];
+    struct issuer_args *green_args = &all_args[0];
+    struct issuer_args *red_args = &all_args[1];
+    const char         *mode = "threads";
+    const char         *chip_name = CHIP_NAME;
+    int64_t            epoch;
+    int                option;
+    int                precise_lines[NUMBER_OF_LED];
+    int                precise_count = 0;
+    int64_t            spin_margin = 0;
+    struct rt_profile  profile;
+    int                log_mode = LOGGER_ASYNC;
+    int                duty_cycles[NUMBER_OF_LED] = { 10, 50 };
+    const char         *pattern_path = NULL;
+    char               *pattern_text = NULL;
+
+    rt_profile_init(&profile);
+    while (-1 != (option = getopt(argc, argv, "m:c:s:P:C:LO:d:p:"))) {
+        switch (option) {
+            case 'm': mode = optarg; break;
+            case 'c': chip_name = optarg; break;
+            case 'p': pattern_path = optarg; break;
+            case 'P': {
+                if (-1 == rt_profile_parse_policy(&profile, optarg)) {
+                    usage(argv[0]);
+                }
+            }; break;
+            case 'C': {
+                if (-1 == rt_profile_parse_cpu(&profile, optarg)) {
+                    usage(argv[0]);
+                }
+            }; break;
+            case 'L': {
+                profile.lock_memory    = 1;
+                profile.prefault_stack = RT_PREFAULT_STACK_SIZE;
+            }; break;
+            case 'O': {
+                if (-1 == (log_mode = logger_parse_mode(optarg))) {
+                    usage(argv[0]);
+                }
+            }; break;
+            case 'd': {
+                if (2 != sscanf(optarg, "%d,%d", &duty_cycles[0], &duty_cycles[1])
+                    || duty_cycles[0] < 0 || duty_cycles[0] > 100 || duty_cycles[1] < 0 || duty_cycles[1] > 100) {
+                    usage(argv[0]);
+                }
+            }; break;
+            case 's': {
+                if (precise_count == NUMBER_OF_LED) {
+                    usage(argv[0]);
+                }
+                precise_lines[precise_count++] = atoi(optarg);
+            }; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (0 != strcmp(mode, "threads") && 0 != strcmp(mode, "scheduler") && 0 != strcmp(mode, "bulk")
+        && 0 != strcmp(mode, "pwm") && 0 != strcmp(mode, "pattern")) {
+        usage(argv[0]);
+    }
+    // The scheduler and the PWM engine sleep until their deadlines: only the threads and the pattern player spin.
+    if (precise_count > 0 && 0 != strcmp(mode, "threads") && 0 != strcmp(mode, "pattern")) {
+        fprintf(stderr, "-s is only supported in the threads and pattern modes\n");
+        usage(argv[0]);
+    }
+    if (NULL != pattern_path && NULL == (pattern_text = read_text_file(pattern_path, PATTERN_MAX_SIZE))) {
+        error("cannot read the pattern (missing, or larger than 64 KB)");
+    }
+
+    rt_lock_memory(&profile);
+
+    // Must be done before any other thread is created.
+    if (-1 == stats_start_signal_thread()) {
+        error("cannot start the statistics thread");
+    }
+    if (-1 == logger_start(stdout, log_mode)) {
+        error("cannot start the logger");
+    }
 
     // Open GPIO chip
-    chip = gpiod_chip_open_by_name(CHIP_NAME);
+    chip = gpio_chip_open(chip_name);
     if (NULL == chip) {
         error("cannot open the chip");
     }
 
-    green_args.duration_sec      = 0;
-    green_args.duration_nano_sec = 999999999 / 2; // 1/2 second
-    green_args.count             = 50;
-    green_args.line_id           = GREEN_LED_LINE;
-    green_args.name              = "green";
-    green_args.chip              = chip;
+    // The margin of the precision timing mode is the overshoot of the sleeps observed on this system.
+    if (precise_count > 0) {
+        spin_margin = timing_calibrate(CALIBRATION_SAMPLES);
+        if (-1 == spin_margin) {
+            error("cannot calibrate the precision timing mode");
+        }
+        printf("Precision timing: spin margin %lld ns\n", (long long)spin_margin);
+    }
 
-    red_args.duration_sec      = 0;
-    red_args.duration_nano_sec = 999999999 / 3; // 1/3 second
-    red_args.count             = 50;
-    red_args.line_id           = RED_LED_LINE;
-    red_args.name              = "red";
-    red_args.chip              = chip;
+    // Both LEDs share the same epoch, so they stay in phase.
+    epoch = timing_now();
 
-    // Start the green LED.
-    if (0 != pthread_create(&all_threads[all_threads_index++], NULL,
-                            &led_thread, (void*)&green_args)) {
-        error("cannot create the thread for the green LED");
-    }
+    green_args->duration_sec      = 0;
+    green_args->duration_nano_sec = 999999999 / 2; // 1/2 second
+    green_args->count             = 50;
+    green_args->epoch             = epoch;
+    green_args->line_id           = GREEN_LED_LINE;
+    green_args->name              = "green";
+    green_args->chip              = chip;
+    green_args->profile           = &profile;
+
+    red_args->duration_sec      = 0;
+    red_args->duration_nano_sec = 999999999 / 3; // 1/3 second
+    red_args->count             = 50;
+    red_args->epoch             = epoch;
+    red_args->line_id           = RED_LED_LINE;
+    red_args->name              = "red";
+    red_args->chip              = chip;
+    red_args->profile           = &profile;
 
-    // Start the green LED.
-    if (0 != pthread_create(&all_threads[all_threads_index++], NULL,
-                            &led_thread, (void*)&red_args)) {
-        error("cannot create the thread for the red LED");
+    for (int i=0; i<NUMBER_OF_LED; i++) {
+        all_args[i].spin_margin = 0;
+        for (int j=0; j<precise_count; j++) {
+            if (precise_lines[j] == all_args[i].line_id) {
+                all_args[i].spin_margin = spin_margin;
+            }
+        }
     }
 
-    // Wait for all threads.
-    for (int i=0; i<all_threads_index; i++) {
-        pthread_join(all_threads[i], NULL);
+    if (0 == strcmp(mode, "scheduler") || 0 == strcmp(mode, "bulk")) {
+        run_scheduler(all_args, NUMBER_OF_LED, 0 == strcmp(mode, "bulk"));
+    } else if (0 == strcmp(mode, "pwm")) {
+        run_pwm(all_args, NUMBER_OF_LED, duty_cycles);
+    } else if (0 == strcmp(mode, "pattern")) {
+        run_pattern(all_args, NUMBER_OF_LED, NULL != pattern_text ? pattern_text : DEFAULT_PATTERN);
+    } else {
+        run_threads(all_args, NUMBER_OF_LED);
     }
 
+    logger_stop();
+    stats_dump(stdout);
+
     // Release the chip.
-    gpiod_chip_close(chip);
+    gpio_chip_close(chip);
+    free(pattern_text);
     return 0;
-}
\ No newline at end of file
+}
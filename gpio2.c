@@ -1,9 +1,25 @@
-#include <gpiod.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <time.h>
 #include <errno.h>
 #include <string.h>
 #include <pthread.h>
+#include <unistd.h>
+#include "gpio.h"
+#include "timing.h"
+#include "reactor.h"
+#include "rt.h"
+#include "stats.h"
+#include "event_counters.h"
+#include "event_ring.h"
+#include "monitor.h"
+#include "latency.h"
+#include "frequency.h"
+#include "gpio_sim.h"
+#include "logger.h"
+#include "journal.h"
+#include "rules.h"
+#include "text_file.h"
 
 // Get the GPIO chip name:
 //
@@ -33,7 +49,31 @@
 #define GPIO_17 17
 #define GPIO_21 21
 #define NUMBER_OF_THREAD 2
-static struct gpiod_chip *CHIP;
+/** The maximum number of edge events read at once by the receiver (and the size of the kernel queue, with libgpiod v2). */
+#define RECEIVER_BATCH_SIZE 64
+/** The number of events buffered between the capture thread and the processing thread (ring mode). */
+#define RING_CAPACITY 4096
+/** The maximum number of lines monitored by the receiver (a request holds at most 64 lines, ex: a libgpiod v1 bulk). */
+#define MAX_MONITORED_LINES 64
+/** The maximum number of input lines watched along with the receiver line. */
+#define MAX_WATCHED_LINES (MAX_MONITORED_LINES - 1)
+/** The number of segments of a journal kept on disk (64 MB each). */
+#define JOURNAL_SEGMENTS 16
+/** The maximum size of a rules file. */
+#define RULES_MAX_SIZE (64 * 1024)
+static struct gpio_chip *CHIP;
+static struct rt_profile PROFILE;
+/** The profile of the busy-poll receiver (poll mode): the profile of the other threads, on a dedicated CPU. */
+static struct rt_profile POLL_PROFILE;
+/** The loopback latency probe (NULL: no measure). */
+static struct latency_probe *PROBE = NULL;
+/** The frequency meter of the receiver line (NULL: no measure). */
+static struct frequency_meter *METER = NULL;
+/** The journals of the issuer's transitions and of the receiver's edges (NULL: not recorded). */
+static struct journal *ISSUER_JOURNAL = NULL;
+static struct journal *RECEIVER_JOURNAL = NULL;
+/** The reactions of the receiver (NULL: toggle the controller line on the edges of the receiver line). */
+static struct rule_engine *RULES = NULL;
 
 /**
  * Print an error message and terminate the program.
@@ -51,20 +91,50 @@ void error(char *message) {
 
 void reset_gpio() {
     printf("Reset GPIO\n");
-    int pins[3] = { GPIO_16, GPIO_17, GPIO_21};
+    unsigned int pins[3] = { GPIO_16, GPIO_17, GPIO_21};
     for (int i=0; i<3; i++) {
-        struct gpiod_line *l = gpiod_chip_get_line(CHIP, pins[i]);
-        if (NULL == l) {
-            fprintf(stderr, "Warning: error while resetting line #%d (gpiod_chip_get_line() - errno: %d)\n", pins[i], errno);
-            continue;
+        if (-1 == gpio_chip_reset_lines(CHIP, &pins[i], 1)) {
+            fprintf(stderr, "Warning: error while resetting line #%u (errno: %d)\n", pins[i], errno);
         }
-        if (-1 == gpiod_line_request_input(l, "line")) {
-            fprintf(stderr, "Warning: error while resetting line #%d (gpiod_line_request_input() - errno: %d)\n", pins[i], errno);
-            continue;
-        }
-        gpiod_line_release(l);
     }
-    gpiod_chip_close(CHIP);
+    gpio_chip_close(CHIP);
+}
+
+// ---------------------------------------------------------------------------------
+// LOG
+// ---------------------------------------------------------------------------------
+
+// The hot paths only write binary records (see logger.h): these functions format them.
+
+void format_set(FILE *stream, const struct log_record *record) {
+    fprintf(stream, "I [%4ld] Set %s (late %lld ns)\n", record->cycle, record->value ? "up" : "down",
+            (long long)record->extra);
+}
+
+void format_edges(FILE *stream, const struct log_record *record) {
+    fprintf(stream, "Get %lld event(s)!\n", (long long)record->extra);
+}
+
+/** `cycle`: rising edges in the gate, `value`: duty cycle (1/10000), `extra`: reciprocal frequency (mHz). */
+void format_frequency(FILE *stream, const struct log_record *record) {
+    fprintf(stream, "F [%3d] gated %.1f Hz, reciprocal %.3f Hz, duty %.2f%%\n", record->line_id,
+            (double)record->cycle * NSEC_PER_SEC / (double)METER->gate, (double)record->extra / 1000.0,
+            (double)record->value / 100.0);
+}
+
+void format_watched(FILE *stream, const struct log_record *record) {
+    fprintf(stream, "W [%3d] %s at %lld ns\n", record->line_id, record->value ? "rising" : "falling",
+            (long long)record->extra);
+}
+
+/**
+ * Log a change of state of the issuer. When the frequency is measured, the per-cycle messages are not logged.
+ */
+
+void log_set(struct log_buffer *log, long cycle, int line_id, int value, int64_t lateness) {
+    if (NULL == METER) {
+        log_write(log, &format_set, cycle, line_id, value, lateness);
+    }
 }
 
 // ---------------------------------------------------------------------------------
@@ -82,91 +152,127 @@ struct issuer_args {
     long count;
     /** The (GPIO) line ID that controls the state of the LED. */
     int line_id;
+    /** The busy-wait margin of the precision timing mode (0: sleep only). See `timing_calibrate()`. */
+    int64_t spin_margin;
+    /** With gpio-sim: the `pull` attribute of the receiver line, written instead of the issuer's line (or NULL). */
+    const char *sim_pull_path;
 };
 
 struct issuer_thread_resource {
-    struct gpiod_line  *issuer;
+    struct gpio_output *issuer;
+    /** The `pull` attribute of the simulated receiver line (-1: real wiring). */
+    int                sim_fd;
+    /** The log buffer of the thread that runs the issuer. */
+    struct log_buffer  *log;
+    int                line_id;
 };
 
 void issuer_thread_init(struct issuer_thread_resource *resource) {
     resource->issuer = NULL;
+    resource->line_id = -1;
+    resource->sim_fd = -1;
+    resource->log = NULL;
 }
 
 void issuer_thread_terminate(struct issuer_thread_resource *resource) {
     if (NULL != resource->issuer) {
-        gpiod_line_release(resource->issuer);
+        gpio_output_release(resource->issuer);
+    }
+    if (-1 != resource->sim_fd) {
+        close(resource->sim_fd);
     }
 }
 
-void* issuer_thread(void *in_args) {
-    struct issuer_thread_resource resource;
-    struct issuer_args *args = (struct issuer_args*)in_args;
-    struct gpiod_line  *issuer;
-    struct timespec duration = { args->duration_sec, args->duration_nano_sec };
-    struct timespec remaining;
-    struct timespec remaining_again;
-    struct timespec *d, *r;
+/**
+ * Open the issuer's line, as output.
+ * On error, the resource is released and the program terminates.
+ * @param resource The resource that receives the line.
+ * @param args The issuer's parameters.
+ */
 
-    issuer_thread_init(&resource);
+void issuer_open(struct issuer_thread_resource *resource, struct issuer_args *args) {
+    unsigned int offset = (unsigned int)args->line_id;
+    int initial_value = 0;
 
-    // Open GPIO line. Set the line's mode to output.
-    resource.issuer = gpiod_chip_get_line(CHIP, args->line_id);
-    if (NULL == resource.issuer) {
-        issuer_thread_terminate(&resource);
-        error("issuer: cannot get the line");
+    // Open issuer's line for output
+    resource->line_id = args->line_id;
+    resource->issuer = gpio_output_request(CHIP, "issuer", &offset, 1, &initial_value);
+    if (NULL == resource->issuer) {
+        issuer_thread_terminate(resource);
+        error("issuer: cannot set the line's mode to output");
+    }
 
+    // gpio-sim does not connect the lines: the issuer drives the receiver line directly.
+    if (NULL != args->sim_pull_path && -1 == (resource->sim_fd = gpio_sim_open(args->sim_pull_path))) {
+        issuer_thread_terminate(resource);
+        error("issuer: cannot open the gpio-sim pull attribute");
     }
+}
 
-    // Open issuer's line for output
-    if (-1 == gpiod_line_request_output(resource.issuer, "issuer", 0)) {
-        issuer_thread_terminate(&resource);
-        error("issuer: cannot set the line's mode to output");
+/**
+ * Change the value of the issuer's line (or of the simulated receiver line, with gpio-sim).
+ * @param resource The issuer's resource.
+ * @param cycle The cycle of the change of state.
+ * @param value The value.
+ * @return 0, or -1 on error.
+ */
+
+int issuer_set(struct issuer_thread_resource *resource, long cycle, int value) {
+    int status;
+
+    latency_probe_issue(PROBE, cycle);
+    if (-1 != resource->sim_fd) {
+        status = gpio_sim_set(resource->sim_fd, value);
+    } else {
+        status = gpio_output_set_value(resource->issuer, 0, value);
+    }
+    if (0 == status) {
+        status = journal_append(ISSUER_JOURNAL, timing_now(), (unsigned int)resource->line_id, JOURNAL_TRANSITION,
+                                value);
     }
+    return status;
+}
+
+void* issuer_thread(void *in_args) {
+    struct issuer_thread_resource resource;
+    struct issuer_args *args = (struct issuer_args*)in_args;
+    struct deadline schedule;
+    struct rt_thread_state rt_state;
+    struct line_stats *stats = stats_register("issuer", args->line_id);
+    int64_t lateness = 0;
 
+    issuer_thread_init(&resource);
+    issuer_open(&resource, args);
+    resource.log = logger_register();
+    rt_thread_enter(&PROFILE, &rt_state);
+
+    deadline_init(&schedule, timing_now(), args->duration_sec, args->duration_nano_sec);
+    schedule.spin_margin = args->spin_margin;
     for (long cycle=0; cycle<args->count; cycle++) {
         int value = (cycle & 0x1) != 0;
-        int done;
 
-        d = &duration;
-        r = &remaining;
-        printf("I [%4ld] Set %s\n", cycle, value ? "up" : "down");
-        if (-1 == gpiod_line_set_value(resource.issuer, value)) {
+        log_set(resource.log, cycle, args->line_id, value, lateness);
+        if (-1 == issuer_set(&resource, cycle, value)) {
             issuer_thread_terminate(&resource);
             error("issuer: cannot change the value of the output");
         }
+        stats_record(stats, schedule.epoch + cycle * schedule.period, timing_now());
 
-        do {
-            done = 1;
-            if (-1 == nanosleep(d, r)) {
-                switch (errno) {
-                    case EINTR: {
-                        d = r;
-                        r = &remaining_again;
-                        done = 0;
-                    }; break;
-                    case EFAULT: {
-                        issuer_thread_terminate(&resource);
-                        error("issuer: problem with copying information from user space");
-                    }
-                    case EINVAL: {
-                        issuer_thread_terminate(&resource);
-                        error("issuer: unexpected period duration");
-                    }
-                    default: {
-                        issuer_thread_terminate(&resource);
-                        error("issuer: unexpected errno value");
-                    }
-                }
-            }
-        } while(! done);
+        if (-1 == deadline_wait(&schedule, &lateness)) {
+            issuer_thread_terminate(&resource);
+            error("issuer: cannot wait for the next deadline");
+        }
     }
+    deadline_print(stdout, "issuer", &schedule);
+    rt_thread_report(stdout, "issuer", &rt_state);
+    gpio_output_counters_print(stdout, "issuer", gpio_output_get_counters(resource.issuer));
 
     issuer_thread_terminate(&resource);
     return NULL;
 }
 
 // ---------------------------------------------------------------------------------
-// ISSUER
+// RECEIVER
 // ---------------------------------------------------------------------------------
 
 struct receiver_args {
@@ -176,124 +282,856 @@ struct receiver_args {
     int  receiver_line_id;
     /** The (GPIO) line ID used to control the LED. */
     int  controller_line_id;
+    /** Other input lines whose edges are printed. They are monitored along with the receiver line. */
+    unsigned int watched_line_ids[MAX_WATCHED_LINES];
+    int  watched_count;
 };
 
 struct receiver_thread_resource {
-    struct gpiod_line  *receiver;
-    struct gpiod_line  *controller;
+    /** The receiver line, the watched lines and the inputs of the rules. */
+    struct monitor     monitor;
+    /** The controller line, or the outputs of the rules. */
+    struct gpio_output *controller;
+    /** The current value of the controller line. */
+    int                state;
+    /** The number of edges of the receiver line in the current batch (including the edges lost by the kernel). */
+    int                edges;
+    /** The sequence number of the last edge of the receiver line (0: unknown). Used by the dispatching thread only. */
+    uint32_t           last_seqno;
+    /** Tell whether the event buffer is enlarged after the observed bursts (see `monitor_adapt()`). */
+    int                adaptive;
+    /** The kernel timestamp of the last edge of the receiver line. */
+    int64_t            last_edge;
+    /** With rules: the end of the next pulse (0: no pulse in progress). */
+    int64_t            next_pulse;
+    /** The log buffer of the thread that reacts to the edges. */
+    struct log_buffer  *log;
 };
 
 void receiver_thread_init(struct receiver_thread_resource *resource) {
-    resource->receiver = NULL;
+    if (-1 == monitor_init(&resource->monitor, MAX_MONITORED_LINES)) {
+        error("receiver: cannot create the monitor");
+    }
     resource->controller = NULL;
+    resource->state = 0;
+    resource->edges = 0;
+    resource->last_seqno = 0;
+    // With libgpiod v1, the kernel queue is fixed: requesting the lines again would only lose edges.
+    resource->adaptive = gpio_input_resizable();
+    resource->last_edge = 0;
+    resource->next_pulse = 0;
+    resource->log = NULL;
 }
 
 void receiver_thread_terminate(struct receiver_thread_resource *resource) {
-    if (NULL != resource->receiver) {
-        gpiod_line_release(resource->receiver);
-    }
+    monitor_terminate(&resource->monitor);
     if (NULL != resource->controller) {
-        gpiod_line_release(resource->controller);
+        // With rules, a pulse in progress must not be left high: the outputs go back to their initial value.
+        if (NULL != RULES) {
+            rules_idle(RULES);
+            if (-1 == rules_commit(RULES)) {
+                fprintf(stderr, "rules: cannot reset the outputs\n");
+            }
+        }
+        gpio_output_release(resource->controller);
     }
 }
 
-void* receiver_thread(void *in_args) {
-    struct receiver_thread_resource resource;
-    struct receiver_args *args = (struct receiver_args*)in_args;
-    struct gpiod_line_event event;
-    int state;
+/**
+ * Count an edge of the receiver line. The reaction takes place once the whole batch has been dispatched.
+ * @param context Pointer to `struct receiver_thread_resource`.
+ * @param event The edge.
+ */
 
-    receiver_thread_init(&resource);
+void receiver_on_edge(void *context, const struct gpio_event *event) {
+    struct receiver_thread_resource *resource = (struct receiver_thread_resource*)context;
+
+    latency_probe_receive(PROBE, event);
+    if (NULL != RULES) {
+        rules_apply(RULES, event);
+    }
+    if (frequency_meter_update(METER, event)) {
+        log_write(resource->log, &format_frequency, METER->last_gate_rising, (int)event->offset,
+                  (int)(METER->duty_cycle * 10000.0), (int64_t)(METER->reciprocal_frequency * 1000.0));
+    }
+    // With sequence numbers, the edges lost by the kernel are counted too: the controller line stays in phase. The
+    // sequence numbers start again when the lines are requested again (see `monitor_adapt()`): a number that does not
+    // increase is the first edge of the new request, not a gap.
+    if (0 != event->line_seqno && 0 != resource->last_seqno && event->line_seqno > resource->last_seqno
+        && event->line_seqno - resource->last_seqno > 1) {
+        resource->edges += (int)(event->line_seqno - resource->last_seqno);
+    } else {
+        resource->edges++;
+    }
+    resource->last_seqno = event->line_seqno;
+    resource->last_edge = event->timestamp;
+}
+
+/**
+ * Log an edge of a watched line.
+ * @param context Pointer to `struct receiver_thread_resource`.
+ * @param event The edge.
+ */
+
+void watched_on_edge(void *context, const struct gpio_event *event) {
+    struct receiver_thread_resource *resource = (struct receiver_thread_resource*)context;
+
+    log_write(resource->log, &format_watched, 0, (int)event->offset, event->rising, event->timestamp);
+}
+
+/**
+ * Apply the rules of an input line (other than the receiver line).
+ * @param context Pointer to `struct receiver_thread_resource`.
+ * @param event The edge.
+ */
+
+void rules_on_edge(void *context, const struct gpio_event *event) {
+    (void)context;
+    rules_apply(RULES, event);
+}
+
+/**
+ * Write the outputs of the rules. This function is the backend of the rule engine: all the outputs are requested
+ * at once, and written with a single ioctl.
+ * @param context Pointer to `struct receiver_thread_resource`.
+ * @param count Unused.
+ * @param line_ids Unused.
+ * @param values Unused: the values of all the outputs are taken from the engine.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1.
+ */
+
+int rules_set_values(void *context, int count, const int *line_ids, const int *values) {
+    struct receiver_thread_resource *resource = (struct receiver_thread_resource*)context;
+
+    (void)count;
+    (void)line_ids;
+    (void)values;
+    return gpio_output_set_values(resource->controller, RULES->values);
+}
+
+int rules_set_value(void *context, int line_id, int value) {
+    return rules_set_values(context, 1, &line_id, &value);
+}
+
+/**
+ * Request the outputs of the rules, and monitor their inputs.
+ * On error, the resource is released and the program terminates.
+ * @param resource The resource that receives the lines.
+ * @param args The receiver's parameters.
+ */
+
+void receiver_open_rules(struct receiver_thread_resource *resource, struct receiver_args *args) {
+    struct output_backend backend;
 
-    // Open GPIO lines.
-    resource.receiver = gpiod_chip_get_line(CHIP, args->receiver_line_id);
-    if (NULL == resource.receiver) {
-        receiver_thread_terminate(&resource);
-        error("receiver: cannot get the line used to receive messages from the issuer");
+    resource->controller = gpio_output_request(CHIP, "rules", RULES->output_ids, RULES->output_count, RULES->values);
+    if (NULL == resource->controller) {
+        receiver_thread_terminate(resource);
+        error("receiver: cannot request the outputs of the rules");
     }
-    resource.controller = gpiod_chip_get_line(CHIP, args->controller_line_id);
-    if (NULL == resource.receiver) {
-        receiver_thread_terminate(&resource);
-        error("receiver: cannot get the line used to control the LED");
+    backend.context    = resource;
+    backend.set_value  = &rules_set_value;
+    backend.set_values = &rules_set_values;
+    rules_attach(RULES, &backend);
+
+    // The edges of the receiver line go through `receiver_on_edge()`.
+    for (unsigned int offset=0; offset<RULES->table_size; offset++) {
+        if (0 != RULES->table[offset].count && offset != (unsigned int)args->receiver_line_id
+            && -1 == monitor_add(&resource->monitor, offset, &rules_on_edge, resource)) {
+            receiver_thread_terminate(resource);
+            error("receiver: cannot monitor the input of a rule");
+        }
     }
+}
 
-    if (-1 == gpiod_line_request_output(resource.controller, "controller", 0)) {
-        receiver_thread_terminate(&resource);
-        error("receiver: cannot set the line's mode to input");
+/**
+ * Open the receiver's lines: the receiver line and the watched lines for edge events, and the controller line
+ * as output (or the inputs and the outputs of the rules). All the input lines are requested at once and share a single file descriptor.
+ * On error, the resource is released and the program terminates.
+ * @param resource The resource that receives the lines.
+ * @param args The receiver's parameters.
+ */
+
+void receiver_open(struct receiver_thread_resource *resource, struct receiver_args *args) {
+    unsigned int controller_offset = (unsigned int)args->controller_line_id;
+    int initial_value = 0;
+
+    if (NULL != RULES) {
+        receiver_open_rules(resource, args);
+    } else {
+        resource->controller = gpio_output_request(CHIP, "controller", &controller_offset, 1, &initial_value);
+        if (NULL == resource->controller) {
+            receiver_thread_terminate(resource);
+            error("receiver: cannot set the line's mode to output");
+        }
     }
 
-    if (-1 == gpiod_line_request_both_edges_events(resource.receiver, "receiver")) {
-        receiver_thread_terminate(&resource);
+    if (-1 == monitor_add(&resource->monitor, (unsigned int)args->receiver_line_id, &receiver_on_edge, resource)) {
+        receiver_thread_terminate(resource);
+        error("receiver: cannot monitor the line");
+    }
+    for (int i=0; i<args->watched_count; i++) {
+        if (-1 == monitor_add(&resource->monitor, args->watched_line_ids[i], &watched_on_edge, resource)) {
+            receiver_thread_terminate(resource);
+            error("receiver: cannot monitor a watched line");
+        }
+    }
+    if (-1 == monitor_start(&resource->monitor, CHIP, "receiver", RECEIVER_BATCH_SIZE)) {
+        receiver_thread_terminate(resource);
         error("receiver: cannot set the line's callbacks");
     }
+}
 
-    for (long cycle=0; cycle<args->count; cycle++) {
+/**
+ * React to the edges of the receiver line in the batch that has just been dispatched (toggle the controller line
+ * once per edge). The controller line is written once, with its final value.
+ * With rules, the outputs changed by the batch and by the pulses that are over are written at once instead.
+ * On error, the resource is released and the program terminates.
+ * @param resource The receiver's resource.
+ * @return The number of edges of the receiver line.
+ */
+
+int receiver_react(struct receiver_thread_resource *resource) {
+    int count = resource->edges;
+
+    resource->edges = 0;
+    if (NULL != RULES) {
+        resource->next_pulse = rules_expire(RULES, timing_now());
+        if (-1 == rules_commit(RULES)) {
+            receiver_thread_terminate(resource);
+            error("rules: cannot change the values of the outputs");
+        }
+        if (count > 0) {
+            latency_probe_react(PROBE, resource->last_edge);
+        }
+    }
+    if (0 == count) {
+        return 0;
+    }
+    // When the frequency is measured, the results are logged once per gate instead.
+    if (NULL == METER) {
+        log_write(resource->log, &format_edges, 0, GPIO_21, 0, count);
+    }
+    if (NULL == RULES && (count & 0x1)) {
+        resource->state = !resource->state;
+        if (-1 == gpio_output_set_value(resource->controller, 0, resource->state)) {
+            receiver_thread_terminate(resource);
+            error("contoller: cannot change the value of the output");
+        }
+        latency_probe_react(PROBE, resource->last_edge);
+    }
+    return count;
+}
+
+/**
+ * Read all pending events from the input lines (in the monitor's buffer). Unless the file descriptor of the lines
+ * is watched by a reactor, the buffer is enlarged after the observed bursts.
+ * On error, the resource is released and the program terminates.
+ * @param resource The receiver's resource.
+ * @return The number of events read.
+ */
+
+int receiver_capture(struct receiver_thread_resource *resource) {
+    int count = monitor_read(&resource->monitor);
+
+    if (-1 == count) {
+        receiver_thread_terminate(resource);
+        error("receiver: error while reading the event");
+    }
+    for (int i=0; i<count; i++) {
+        const struct gpio_event *event = &resource->monitor.events[i];
+
+        if (-1 == journal_append(RECEIVER_JOURNAL, event->timestamp, event->offset, JOURNAL_EDGE, event->rising)) {
+            receiver_thread_terminate(resource);
+            error("receiver: cannot write the journal");
+        }
+    }
+    // The sequence numbers are left to the thread that dispatches the events (see `receiver_on_edge()`).
+    if (resource->adaptive && count > 0 && -1 == monitor_adapt(&resource->monitor)) {
+        receiver_thread_terminate(resource);
+        error("receiver: cannot enlarge the event buffer");
+    }
+    return count;
+}
+
+/**
+ * Read all pending events from the input lines, dispatch them and react to the edges of the receiver line.
+ * @param resource The receiver's resource.
+ * @return The number of edges of the receiver line.
+ */
+
+int receiver_process(struct receiver_thread_resource *resource) {
+    int count = receiver_capture(resource);
+
+    monitor_dispatch(&resource->monitor, resource->monitor.events, count);
+    return receiver_react(resource);
+}
 
-        // Wait for an event.
-        if (-1 == gpiod_line_event_wait(resource.receiver, NULL)) {
+void* receiver_thread(void *in_args) {
+    struct receiver_thread_resource resource;
+    struct receiver_args *args = (struct receiver_args*)in_args;
+    struct rt_thread_state rt_state;
+
+    receiver_thread_init(&resource);
+    receiver_open(&resource, args);
+    resource.log = logger_register();
+    rt_thread_enter(&PROFILE, &rt_state);
+
+    for (long cycle=0; cycle<args->count; ) {
+        // Wait for an event (with rules, until the end of the next pulse at most).
+        int64_t timeout = 0 != resource.next_pulse ? resource.next_pulse - timing_now() : -1;
+        int status = monitor_wait(&resource.monitor, 0 != resource.next_pulse && timeout < 0 ? 0 : timeout);
+
+        if (-1 == status) {
             receiver_thread_terminate(&resource);
             error("receiver: error while waiting for an event");
         }
 
-        if (-1 == gpiod_line_event_read(resource.receiver, &event)) {
-            receiver_thread_terminate(&resource);
-            error("receiver: error while reading the event");
+        cycle += 1 == status ? receiver_process(&resource) : receiver_react(&resource);
+    }
+    event_counters_print(stdout, "receiver", &resource.monitor.counters);
+    rt_thread_report(stdout, "receiver", &rt_state);
+    if (NULL != resource.controller) {
+        gpio_output_counters_print(stdout, "controller", gpio_output_get_counters(resource.controller));
+    }
+
+    receiver_thread_terminate(&resource);
+    return NULL;
+}
+
+// ---------------------------------------------------------------------------------
+// REACTOR
+// ---------------------------------------------------------------------------------
+
+// In this mode, the issuer and the receiver are handled by a single thread. The issuer's deadlines are served by a
+// timerfd and the receiver's edges are read from the line's event file descriptor, both multiplexed by epoll.
+
+struct reactor_issuer {
+    struct issuer_thread_resource resource;
+    struct issuer_args *args;
+    struct line_stats  *stats;
+    int64_t epoch;
+    int64_t period;
+    long    cycle;
+};
+
+struct reactor_receiver {
+    struct receiver_thread_resource resource;
+    struct receiver_args *args;
+    long    cycle;
+};
+
+/**
+ * Change the value of the issuer's line. This function is called by the reactor when a deadline is reached.
+ * @param context Pointer to `struct reactor_issuer`.
+ * @param expirations The number of deadlines reached since the previous call.
+ * @return 0 to continue, or `REACTOR_DONE` when all changes of state have been performed.
+ */
+
+int issuer_on_timer(void *context, uint64_t expirations) {
+    struct reactor_issuer *issuer = (struct reactor_issuer*)context;
+    int64_t deadline;
+    int value;
+
+    issuer->cycle += (long)expirations;
+    if (issuer->cycle >= issuer->args->count) {
+        return REACTOR_DONE;
+    }
+    deadline = issuer->epoch + issuer->cycle * issuer->period;
+    value = (issuer->cycle & 0x1) != 0;
+
+    log_set(issuer->resource.log, issuer->cycle, issuer->args->line_id, value,
+            timing_now() - deadline);
+    if (-1 == issuer_set(&issuer->resource, issuer->cycle, value)) {
+        return -1;
+    }
+    stats_record(issuer->stats, deadline, timing_now());
+    return 0;
+}
+
+/**
+ * React to an event on the receiver's line. This function is called by the reactor when the line's event
+ * file descriptor is readable.
+ * @param context Pointer to `struct reactor_receiver`.
+ * @param expirations Unused.
+ * @return 0 to continue, or `REACTOR_DONE` when the expected number of events has been received.
+ */
+
+int receiver_on_event(void *context, uint64_t expirations) {
+    struct reactor_receiver *receiver = (struct reactor_receiver*)context;
+
+    (void)expirations;
+    receiver->cycle += receiver_process(&receiver->resource);
+    return receiver->cycle >= receiver->args->count ? REACTOR_DONE : 0;
+}
+
+void run_reactor(struct issuer_args *issuer_arg, struct receiver_args *receiver_arg) {
+    struct reactor reactor;
+    struct reactor_issuer issuer;
+    struct reactor_receiver receiver;
+    struct rt_thread_state rt_state;
+
+    issuer_thread_init(&issuer.resource);
+    receiver_thread_init(&receiver.resource);
+    issuer_open(&issuer.resource, issuer_arg);
+    receiver_open(&receiver.resource, receiver_arg);
+    // The reactor watches the file descriptor of the lines: they cannot be requested again.
+    receiver.resource.adaptive = 0;
+
+    issuer.args     = issuer_arg;
+    issuer.stats    = stats_register("issuer", issuer_arg->line_id);
+    issuer.epoch    = timing_now();
+    issuer.period   = (int64_t)issuer_arg->duration_sec * NSEC_PER_SEC + issuer_arg->duration_nano_sec;
+    issuer.cycle    = 0;
+    receiver.args   = receiver_arg;
+    receiver.cycle  = 0;
+
+    // The issuer and the receiver run in the same thread.
+    issuer.resource.log   = logger_register();
+    receiver.resource.log = issuer.resource.log;
+
+    if (-1 == reactor_init(&reactor, NUMBER_OF_THREAD)) {
+        error("cannot create the reactor");
+    }
+
+    // Cycle 0 starts now, the timer handles the following ones.
+    log_set(issuer.resource.log, 0, issuer_arg->line_id, 0, 0);
+    if (-1 == issuer_set(&issuer.resource, 0, 0)) {
+        error("issuer: cannot change the value of the output");
+    }
+    stats_record(issuer.stats, issuer.epoch, timing_now());
+    if (issuer_arg->count > 0
+        && -1 == reactor_add_timer(&reactor, issuer.epoch, issuer.period, &issuer_on_timer, &issuer)) {
+        error("issuer: cannot create the timer");
+    }
+    if (receiver_arg->count > 0
+        && -1 == reactor_add_fd(&reactor, monitor_fd(&receiver.resource.monitor),
+                                &receiver_on_event, &receiver)) {
+        error("receiver: cannot watch the line's events");
+    }
+
+    rt_thread_enter(&PROFILE, &rt_state);
+    if (-1 == reactor_run(&reactor)) {
+        error("error while running the reactor");
+    }
+    printf("reactor: %ld wakeups\n", reactor.wakeups);
+    event_counters_print(stdout, "receiver", &receiver.resource.monitor.counters);
+    rt_thread_report(stdout, "reactor", &rt_state);
+    gpio_output_counters_print(stdout, "issuer", gpio_output_get_counters(issuer.resource.issuer));
+    if (NULL != receiver.resource.controller) {
+        gpio_output_counters_print(stdout, "controller", gpio_output_get_counters(receiver.resource.controller));
+    }
+
+    reactor_terminate(&reactor);
+    issuer_thread_terminate(&issuer.resource);
+    receiver_thread_terminate(&receiver.resource);
+}
+
+// ---------------------------------------------------------------------------------
+// RING
+// ---------------------------------------------------------------------------------
+
+// In this mode, the receiver is split into two threads. The capture thread only reads the edges and pushes them
+// into a lock-free ring, so that it is back to the kernel queue as soon as possible. The processing thread pops the
+// edges and reacts to them (log, controller line): a slow reaction no longer delays the reads.
+
+struct ring_receiver {
+    struct receiver_thread_resource resource;
+    struct receiver_args *args;
+    struct event_ring    ring;
+};
+
+void* capture_thread(void *in_args) {
+    struct ring_receiver *receiver = (struct ring_receiver*)in_args;
+    struct receiver_thread_resource *resource = &receiver->resource;
+    struct rt_thread_state rt_state;
+
+    rt_thread_enter(&PROFILE, &rt_state);
+    for (long cycle=0; cycle<receiver->args->count; ) {
+        int count;
+
+        if (-1 == monitor_wait(&resource->monitor, -1)) {
+            error("capture: error while waiting for an event");
         }
+        count = receiver_capture(resource);
+        event_ring_push(&receiver->ring, resource->monitor.events, count);
+        for (int i=0; i<count; i++) {
+            cycle += resource->monitor.events[i].offset == (unsigned int)receiver->args->receiver_line_id;
+        }
+    }
+    event_ring_close(&receiver->ring);
+    event_counters_print(stdout, "capture", &resource->monitor.counters);
+    printf("capture: %ld events dropped (ring full)\n", __atomic_load_n(&receiver->ring.overflows, __ATOMIC_RELAXED));
+    rt_thread_report(stdout, "capture", &rt_state);
+    return NULL;
+}
+
+void* processing_thread(void *in_args) {
+    struct ring_receiver *receiver = (struct ring_receiver*)in_args;
+    struct gpio_event events[RECEIVER_BATCH_SIZE];
+    int status;
 
-        printf("Get an event!\n");
-        state = !state;
-        if (-1 == gpiod_line_set_value(resource.controller, state)) {
+    receiver->resource.log = logger_register();
+    while (1 == (status = event_ring_wait(&receiver->ring))) {
+        int count = event_ring_pop(&receiver->ring, events, RECEIVER_BATCH_SIZE);
+
+        monitor_dispatch(&receiver->resource.monitor, events, count);
+        receiver_react(&receiver->resource);
+    }
+    if (-1 == status) {
+        error("processing: error while waiting for an event");
+    }
+    if (NULL != receiver->resource.controller) {
+        gpio_output_counters_print(stdout, "controller", gpio_output_get_counters(receiver->resource.controller));
+    }
+    return NULL;
+}
+
+void run_ring(struct issuer_args *issuer_arg, struct receiver_args *receiver_arg) {
+    struct ring_receiver receiver;
+    pthread_t            all_threads[3];
+
+    receiver_thread_init(&receiver.resource);
+    receiver_open(&receiver.resource, receiver_arg);
+    receiver.args = receiver_arg;
+    if (-1 == event_ring_init(&receiver.ring, RING_CAPACITY)) {
+        receiver_thread_terminate(&receiver.resource);
+        error("cannot create the ring");
+    }
+
+    if (0 != pthread_create(&all_threads[0], NULL, &processing_thread, (void*)&receiver)) {
+        error("cannot create the thread for the processing");
+    }
+    if (0 != pthread_create(&all_threads[1], NULL, &capture_thread, (void*)&receiver)) {
+        error("cannot create the thread for the capture");
+    }
+    if (0 != pthread_create(&all_threads[2], NULL, &issuer_thread, (void*)issuer_arg)) {
+        error("cannot create the thread for the issuer");
+    }
+    for (int i=0; i<3; i++) {
+        pthread_join(all_threads[i], NULL);
+    }
+
+    event_ring_terminate(&receiver.ring);
+    receiver_thread_terminate(&receiver.resource);
+}
+
+// ---------------------------------------------------------------------------------
+// POLL
+// ---------------------------------------------------------------------------------
+
+// In this mode, the receiver never blocks: it runs on a dedicated CPU and polls the line's event file descriptor
+// without waiting, so that an edge is handled without the wakeup of a sleeping thread (interrupt, scheduler, context
+// switch). The price is a whole CPU, kept busy even when no edge arrives.
+
+void* poll_receiver_thread(void *in_args) {
+    struct receiver_thread_resource resource;
+    struct receiver_args *args = (struct receiver_args*)in_args;
+    struct rt_thread_state rt_state;
+    long polls = 0;
+
+    receiver_thread_init(&resource);
+    receiver_open(&resource, args);
+    resource.log = logger_register();
+    rt_thread_enter(&POLL_PROFILE, &rt_state);
+
+    for (long cycle=0; cycle<args->count; polls++) {
+        int status = monitor_wait(&resource.monitor, 0);
+
+        if (-1 == status) {
             receiver_thread_terminate(&resource);
-            error("contoller: cannot change the value of the output");
+            error("receiver: error while polling the events");
+        }
+        if (1 == status) {
+            cycle += receiver_process(&resource);
+        } else if (0 != resource.next_pulse && timing_now() >= resource.next_pulse) {
+            receiver_react(&resource);
         }
     }
+    printf("receiver: %ld polls on CPU %d\n", polls, POLL_PROFILE.cpu);
+    event_counters_print(stdout, "receiver", &resource.monitor.counters);
+    rt_thread_report(stdout, "receiver", &rt_state);
+    if (NULL != resource.controller) {
+        gpio_output_counters_print(stdout, "controller", gpio_output_get_counters(resource.controller));
+    }
 
     receiver_thread_terminate(&resource);
     return NULL;
 }
 
+void run_poll(struct issuer_args *issuer_arg, struct receiver_args *receiver_arg) {
+    pthread_t all_threads[NUMBER_OF_THREAD];
 
+    // The receiver is ready before the first edge.
+    if (0 != pthread_create(&all_threads[0], NULL, &poll_receiver_thread, (void*)receiver_arg)) {
+        error("cannot create the thread for the receiver");
+    }
+    if (0 != pthread_create(&all_threads[1], NULL, &issuer_thread, (void*)issuer_arg)) {
+        error("cannot create the thread for the issuer");
+    }
+    for (int i=0; i<NUMBER_OF_THREAD; i++) {
+        pthread_join(all_threads[i], NULL);
+    }
+}
 
+// ---------------------------------------------------------------------------------
+// THREADS
+// ---------------------------------------------------------------------------------
+
+void run_threads(struct issuer_args *issuer_arg, struct receiver_args *receiver_arg) {
+    pthread_t          all_threads[NUMBER_OF_THREAD];
+    int                all_threads_index = 0;
+
+    // Start the issuer.
+    if (0 != pthread_create(&all_threads[all_threads_index++], NULL,
+                            &issuer_thread, (void*)issuer_arg)) {
+        error("cannot create the thread for the issuer");
+    }
+
+    // Start the receiver.
+    if (0 != pthread_create(&all_threads[all_threads_index++], NULL,
+                            &receiver_thread, (void*)receiver_arg)) {
+        error("cannot create the thread for the receiver");
+    }
+
+    // Wait for all threads.
+    for (int i=0; i<all_threads_index; i++) {
+        pthread_join(all_threads[i], NULL);
+    }
+}
+
+/**
+ * Print the usage and terminate the program.
+ * @param program The name of the program.
+ */
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-m threads|reactor|ring|poll] [-c chip] [-t period] [-n count] [-s] [-P policy[:priority]] "
+                    "[-C cpu|auto] [-R cpu|auto] [-L] [-w line]... [-l] [-S pull] [-O off|sync|async] [-J path] [-f gate] [-r rules]\n", program);
+    fprintf(stderr, "  -m threads: one thread for the issuer, one thread for the receiver (default).\n");
+    fprintf(stderr, "  -m reactor: the issuer and the receiver share a single epoll loop.\n");
+    fprintf(stderr, "  -m ring:    the receiver's capture and processing run in two threads, linked by a ring.\n");
+    fprintf(stderr, "  -m poll:    the receiver busy-polls its events on a dedicated CPU (lowest reflex latency).\n");
+    fprintf(stderr, "  -c chip:    the GPIO chip (default: %s, %s).\n", CHIP_NAME, gpio_backend_name());
+    fprintf(stderr, "  -t period:  the issuer's period, in nano seconds (default: 1 second).\n");
+    fprintf(stderr, "  -n count:   the issuer's number of changes of state (default: 5).\n");
+    fprintf(stderr, "  -s:         precision timing (sleep, then spin) for the issuer (not in reactor mode).\n");
+    fprintf(stderr, "  -P policy:  scheduling policy of the threads: fifo, rr or other (ex: fifo:80).\n");
+    fprintf(stderr, "  -C cpu:     pin the threads to a CPU (\"auto\": the first isolated CPU).\n");
+    fprintf(stderr, "  -R cpu:     poll mode: the CPU of the receiver (default: auto, the first isolated CPU).\n");
+    fprintf(stderr, "  -L:         lock the memory and prefault the stacks.\n");
+    fprintf(stderr, "  -w line:    print the edges of another input line (repeatable, up to %d lines).\n",
+            MAX_WATCHED_LINES);
+    fprintf(stderr, "  -l:         measure the loopback latency (GPIO16 -> GPIO21) and the reflex latency (-> GPIO17).\n");
+    fprintf(stderr, "  -S pull:    gpio-sim: the `pull` attribute of the receiver line, driven by the issuer.\n");
+    fprintf(stderr, "  -f gate:    measure the frequency and the duty cycle of GPIO21, with gates of <gate> ms.\n");
+    fprintf(stderr, "  -r rules:   react to the inputs with the rules of a file, instead of toggling GPIO17 (threads and\n"
+                    "              poll modes only).\n");
+    fprintf(stderr, "  -J path:    record the transitions and the edges in <path>-issuer and <path>-receiver.\n");
+    fprintf(stderr, "  -O log:     per-cycle messages: off, sync (printf) or async (default; off with -l).\n");
+    fprintf(stderr, "Send SIGUSR1 to print the timing statistics of the issuer.\n");
+    exit(1);
+}
 
-int main()
+int main(int argc, char *argv[])
 {
     struct issuer_args issuer_arg;
     struct receiver_args receiver_arg;
-    pthread_t          all_threads[NUMBER_OF_THREAD];
-    int                all_threads_index = 0;
+    const char         *mode = "threads";
+    const char         *chip_name = CHIP_NAME;
+    const char         *poll_cpu = "auto";
+    int                option;
+    int64_t            period = NSEC_PER_SEC;
+    long               count = 0;
+    int                precise = 0;
+    int                measure_latency = 0;
+    int                log_mode = -1;
+    const char         *journal_path = NULL;
+    struct journal     issuer_journal, receiver_journal;
+    struct latency_probe probe;
+    int64_t            gate = 0;
+    struct frequency_meter meter;
+    const char         *rules_path = NULL;
+    struct rule_engine rules;
+
+    rt_profile_init(&PROFILE);
+    receiver_arg.watched_count = 0;
+    issuer_arg.sim_pull_path   = NULL;
+    while (-1 != (option = getopt(argc, argv, "m:c:t:n:sP:C:R:Lw:lS:O:J:f:r:"))) {
+        switch (option) {
+            case 'P': {
+                if (-1 == rt_profile_parse_policy(&PROFILE, optarg)) {
+                    usage(argv[0]);
+                }
+            }; break;
+            case 'C': {
+                if (-1 == rt_profile_parse_cpu(&PROFILE, optarg)) {
+                    usage(argv[0]);
+                }
+            }; break;
+            case 'L': {
+                PROFILE.lock_memory    = 1;
+                PROFILE.prefault_stack = RT_PREFAULT_STACK_SIZE;
+            }; break;
+            case 'R': poll_cpu = optarg; break;
+            case 'm': mode = optarg; break;
+            case 'c': chip_name = optarg; break;
+            case 't': period = atoll(optarg); break;
+            case 'n': count = atol(optarg); break;
+            case 's': precise = 1; break;
+            case 'l': measure_latency = 1; break;
+            case 'J': journal_path = optarg; break;
+            case 'f': gate = atoll(optarg) * 1000000; break;
+            case 'r': rules_path = optarg; break;
+            case 'O': {
+                if (-1 == (log_mode = logger_parse_mode(optarg))) {
+                    usage(argv[0]);
+                }
+            }; break;
+            case 'S': issuer_arg.sim_pull_path = optarg; break;
+            case 'w': {
+                if (receiver_arg.watched_count >= MAX_WATCHED_LINES) {
+                    usage(argv[0]);
+                }
+                receiver_arg.watched_line_ids[receiver_arg.watched_count++] = (unsigned int)atoi(optarg);
+            }; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (period <= 0 || count < 0 || gate < 0) {
+        usage(argv[0]);
+    }
+    if (0 != strcmp(mode, "threads") && 0 != strcmp(mode, "reactor") && 0 != strcmp(mode, "ring")
+        && 0 != strcmp(mode, "poll")) {
+        usage(argv[0]);
+    }
+    if (NULL != rules_path && 0 != strcmp(mode, "threads") && 0 != strcmp(mode, "poll")) {
+        usage(argv[0]);
+    }
+    // The issuer of the reactor mode is driven by a timerfd: it never spins.
+    if (precise && 0 == strcmp(mode, "reactor")) {
+        fprintf(stderr, "-s is not supported in the reactor mode\n");
+        usage(argv[0]);
+    }
+    POLL_PROFILE = PROFILE;
+    if (-1 == rt_profile_parse_cpu(&POLL_PROFILE, poll_cpu)) {
+        usage(argv[0]);
+    }
+    // The busy-poll receiver never yields its CPU: the other threads must run elsewhere.
+    if (0 == strcmp(mode, "poll") && POLL_PROFILE.cpu == PROFILE.cpu) {
+        error("the receiver of the poll mode needs its own CPU (see -C and -R)");
+    }
+
+    rt_lock_memory(&PROFILE);
+
+    // Must be done before any other thread is created.
+    if (-1 == stats_start_signal_thread()) {
+        error("cannot start the statistics thread");
+    }
+
+    // By default, the per-cycle messages are not part of the latency measure.
+    if (-1 == log_mode) {
+        log_mode = measure_latency ? LOGGER_OFF : LOGGER_ASYNC;
+    }
+    if (-1 == logger_start(stdout, log_mode)) {
+        error("cannot start the logger");
+    }
 
     // Open GPIO chip
-    CHIP = gpiod_chip_open_by_name(CHIP_NAME);
+    CHIP = gpio_chip_open(chip_name);
     if (NULL == CHIP) {
         error("cannot open the chip");
     }
     atexit(reset_gpio);
 
-    issuer_arg.duration_sec      = 1;
-    issuer_arg.duration_nano_sec = 0;
-    issuer_arg.count             = 5;
+    issuer_arg.duration_sec      = (time_t)(period / NSEC_PER_SEC);
+    issuer_arg.duration_nano_sec = (long)(period % NSEC_PER_SEC);
+    issuer_arg.count             = count > 0 ? count : 5;
     issuer_arg.line_id           = GPIO_16;
+    issuer_arg.spin_margin       = 0;
 
-    receiver_arg.count              = 3;
-    receiver_arg.receiver_line_id   = GPIO_21;
-    receiver_arg.controller_line_id = GPIO_17;
+    // The margin of the precision timing mode is the overshoot of the sleeps observed on this system.
+    if (precise) {
+        issuer_arg.spin_margin = timing_calibrate(CALIBRATION_SAMPLES);
+        if (-1 == issuer_arg.spin_margin) {
+            error("cannot calibrate the precision timing mode");
+        }
+        printf("Precision timing: spin margin %lld ns\n", (long long)issuer_arg.spin_margin);
+    }
 
-    // Start the issuer.
-    if (0 != pthread_create(&all_threads[all_threads_index++], NULL,
-                            &issuer_thread, (void*)&issuer_arg)) {
-        error("cannot create the thread for the issuer");
+    if (NULL != journal_path) {
+        char path[JOURNAL_PATH_SIZE];
+
+        snprintf(path, sizeof(path), "%s-issuer", journal_path);
+        if (-1 == journal_open(&issuer_journal, path, 0, JOURNAL_SEGMENTS)) {
+            error("cannot create the journal of the issuer");
+        }
+        snprintf(path, sizeof(path), "%s-receiver", journal_path);
+        if (-1 == journal_open(&receiver_journal, path, 0, JOURNAL_SEGMENTS)) {
+            error("cannot create the journal of the receiver");
+        }
+        ISSUER_JOURNAL   = &issuer_journal;
+        RECEIVER_JOURNAL = &receiver_journal;
     }
 
-    // Start the receiver.
-    if (0 != pthread_create(&all_threads[all_threads_index++], NULL,
-                            &receiver_thread, (void*)&receiver_arg)) {
-        error("cannot create the thread for the receiver");
+    if (measure_latency) {
+        if (-1 == latency_probe_init(&probe, issuer_arg.count)) {
+            error("cannot create the latency probe");
+        }
+        PROBE = &probe;
     }
 
-    // Wait for all threads.
-    for (int i=0; i<all_threads_index; i++) {
-        pthread_join(all_threads[i], NULL);
+    if (gate > 0) {
+        frequency_meter_init(&meter, gate);
+        METER = &meter;
+    }
+
+    if (NULL != rules_path) {
+        char *text = read_text_file(rules_path, RULES_MAX_SIZE);
+
+        if (NULL == text) {
+            error("cannot read the rules (missing, or larger than 64 KB)");
+        }
+        rules_init(&rules);
+        if (-1 == rules_parse(&rules, text) || -1 == rules_compile(&rules)) {
+            error("invalid rules");
+        }
+        free(text);
+        RULES = &rules;
+    }
+
+    // The first change of state (down) does not produce any edge.
+    receiver_arg.count              = count > 0 ? count - 1 : 3;
+    receiver_arg.receiver_line_id   = GPIO_21;
+    receiver_arg.controller_line_id = GPIO_17;
+
+    if (0 == strcmp(mode, "reactor")) {
+        run_reactor(&issuer_arg, &receiver_arg);
+    } else if (0 == strcmp(mode, "ring")) {
+        run_ring(&issuer_arg, &receiver_arg);
+    } else if (0 == strcmp(mode, "poll")) {
+        run_poll(&issuer_arg, &receiver_arg);
+    } else {
+        run_threads(&issuer_arg, &receiver_arg);
+    }
+    logger_stop();
+    stats_dump(stdout);
+    latency_probe_print(stdout, PROBE);
+    latency_probe_terminate(PROBE);
+    if (NULL != METER) {
+        // The issuer toggles its line every period: the expected signal is a square wave of twice the period.
+        printf("frequency: expected %.3f Hz (period %lld ns), duty 50.00%%\n",
+               (double)NSEC_PER_SEC / (double)(2 * period), (long long)(2 * period));
+        frequency_meter_print(stdout, METER);
+    }
+    if (NULL != journal_path) {
+        journal_close(&issuer_journal);
+        journal_close(&receiver_journal);
+    }
+    if (NULL != RULES) {
+        printf("rules: %zu rules, %ld edges, %ld actions, %ld writes\n", RULES->size, RULES->events,
+               RULES->triggered, RULES->commits);
+        rules_terminate(RULES);
     }
 
     return 0;
-}
\ No newline at end of file
+}
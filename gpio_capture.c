@@ -0,0 +1,198 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "gpio.h"
+#include "capture.h"
+#include "monitor.h"
+#include "timing.h"
+
+// Capture the edges of a set of input lines, like a logic analyzer, into a VCD file or a sigrok session file.
+//
+//     $ ./gpio_capture -c gpiochip0 -l 16 -l 21 -T 16:rising -d 1000 -o /tmp/capture.vcd
+//     $ ./gpio_capture -c gpiochip0 -l 16 -l 21 -f sigrok -r 1000000 -o /tmp/capture.sr
+//
+// The capture runs until the post-trigger duration (or number of edges) is reached, or until SIGINT (Ctrl-C).
+
+#define EVENT_BUFFER_SIZE  256
+#define DEFAULT_PRETRIGGER 4096
+#define DEFAULT_SAMPLERATE 1000000
+/** The period at which the end of the capture is checked while no edge arrives. */
+#define POLL_PERIOD_NS     (100 * 1000 * 1000)
+
+static volatile sig_atomic_t STOP = 0;
+
+struct session {
+    struct capture capture;
+    /** 1 once the capture is complete. */
+    int            done;
+};
+
+/**
+ * Print an error message and terminate the program.
+ * @param message The message to print.
+ */
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+void on_signal(int signal) {
+    (void)signal;
+    STOP = 1;
+}
+
+void on_edge(void *context, const struct gpio_event *event) {
+    struct session *session = (struct session*)context;
+    int status;
+
+    if (session->done) {
+        return;
+    }
+    if (-1 == (status = capture_record(&session->capture, event))) {
+        error("cannot write the capture");
+    }
+    session->done = status;
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s -c chip -l line... -o output [-f vcd|sigrok] [-r samplerate] [-T line:condition]... "
+                    "[-p pretrigger] [-d duration] [-n count]\n", program);
+    fprintf(stderr, "  -l line:      a line to capture (repeatable, up to %d lines).\n", CAPTURE_MAX_LINES);
+    fprintf(stderr, "  -o output:    the output file.\n");
+    fprintf(stderr, "  -f format:    vcd (default) or sigrok (session file, for PulseView or sigrok-cli).\n");
+    fprintf(stderr, "  -r rate:      the sample rate of the sigrok format, in Hz (default: %d).\n", DEFAULT_SAMPLERATE);
+    fprintf(stderr, "  -T condition: trigger condition: <line>:rising, falling, edge, high or low (repeatable, all\n");
+    fprintf(stderr, "                the conditions must be met). Default: the first edge.\n");
+    fprintf(stderr, "  -p count:     the number of edges kept before the trigger (default: %d).\n", DEFAULT_PRETRIGGER);
+    fprintf(stderr, "  -d duration:  the duration of the capture after the trigger, in milli seconds.\n");
+    fprintf(stderr, "  -n count:     the number of edges captured after the trigger.\n");
+    fprintf(stderr, "Without -d and -n, the capture runs until SIGINT.\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    const char *chip_name = NULL;
+    const char *output = NULL;
+    const char *format = "vcd";
+    const char *conditions[CAPTURE_MAX_CONDITIONS];
+    int condition_count = 0;
+    unsigned int offsets[CAPTURE_MAX_LINES];
+    int levels[CAPTURE_MAX_LINES];
+    int line_count = 0;
+    long pretrigger = DEFAULT_PRETRIGGER;
+    int64_t samplerate = DEFAULT_SAMPLERATE;
+    int64_t post_duration = 0;
+    long post_events = 0;
+    struct gpio_chip *chip;
+    struct capture_writer writer;
+    struct session session;
+    struct monitor monitor;
+    struct sigaction action;
+    int option;
+
+    while (-1 != (option = getopt(argc, argv, "c:l:o:f:r:T:p:d:n:"))) {
+        switch (option) {
+            case 'c': chip_name = optarg; break;
+            case 'o': output = optarg; break;
+            case 'f': format = optarg; break;
+            case 'r': samplerate = atoll(optarg); break;
+            case 'p': pretrigger = atol(optarg); break;
+            case 'd': post_duration = atoll(optarg) * 1000000; break;
+            case 'n': post_events = atol(optarg); break;
+            case 'l': {
+                if (line_count == CAPTURE_MAX_LINES) {
+                    usage(argv[0]);
+                }
+                offsets[line_count++] = (unsigned int)atoi(optarg);
+            }; break;
+            case 'T': {
+                if (condition_count == CAPTURE_MAX_CONDITIONS) {
+                    usage(argv[0]);
+                }
+                conditions[condition_count++] = optarg;
+            }; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (NULL == chip_name || NULL == output || 0 == line_count || pretrigger < 1 || post_duration < 0
+        || post_events < 0) {
+        usage(argv[0]);
+    }
+
+    if (0 == strcmp(format, "vcd")) {
+        if (-1 == capture_vcd_open(&writer, output)) {
+            error("cannot create the output file");
+        }
+    } else if (0 == strcmp(format, "sigrok")) {
+        if (-1 == capture_sigrok_open(&writer, output, samplerate)) {
+            error("cannot create the output file");
+        }
+    } else {
+        usage(argv[0]);
+    }
+    if (-1 == capture_init(&session.capture, offsets, line_count, (size_t)pretrigger, &writer)) {
+        error("cannot create the capture");
+    }
+    for (int i=0; i<condition_count; i++) {
+        if (-1 == capture_parse_condition(&session.capture, conditions[i])) {
+            usage(argv[0]);
+        }
+    }
+    capture_set_limits(&session.capture, post_duration, post_events);
+    session.done = 0;
+
+    chip = gpio_chip_open(chip_name);
+    if (NULL == chip) {
+        error("cannot open the chip");
+    }
+    if (-1 == monitor_init(&monitor, line_count)) {
+        error("cannot create the monitor");
+    }
+    for (int i=0; i<line_count; i++) {
+        if (-1 == monitor_add(&monitor, offsets[i], &on_edge, &session)) {
+            error("cannot monitor the line (given twice?)");
+        }
+    }
+    if (-1 == monitor_start(&monitor, chip, "capture", EVENT_BUFFER_SIZE)) {
+        error("cannot request the lines");
+    }
+    // The lines are monitored in the order of the offsets: their levels are the initial values of the capture.
+    if (-1 == gpio_input_get_values(monitor.input, levels)) {
+        error("cannot read the values of the lines");
+    }
+    capture_set_levels(&session.capture, levels);
+
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = &on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    fprintf(stderr, "Capturing %d line(s), %s...\n", line_count,
+            0 == condition_count ? "triggered by the first edge" : "waiting for the trigger");
+    while (!STOP && !session.done && !capture_expired(&session.capture, timing_now())) {
+        int status = monitor_wait(&monitor, POLL_PERIOD_NS);
+
+        if (-1 == status && EINTR != errno) {
+            error("error while waiting for the edges");
+        }
+        if (1 == status && -1 == monitor_process(&monitor)) {
+            error("error while reading the edges");
+        }
+    }
+
+    if (-1 == capture_finish(&session.capture, timing_now())) {
+        error("cannot write the capture");
+    }
+    fprintf(stderr, "%ld edges captured, %ld written to %s (%s)\n", session.capture.events, session.capture.written,
+            output, 0 != session.capture.trigger ? "triggered" : "not triggered: pre-trigger edges only");
+    event_counters_print(stderr, "capture", &monitor.counters);
+
+    capture_terminate(&session.capture);
+    monitor_terminate(&monitor);
+    gpio_chip_close(chip);
+    return 0;
+}
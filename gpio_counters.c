@@ -0,0 +1,17 @@
+#include <stdio.h>
+#include "gpio.h"
+
+/**
+ * Print the writes of an output request (or the sum of several requests): the ioctls issued, and the writes elided
+ * because the lines already had the values.
+ * @param stream The stream.
+ * @param name The name of the request.
+ * @param counters The counters (see `gpio_output_get_counters()`).
+ */
+
+void gpio_output_counters_print(FILE *stream, const char *name, const struct gpio_output_counters *counters) {
+    long total = counters->issued + counters->elided;
+
+    fprintf(stream, "%s: %ld writes, %ld ioctls issued, %ld elided (%.1f%%)\n", name, total, counters->issued,
+            counters->elided, total > 0 ? 100.0 * (double)counters->elided / (double)total : 0.0);
+}
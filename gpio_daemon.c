@@ -0,0 +1,665 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include "gpio.h"
+#include "daemon_protocol.h"
+#include "reactor.h"
+#include "timing.h"
+
+// Resident GPIO service: the daemon opens the chip once, keeps the line requests and serves set/get/pulse/subscribe
+// requests over a Unix domain socket, with the binary protocol of daemon_protocol.h.
+//
+//     $ ./gpio_daemon -c gpiochip0 [-s /tmp/gpio_daemon.sock]
+//
+// The lines are requested on first use, as outputs (set, pulse) or as inputs (get, subscribe), and kept until the
+// daemon stops (SIGINT or SIGTERM). Then they are reset. A single thread serves all the clients and all the lines,
+// with a reactor (see reactor.h): the sockets, the edge events of the inputs, the end of the pulses and the signals
+// are all file descriptors.
+
+#define DAEMON_MAX_LINES     256
+/** The maximum number of clients (one bit each, in the subscriber mask of the lines). */
+#define DAEMON_MAX_CLIENTS   64
+#define DEFAULT_SOCKET       "/tmp/gpio_daemon.sock"
+#define CONSUMER             "gpio_daemon"
+/** The size of the reception buffer of a client: the greatest batch of pipelined requests handled at once. */
+#define CLIENT_INPUT_SIZE    (256 * sizeof(struct daemon_request))
+#define CLIENT_OUTPUT_SIZE   (512 * sizeof(struct daemon_message))
+#define EVENT_BUFFER_SIZE    64
+
+#define LINE_UNUSED 0
+#define LINE_OUTPUT 1
+#define LINE_INPUT  2
+
+struct daemon;
+
+struct line {
+    unsigned int       offset;
+    int                mode;
+    struct gpio_output *output;
+    struct gpio_input  *input;
+    /** The value of an output. */
+    int                value;
+    /** The end of the pulse in progress on an output (0: none). */
+    int64_t            pulse_end;
+    /** The clients that receive the edges of an input: bit N for `clients[N]`. */
+    uint64_t           subscribers;
+    struct daemon      *daemon;
+};
+
+struct client {
+    /** The socket (-1: free slot). */
+    int            fd;
+    int            index;
+    /** 1 once a write has failed: the socket is shut down, and the client is released when the reactor sees it. */
+    int            failed;
+    /**
+     * 1 while the socket buffer is full: the rest of the messages waits in `output`, the socket is watched until it
+     * is writable, and the requests of the client are not read (backpressure).
+     */
+    int            blocked;
+    uint8_t        input[CLIENT_INPUT_SIZE];
+    size_t         input_size;
+    uint8_t        output[CLIENT_OUTPUT_SIZE];
+    size_t         output_size;
+    struct daemon  *daemon;
+};
+
+struct daemon {
+    struct gpio_chip *chip;
+    struct reactor   reactor;
+    int              listen_fd;
+    int              timer_fd;
+    int              signal_fd;
+    struct line      lines[DAEMON_MAX_LINES];
+    struct client    clients[DAEMON_MAX_CLIENTS];
+    long             connections;
+    long             requests;
+    long             edges;
+    /** The number of clients disconnected because their backlog of edges overflowed (they did not read them). */
+    long             dropped;
+};
+
+static struct daemon DAEMON;
+
+/**
+ * Print an error message and terminate the program.
+ * @param message The message to print.
+ */
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+// ---------------------------------------------------------------------------------
+// CLIENTS
+// ---------------------------------------------------------------------------------
+
+/**
+ * Disconnect a client that cannot be served anymore. The socket is shut down: this wakes up the reactor, which
+ * releases the client (see `on_client()`).
+ * @param client The client.
+ */
+
+void client_fail(struct client *client) {
+    client->failed = 1;
+    shutdown(client->fd, SHUT_RDWR);
+}
+
+/**
+ * Send the pending messages of a client, with a single write.
+ *
+ * The socket is not blocking: when its buffer is full, the rest of the messages is kept, and the client is blocked
+ * until the socket is writable again (its requests are not read meanwhile, so a pipelining client is slowed down
+ * rather than dropped).
+ * @param client The client.
+ * @return 0 (the messages are sent, or kept), or -1 if the client has failed.
+ */
+
+int client_flush(struct client *client) {
+    ssize_t written;
+
+    if (0 == client->output_size || client->failed) {
+        return client->failed ? -1 : 0;
+    }
+    written = send(client->fd, client->output, client->output_size, MSG_NOSIGNAL);
+    if (-1 == written && EAGAIN != errno && EINTR != errno) {
+        client_fail(client);
+        return -1;
+    }
+    if (written > 0) {
+        client->output_size -= (size_t)written;
+        memmove(client->output, &client->output[written], client->output_size);
+    }
+    if (client->blocked != (client->output_size > 0)) {
+        client->blocked = client->output_size > 0;
+        if (-1 == reactor_watch_fd(&client->daemon->reactor, client->fd,
+                                   client->blocked ? REACTOR_WRITE : REACTOR_READ)) {
+            client_fail(client);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Queue a message for a client. A blocked client only receives edges (its requests are not read): if its backlog
+ * overflows, the client is disconnected.
+ * @param client The client.
+ * @param message The message.
+ */
+
+void client_send(struct client *client, const struct daemon_message *message) {
+    if (client->output_size + sizeof(*message) > CLIENT_OUTPUT_SIZE && -1 == client_flush(client)) {
+        return;
+    }
+    if (client->output_size + sizeof(*message) > CLIENT_OUTPUT_SIZE) {
+        client->daemon->dropped++;
+        client_fail(client);
+        return;
+    }
+    memcpy(&client->output[client->output_size], message, sizeof(*message));
+    client->output_size += sizeof(*message);
+}
+
+void client_release(struct client *client) {
+    uint64_t mask = ~(UINT64_C(1) << client->index);
+
+    for (int i=0; i<DAEMON_MAX_LINES; i++) {
+        client->daemon->lines[i].subscribers &= mask;
+    }
+    close(client->fd);
+    client->fd = -1;
+}
+
+// ---------------------------------------------------------------------------------
+// LINES
+// ---------------------------------------------------------------------------------
+
+/**
+ * Arm the timer of the pulses for the earliest end of pulse (or disarm it).
+ */
+
+void schedule_pulses(struct daemon *daemon) {
+    struct itimerspec specification;
+    int64_t next = 0;
+
+    for (int i=0; i<DAEMON_MAX_LINES; i++) {
+        int64_t end = daemon->lines[i].pulse_end;
+
+        if (0 != end && (0 == next || end < next)) {
+            next = end;
+        }
+    }
+    memset(&specification, 0, sizeof(specification));
+    timing_from_ns(next, &specification.it_value);
+    timerfd_settime(daemon->timer_fd, TFD_TIMER_ABSTIME, &specification, NULL);
+}
+
+int on_edge(void *context, uint64_t expirations);
+
+/**
+ * Get a line as an output, requesting it on first use.
+ * @param line The line.
+ * @param value The initial value of the line, if it is requested.
+ * @return 0 or the opposite of an `errno` value.
+ */
+
+int line_output(struct line *line, int value) {
+    if (LINE_INPUT == line->mode) {
+        return -EBUSY;
+    }
+    if (LINE_UNUSED == line->mode) {
+        line->output = gpio_output_request(line->daemon->chip, CONSUMER, &line->offset, 1, &value);
+        if (NULL == line->output) {
+            return -errno;
+        }
+        line->mode  = LINE_OUTPUT;
+        line->value = value;
+    }
+    return 0;
+}
+
+/**
+ * Get a line as an input, requesting it (and watching its edges) on first use.
+ * @param line The line.
+ * @return 0 or the opposite of an `errno` value.
+ */
+
+int line_input(struct line *line) {
+    if (LINE_OUTPUT == line->mode) {
+        return -EBUSY;
+    }
+    if (LINE_UNUSED == line->mode) {
+        line->input = gpio_input_request(line->daemon->chip, CONSUMER, &line->offset, 1, EVENT_BUFFER_SIZE);
+        if (NULL == line->input) {
+            return -errno;
+        }
+        if (-1 == reactor_add_fd(&line->daemon->reactor, gpio_input_fd(line->input), &on_edge, line)) {
+            int saved = errno;
+            gpio_input_release(line->input);
+            line->input = NULL;
+            return -saved;
+        }
+        line->mode = LINE_INPUT;
+    }
+    return 0;
+}
+
+int line_set(struct line *line, int value) {
+    int status = line_output(line, value);
+
+    if (0 == status) {
+        if (-1 == gpio_output_set_value(line->output, 0, value)) {
+            return -errno;
+        }
+        line->value = value;
+    }
+    return status;
+}
+
+int line_get(struct line *line, int32_t *value) {
+    int status;
+
+    if (LINE_OUTPUT == line->mode) {
+        *value = line->value; // The daemon drives the line: its value is known.
+        return 0;
+    }
+    status = line_input(line);
+    if (0 == status) {
+        int values[1];
+
+        if (-1 == gpio_input_get_values(line->input, values)) {
+            return -errno;
+        }
+        *value = values[0];
+    }
+    return status;
+}
+
+/**
+ * Forward the edges of an input line to its subscribers.
+ */
+
+int on_edge(void *context, uint64_t expirations) {
+    struct line *line = (struct line*)context;
+    struct daemon *daemon = line->daemon;
+    struct gpio_event events[EVENT_BUFFER_SIZE];
+    int count = gpio_input_read(line->input, events, EVENT_BUFFER_SIZE);
+
+    (void)expirations;
+    if (-1 == count) {
+        return EAGAIN == errno ? 0 : -1;
+    }
+    daemon->edges += count;
+    if (0 == line->subscribers) {
+        return 0;
+    }
+    for (int i=0; i<count; i++) {
+        struct daemon_message message = { 0, 0, line->offset, events[i].rising, events[i].timestamp };
+
+        for (int j=0; j<DAEMON_MAX_CLIENTS; j++) {
+            if (line->subscribers & (UINT64_C(1) << j)) {
+                client_send(&daemon->clients[j], &message);
+            }
+        }
+    }
+    for (int j=0; j<DAEMON_MAX_CLIENTS; j++) {
+        if (line->subscribers & (UINT64_C(1) << j)) {
+            client_flush(&daemon->clients[j]);
+        }
+    }
+    return 0;
+}
+
+/**
+ * End the pulses that are due: each output goes back to the opposite of the value of its pulse.
+ */
+
+int on_pulse_timer(void *context, uint64_t expirations) {
+    struct daemon *daemon = (struct daemon*)context;
+    int64_t now = timing_now();
+
+    (void)expirations;
+    if (-1 == read(daemon->timer_fd, &expirations, sizeof(expirations)) && EAGAIN != errno) {
+        return -1;
+    }
+    for (int i=0; i<DAEMON_MAX_LINES; i++) {
+        struct line *line = &daemon->lines[i];
+
+        if (0 != line->pulse_end && line->pulse_end <= now) {
+            int status;
+
+            line->pulse_end = 0;
+            if (0 != (status = line_set(line, !line->value))) {
+                fprintf(stderr, "Warning: cannot end the pulse of line #%u (errno: %d)\n", line->offset, -status);
+            }
+        }
+    }
+    schedule_pulses(daemon);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------
+// REQUESTS
+// ---------------------------------------------------------------------------------
+
+/**
+ * Execute a request.
+ * @param daemon The daemon.
+ * @param client The client that sent the request.
+ * @param request The request.
+ * @param reply The reply (its ID is set by the caller).
+ */
+
+void execute(struct daemon *daemon, struct client *client, const struct daemon_request *request,
+             struct daemon_message *reply) {
+    uint64_t bit = UINT64_C(1) << client->index;
+    struct line *line;
+
+    reply->offset = request->offset;
+    reply->value  = 0;
+    if (request->offset >= DAEMON_MAX_LINES) {
+        reply->status = -EINVAL;
+        return;
+    }
+    line = &daemon->lines[request->offset];
+    switch (request->opcode) {
+        case DAEMON_SET: {
+            if (request->value > 1) {
+                reply->status = -EINVAL;
+                break;
+            }
+            line->pulse_end = 0; // Cancels the pulse in progress, if any (the timer may expire for nothing).
+            reply->status   = line_set(line, request->value);
+            reply->value    = line->value;
+        }; break;
+        case DAEMON_PULSE: {
+            if (request->value > 1 || 0 == request->duration || request->duration > DAEMON_MAX_DURATION) {
+                reply->status = -EINVAL;
+                break;
+            }
+            reply->status = line_set(line, request->value);
+            reply->value  = line->value;
+            if (0 == reply->status) {
+                line->pulse_end = timing_now() + (int64_t)request->duration * 1000;
+                schedule_pulses(daemon);
+            }
+        }; break;
+        case DAEMON_GET: reply->status = line_get(line, &reply->value); break;
+        case DAEMON_SUBSCRIBE: {
+            reply->status = line_get(line, &reply->value);
+            if (0 == reply->status && LINE_INPUT != line->mode) {
+                reply->status = -EBUSY;
+            }
+            if (0 == reply->status) {
+                line->subscribers |= bit;
+            }
+        }; break;
+        case DAEMON_UNSUBSCRIBE: line->subscribers &= ~bit; reply->status = 0; break;
+        default: reply->status = -EOPNOTSUPP;
+    }
+}
+
+/**
+ * Serve a client: read the pending requests, execute them, and send all the replies with a single write. A blocked
+ * client is only sent the rest of its messages.
+ */
+
+int on_client(void *context, uint64_t expirations) {
+    struct client *client = (struct client*)context;
+    struct daemon *daemon = client->daemon;
+    ssize_t size;
+    size_t position = 0;
+
+    (void)expirations;
+    if (client->blocked && !client->failed) {
+        // The socket is writable (or the client has hung up).
+        if (0 == client_flush(client) && client->blocked) {
+            return 0;
+        }
+    }
+    if (client->failed) {
+        client_release(client);
+        return REACTOR_DONE;
+    }
+    size = read(client->fd, &client->input[client->input_size], CLIENT_INPUT_SIZE - client->input_size);
+    if (-1 == size && (EAGAIN == errno || EINTR == errno)) {
+        return 0;
+    }
+    if (size <= 0 || client->failed) {
+        client_release(client);
+        return REACTOR_DONE;
+    }
+    client->input_size += (size_t)size;
+
+    while (client->input_size - position >= sizeof(struct daemon_request)) {
+        struct daemon_request request;
+        struct daemon_message reply;
+
+        memcpy(&request, &client->input[position], sizeof(request));
+        position += sizeof(request);
+        reply.id        = request.id;
+        execute(daemon, client, &request, &reply);
+        reply.timestamp = timing_now();
+        client_send(client, &reply);
+        daemon->requests++;
+    }
+    memmove(client->input, &client->input[position], client->input_size - position);
+    client->input_size -= position;
+
+    if (-1 == client_flush(client)) {
+        client_release(client);
+        return REACTOR_DONE;
+    }
+    return 0;
+}
+
+int on_accept(void *context, uint64_t expirations) {
+    struct daemon *daemon = (struct daemon*)context;
+    struct client *client = NULL;
+    int fd = accept4(daemon->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    (void)expirations;
+    if (-1 == fd) {
+        return EAGAIN == errno || ECONNABORTED == errno || EINTR == errno ? 0 : -1;
+    }
+    for (int i=0; i<DAEMON_MAX_CLIENTS && NULL == client; i++) {
+        if (-1 == daemon->clients[i].fd) {
+            client = &daemon->clients[i];
+        }
+    }
+    if (NULL == client) {
+        fprintf(stderr, "Warning: too many clients (%d), connection refused\n", DAEMON_MAX_CLIENTS);
+        close(fd);
+        return 0;
+    }
+    client->fd          = fd;
+    client->failed      = 0;
+    client->blocked     = 0;
+    client->input_size  = 0;
+    client->output_size = 0;
+    if (-1 == reactor_add_fd(&daemon->reactor, fd, &on_client, client)) {
+        close(fd);
+        client->fd = -1;
+        return 0;
+    }
+    daemon->connections++;
+    return 0;
+}
+
+int on_signal(void *context, uint64_t expirations) {
+    struct daemon *daemon = (struct daemon*)context;
+    struct signalfd_siginfo information;
+
+    (void)expirations;
+    if (sizeof(information) == read(daemon->signal_fd, &information, sizeof(information))) {
+        reactor_stop(&daemon->reactor);
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------------
+// MAIN
+// ---------------------------------------------------------------------------------
+
+int open_socket(const char *path) {
+    struct sockaddr_un address;
+    int fd;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (-1 == fd) {
+        return -1;
+    }
+    unlink(path); // The socket of a previous instance.
+    if (-1 == bind(fd, (struct sockaddr*)&address, sizeof(address)) || -1 == listen(fd, DAEMON_MAX_CLIENTS)) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return fd;
+}
+
+/**
+ * Print the writes of all the outputs: the ioctls issued, and the writes elided because the lines already had the
+ * values (see gpio.h).
+ */
+
+void print_writes(struct daemon *daemon) {
+    struct gpio_output_counters total = { 0, 0 };
+
+    for (int i=0; i<DAEMON_MAX_LINES; i++) {
+        if (LINE_OUTPUT == daemon->lines[i].mode) {
+            const struct gpio_output_counters *counters = gpio_output_get_counters(daemon->lines[i].output);
+
+            total.issued += counters->issued;
+            total.elided += counters->elided;
+        }
+    }
+    gpio_output_counters_print(stderr, "outputs", &total);
+}
+
+/**
+ * Release the lines, then reset them.
+ */
+
+void release_lines(struct daemon *daemon) {
+    unsigned int offsets[DAEMON_MAX_LINES];
+    int count = 0;
+
+    for (int i=0; i<DAEMON_MAX_LINES; i++) {
+        struct line *line = &daemon->lines[i];
+
+        if (LINE_OUTPUT == line->mode) {
+            gpio_output_release(line->output);
+        } else if (LINE_INPUT == line->mode) {
+            gpio_input_release(line->input);
+        } else {
+            continue;
+        }
+        line->mode = LINE_UNUSED;
+        offsets[count++] = line->offset;
+    }
+    if (count > 0 && -1 == gpio_chip_reset_lines(daemon->chip, offsets, count)) {
+        fprintf(stderr, "Warning: error while resetting the lines (errno: %d)\n", errno);
+    }
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s -c chip [-s socket]\n", program);
+    fprintf(stderr, "  -s socket: the path of the Unix domain socket (default: %s).\n", DEFAULT_SOCKET);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    struct daemon *daemon = &DAEMON;
+    const char *chip_name = NULL;
+    const char *path = DEFAULT_SOCKET;
+    sigset_t signals;
+    int option;
+    int status;
+
+    while (-1 != (option = getopt(argc, argv, "c:s:"))) {
+        switch (option) {
+            case 'c': chip_name = optarg; break;
+            case 's': path = optarg; break;
+            default: usage(argv[0]);
+        }
+    }
+    if (NULL == chip_name) {
+        usage(argv[0]);
+    }
+
+    for (int i=0; i<DAEMON_MAX_LINES; i++) {
+        daemon->lines[i].offset = (unsigned int)i;
+        daemon->lines[i].daemon = daemon;
+    }
+    for (int i=0; i<DAEMON_MAX_CLIENTS; i++) {
+        daemon->clients[i].fd     = -1;
+        daemon->clients[i].index  = i;
+        daemon->clients[i].daemon = daemon;
+    }
+    daemon->chip = gpio_chip_open(chip_name);
+    if (NULL == daemon->chip) {
+        error("cannot open the chip");
+    }
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigprocmask(SIG_BLOCK, &signals, NULL);
+    daemon->signal_fd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    daemon->timer_fd  = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    daemon->listen_fd = open_socket(path);
+    if (-1 == daemon->signal_fd || -1 == daemon->timer_fd) {
+        error("cannot create the signal and timer descriptors");
+    }
+    if (-1 == daemon->listen_fd) {
+        error("cannot create the socket");
+    }
+    if (-1 == reactor_init(&daemon->reactor, 3 + DAEMON_MAX_CLIENTS + DAEMON_MAX_LINES)
+        || -1 == reactor_add_fd(&daemon->reactor, daemon->signal_fd, &on_signal, daemon)
+        || -1 == reactor_add_fd(&daemon->reactor, daemon->timer_fd, &on_pulse_timer, daemon)
+        || -1 == reactor_add_fd(&daemon->reactor, daemon->listen_fd, &on_accept, daemon)) {
+        error("cannot create the reactor");
+    }
+
+    fprintf(stderr, "Serving %s on %s (%s)\n", chip_name, path, gpio_backend_name());
+    status = reactor_run(&daemon->reactor);
+    if (-1 == status) {
+        fprintf(stderr, "Warning: the reactor stopped on an error (errno: %d)\n", errno);
+    }
+    fprintf(stderr, "%ld connections, %ld requests, %ld edges, %ld clients dropped\n", daemon->connections,
+            daemon->requests, daemon->edges, daemon->dropped);
+    print_writes(daemon);
+
+    for (int i=0; i<DAEMON_MAX_CLIENTS; i++) {
+        if (-1 != daemon->clients[i].fd) {
+            close(daemon->clients[i].fd);
+        }
+    }
+    reactor_terminate(&daemon->reactor);
+    close(daemon->listen_fd);
+    unlink(path);
+    close(daemon->timer_fd);
+    close(daemon->signal_fd);
+    release_lines(daemon);
+    gpio_chip_close(daemon->chip);
+    return -1 == status ? 1 : 0;
+}
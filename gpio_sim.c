@@ -0,0 +1,28 @@
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include "gpio_sim.h"
+
+/**
+ * Open the `pull` attribute of a simulated line.
+ * @param pull_path The path to the attribute.
+ * @return The file descriptor, or -1 (`errno` is set).
+ */
+
+int gpio_sim_open(const char *pull_path) {
+    return open(pull_path, O_WRONLY | O_CLOEXEC);
+}
+
+/**
+ * Change the level of a simulated line.
+ * @param fd The file descriptor returned by `gpio_sim_open()`.
+ * @param value The level.
+ * @return 0, or -1 (`errno` is set).
+ */
+
+int gpio_sim_set(int fd, int value) {
+    const char *pull = value ? "pull-up" : "pull-down";
+    size_t length = strlen(pull);
+
+    return (ssize_t)length == pwrite(fd, pull, length, 0) ? 0 : -1;
+}
@@ -0,0 +1,15 @@
+#ifndef GPIO_SIM_H
+#define GPIO_SIM_H
+
+// Helpers for the gpio-sim kernel module, used to run the examples and the benchmarks without a Raspberry Pi.
+//
+// The level of a simulated input line is driven by writing "pull-up" or "pull-down" into its `pull` attribute:
+//
+//     /sys/devices/platform/gpio-sim.0/gpiochip2/sim_gpio21/pull
+//
+// This lets a program emulate the GPIO16 -> GPIO21 wiring of example 2 (loopback).
+
+int gpio_sim_open(const char *pull_path);
+int gpio_sim_set(int fd, int value);
+
+#endif // GPIO_SIM_H
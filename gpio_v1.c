@@ -0,0 +1,425 @@
+#include <errno.h>
+#include <gpiod.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include "timing.h"
+#include "gpio.h"
+
+// Implementation of the GPIO layer for libgpiod v1.
+//
+// libgpiod v1 gives one event file descriptor per line. When several input lines are requested, their file
+// descriptors are grouped under an epoll file descriptor, so the request still exposes a single file descriptor.
+
+struct gpio_chip {
+    struct gpiod_chip *chip;
+};
+
+struct gpio_output {
+    struct gpiod_line_bulk      lines;
+    /** The last values written to the lines (0 or 1). */
+    int                         *shadow;
+    int                         count;
+    struct gpio_output_counters counters;
+};
+
+struct gpio_input {
+    struct gpiod_line_bulk  lines;
+    /** The epoll file descriptor that groups the lines (-1 if a single line is requested). */
+    int                     epoll_fd;
+    /** The buffer used to read the events from the kernel. */
+    struct gpiod_line_event *buffer;
+    int                     buffer_size;
+    /** Several lines: the events of each line, before they are merged in the order of their timestamps. */
+    struct gpio_event       *runs;
+};
+
+/**
+ * Return the name of the implementation.
+ * @return The name.
+ */
+
+const char *gpio_backend_name(void) {
+    return "libgpiod v1";
+}
+
+/**
+ * Open a GPIO chip.
+ * @param name The name of the chip (ex: "gpiochip0").
+ * @return The chip, or NULL.
+ */
+
+struct gpio_chip *gpio_chip_open(const char *name) {
+    struct gpio_chip *chip = malloc(sizeof(struct gpio_chip));
+
+    if (NULL == chip) {
+        return NULL;
+    }
+    chip->chip = gpiod_chip_open_by_name(name);
+    if (NULL == chip->chip) {
+        free(chip);
+        return NULL;
+    }
+    return chip;
+}
+
+/**
+ * Close a GPIO chip.
+ * @param chip The chip.
+ */
+
+void gpio_chip_close(struct gpio_chip *chip) {
+    gpiod_chip_close(chip->chip);
+    free(chip);
+}
+
+/**
+ * Reset lines: request them as inputs, then release them.
+ * @param chip The chip.
+ * @param offsets The offsets of the lines.
+ * @param count The number of lines.
+ * @return 0 if all lines have been reset. Otherwise, -1 (`errno` is set for the last failure).
+ */
+
+int gpio_chip_reset_lines(struct gpio_chip *chip, const unsigned int *offsets, int count) {
+    int status = 0;
+
+    for (int i=0; i<count; i++) {
+        struct gpiod_line *line = gpiod_chip_get_line(chip->chip, offsets[i]);
+
+        if (NULL == line || -1 == gpiod_line_request_input(line, "reset")) {
+            status = -1;
+            continue;
+        }
+        gpiod_line_release(line);
+    }
+    return status;
+}
+
+static int get_lines(struct gpio_chip *chip, const unsigned int *offsets, int count, struct gpiod_line_bulk *lines) {
+    if (count < 1 || count > GPIOD_LINE_BULK_MAX_LINES) {
+        errno = EINVAL;
+        return -1;
+    }
+    return gpiod_chip_get_lines(chip->chip, (unsigned int*)offsets, (unsigned int)count, lines);
+}
+
+/**
+ * Request lines as outputs.
+ * @param chip The chip.
+ * @param consumer The name of the consumer.
+ * @param offsets The offsets of the lines.
+ * @param count The number of lines.
+ * @param values The initial values of the lines (in the order of `offsets`).
+ * @return The request, or NULL.
+ */
+
+struct gpio_output *gpio_output_request(struct gpio_chip *chip, const char *consumer,
+                                        const unsigned int *offsets, int count, const int *values) {
+    struct gpio_output *output = calloc(1, sizeof(struct gpio_output));
+
+    if (NULL == output) {
+        return NULL;
+    }
+    output->count  = count;
+    output->shadow = calloc((size_t)count, sizeof(int));
+    if (NULL == output->shadow
+        || -1 == get_lines(chip, offsets, count, &output->lines)
+        || -1 == gpiod_line_request_bulk_output(&output->lines, consumer, values)) {
+        free(output->shadow);
+        free(output);
+        return NULL;
+    }
+    for (int i=0; i<count; i++) {
+        output->shadow[i] = 0 != values[i];
+    }
+    return output;
+}
+
+/**
+ * Change the value of one line. Nothing is written if the line already has the value.
+ * @param output The request.
+ * @param index The index of the line in the request.
+ * @param value The value.
+ * @return 0 or -1.
+ */
+
+int gpio_output_set_value(struct gpio_output *output, int index, int value) {
+    value = 0 != value;
+    if (value == output->shadow[index]) {
+        output->counters.elided++;
+        return 0;
+    }
+    output->counters.issued++;
+    if (-1 == gpiod_line_set_value(gpiod_line_bulk_get_line(&output->lines, (unsigned int)index), value)) {
+        return -1;
+    }
+    output->shadow[index] = value;
+    return 0;
+}
+
+/**
+ * Change the values of all the lines of a request, with a single ioctl. Nothing is written if all the lines already
+ * have the values (libgpiod v1 has no call to write a subset of the lines: otherwise, all the lines are written).
+ * @param output The request.
+ * @param values The values (in the order of the request).
+ * @return 0 or -1.
+ */
+
+int gpio_output_set_values(struct gpio_output *output, const int *values) {
+    int changed = 0;
+
+    for (int i=0; i<output->count && !changed; i++) {
+        changed = (0 != values[i]) != output->shadow[i];
+    }
+    if (!changed) {
+        output->counters.elided++;
+        return 0;
+    }
+    output->counters.issued++;
+    if (-1 == gpiod_line_set_value_bulk(&output->lines, values)) {
+        return -1;
+    }
+    for (int i=0; i<output->count; i++) {
+        output->shadow[i] = 0 != values[i];
+    }
+    return 0;
+}
+
+/**
+ * Return the numbers of writes issued and elided by a request.
+ * @param output The request.
+ * @return The counters.
+ */
+
+const struct gpio_output_counters *gpio_output_get_counters(struct gpio_output *output) {
+    return &output->counters;
+}
+
+/**
+ * Release the lines of a request.
+ * @param output The request.
+ */
+
+void gpio_output_release(struct gpio_output *output) {
+    gpiod_line_release_bulk(&output->lines);
+    free(output->shadow);
+    free(output);
+}
+
+/**
+ * Request lines as inputs, with edge detection on both edges.
+ * @param chip The chip.
+ * @param consumer The name of the consumer.
+ * @param offsets The offsets of the lines.
+ * @param count The number of lines.
+ * @param event_buffer_size The maximum number of events read at once. libgpiod v1 cannot change the size of
+ *        the kernel queue (16 events per line).
+ * @return The request, or NULL.
+ */
+
+struct gpio_input *gpio_input_request(struct gpio_chip *chip, const char *consumer,
+                                      const unsigned int *offsets, int count, int event_buffer_size) {
+    struct gpio_input *input = calloc(1, sizeof(struct gpio_input));
+
+    if (NULL == input) {
+        return NULL;
+    }
+    input->epoll_fd    = -1;
+    input->buffer_size = event_buffer_size > 0 ? event_buffer_size : 1;
+    input->buffer      = calloc((size_t)input->buffer_size, sizeof(struct gpiod_line_event));
+    input->runs        = count > 1 ? calloc((size_t)input->buffer_size, sizeof(struct gpio_event)) : NULL;
+    if (NULL == input->buffer || (count > 1 && NULL == input->runs)
+        || -1 == get_lines(chip, offsets, count, &input->lines)
+        || -1 == gpiod_line_request_bulk_both_edges_events(&input->lines, consumer)) {
+        free(input->buffer);
+        free(input->runs);
+        free(input);
+        return NULL;
+    }
+
+    if (count > 1) {
+        input->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        for (int i=0; -1 != input->epoll_fd && i<count; i++) {
+            struct epoll_event event;
+
+            event.events   = EPOLLIN;
+            event.data.u32 = (uint32_t)i;
+            if (-1 == epoll_ctl(input->epoll_fd, EPOLL_CTL_ADD,
+                                gpiod_line_event_get_fd(gpiod_line_bulk_get_line(&input->lines, i)), &event)) {
+                close(input->epoll_fd);
+                input->epoll_fd = -1;
+            }
+        }
+        if (-1 == input->epoll_fd) {
+            gpio_input_release(input);
+            return NULL;
+        }
+    }
+    return input;
+}
+
+/**
+ * Return the file descriptor that becomes readable when events are pending (to use with poll, epoll...).
+ * @param input The request.
+ * @return The file descriptor.
+ */
+
+int gpio_input_fd(struct gpio_input *input) {
+    if (-1 != input->epoll_fd) {
+        return input->epoll_fd;
+    }
+    return gpiod_line_event_get_fd(gpiod_line_bulk_get_line(&input->lines, 0));
+}
+
+/**
+ * Return the maximum number of events returned by a single read of one line. A read that returns this number of
+ * events may have found the kernel queue full.
+ * @param input The request.
+ * @return The number of events.
+ */
+
+int gpio_input_batch_size(struct gpio_input *input) {
+    // The kernel queue of a line holds 16 events, and libgpiod v1 does not read more than 16 events at once.
+    return input->buffer_size < 16 ? input->buffer_size : 16;
+}
+
+/**
+ * Tell whether the size of the kernel queue follows the event buffer size given to `gpio_input_request()` (that is,
+ * whether requesting the lines again with a larger size can absorb larger bursts).
+ * @return 1 if the queue can be sized, 0 otherwise.
+ */
+
+int gpio_input_resizable(void) {
+    // The kernel queue of a line is fixed (16 events).
+    return 0;
+}
+
+/**
+ * Wait for events.
+ * @param input The request.
+ * @param timeout The maximum time to wait, in nano seconds. If negative, the function waits indefinitely.
+ * @return 1 if events are pending, 0 on timeout, -1 on error.
+ */
+
+int gpio_input_wait(struct gpio_input *input, int64_t timeout) {
+    struct timespec limit;
+
+    if (-1 != input->epoll_fd) {
+        struct epoll_event event;
+        int count;
+
+        do {
+            count = epoll_wait(input->epoll_fd, &event, 1, timeout < 0 ? -1 : (int)((timeout + 999999) / 1000000));
+        } while (-1 == count && EINTR == errno);
+        return count > 0 ? 1 : count;
+    }
+    timing_from_ns(timeout, &limit);
+    return gpiod_line_event_wait(gpiod_line_bulk_get_line(&input->lines, 0), timeout < 0 ? NULL : &limit);
+}
+
+static void convert(struct gpiod_line_event *from, unsigned int offset, struct gpio_event *to) {
+    to->timestamp    = timing_to_ns(&from->ts);
+    to->offset       = offset;
+    to->rising       = GPIOD_LINE_EVENT_RISING_EDGE == from->event_type;
+    to->global_seqno = 0; // Not reported by libgpiod v1.
+    to->line_seqno   = 0;
+}
+
+/**
+ * Read pending events. If no event is pending, the function blocks until at least one event is available.
+ *
+ * The lines are read one after the other: the events of each line (a run, in the order of the timestamps) are merged,
+ * so that the events are returned in the order of their timestamps, as with libgpiod v2.
+ * @param input The request.
+ * @param events The array that receives the events.
+ * @param max The maximum number of events to read.
+ * @return The number of events read, or -1.
+ */
+
+int gpio_input_read(struct gpio_input *input, struct gpio_event *events, int max) {
+    struct epoll_event ready[GPIOD_LINE_BULK_MAX_LINES];
+    int starts[GPIOD_LINE_BULK_MAX_LINES + 1];
+    int heads[GPIOD_LINE_BULK_MAX_LINES];
+    int runs = 0;
+    int total = 0;
+    int count;
+
+    if (max > input->buffer_size) {
+        max = input->buffer_size;
+    }
+
+    if (-1 == input->epoll_fd) {
+        struct gpiod_line *line = gpiod_line_bulk_get_line(&input->lines, 0);
+
+        count = gpiod_line_event_read_multiple(line, input->buffer, (unsigned int)max);
+        for (int i=0; i<count; i++) {
+            convert(&input->buffer[i], gpiod_line_offset(line), &events[i]);
+        }
+        return count;
+    }
+
+    do {
+        count = epoll_wait(input->epoll_fd, ready, GPIOD_LINE_BULK_MAX_LINES, -1);
+    } while (-1 == count && EINTR == errno);
+    if (-1 == count) {
+        return -1;
+    }
+    for (int i=0; i<count && total<max; i++) {
+        struct gpiod_line *line = gpiod_line_bulk_get_line(&input->lines, ready[i].data.u32);
+        int read = gpiod_line_event_read_multiple(line, input->buffer, (unsigned int)(max - total));
+
+        if (-1 == read) {
+            return -1;
+        }
+        starts[runs] = total;
+        for (int j=0; j<read; j++) {
+            convert(&input->buffer[j], gpiod_line_offset(line), &input->runs[total++]);
+        }
+        runs += read > 0;
+    }
+    starts[runs] = total;
+
+    // k-way merge of the runs (a few lines are usually ready at once: a linear search of the earliest head is enough).
+    for (int r=0; r<runs; r++) {
+        heads[r] = starts[r];
+    }
+    for (int i=0; i<total; i++) {
+        int best = -1;
+
+        for (int r=0; r<runs; r++) {
+            if (heads[r] < starts[r + 1]
+                && (-1 == best || input->runs[heads[r]].timestamp < input->runs[heads[best]].timestamp)) {
+                best = r;
+            }
+        }
+        events[i] = input->runs[heads[best]++];
+    }
+    return total;
+}
+
+/**
+ * Read the current values of the lines of a request.
+ * @param input The request.
+ * @param values The array that receives the values (in the order of the offsets of the request).
+ * @return 0 or -1.
+ */
+
+int gpio_input_get_values(struct gpio_input *input, int *values) {
+    return gpiod_line_get_value_bulk(&input->lines, values);
+}
+
+/**
+ * Release the lines of a request.
+ * @param input The request.
+ */
+
+void gpio_input_release(struct gpio_input *input) {
+    if (-1 != input->epoll_fd) {
+        close(input->epoll_fd);
+    }
+    gpiod_line_release_bulk(&input->lines);
+    free(input->buffer);
+    free(input->runs);
+    free(input);
+}
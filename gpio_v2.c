@@ -0,0 +1,417 @@
+#include <errno.h>
+#include <gpiod.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gpio.h"
+
+// Implementation of the GPIO layer for libgpiod v2.
+//
+// A set of lines is a single `gpiod_line_request`: all the lines of a request share one file descriptor, and the
+// edge events of all the lines are read in batches through a `gpiod_edge_event_buffer`.
+
+struct gpio_chip {
+    struct gpiod_chip *chip;
+};
+
+struct gpio_output {
+    struct gpiod_line_request   *request;
+    unsigned int                *offsets;
+    /** The last values written to the lines. */
+    enum gpiod_line_value       *values;
+    int                         count;
+    /** The lines that change, passed to `gpiod_line_request_set_values_subset()`. */
+    unsigned int                *changed_offsets;
+    enum gpiod_line_value       *changed_values;
+    struct gpio_output_counters counters;
+};
+
+struct gpio_input {
+    struct gpiod_line_request     *request;
+    struct gpiod_edge_event_buffer *buffer;
+    /** The buffer used to convert the values returned by `gpio_input_get_values()`. */
+    enum gpiod_line_value         *values;
+    int                           count;
+};
+
+/**
+ * Return the name of the implementation.
+ * @return The name.
+ */
+
+const char *gpio_backend_name(void) {
+    return "libgpiod v2";
+}
+
+/**
+ * Open a GPIO chip.
+ * @param name The name of the chip (ex: "gpiochip0"), or the path to the chip (ex: "/dev/gpiochip0").
+ * @return The chip, or NULL.
+ */
+
+struct gpio_chip *gpio_chip_open(const char *name) {
+    struct gpio_chip *chip = malloc(sizeof(struct gpio_chip));
+    char path[256];
+
+    if (NULL == chip) {
+        return NULL;
+    }
+    if (NULL == strchr(name, '/')) {
+        snprintf(path, sizeof(path), "/dev/%s", name);
+        name = path;
+    }
+    chip->chip = gpiod_chip_open(name);
+    if (NULL == chip->chip) {
+        free(chip);
+        return NULL;
+    }
+    return chip;
+}
+
+/**
+ * Close a GPIO chip.
+ * @param chip The chip.
+ */
+
+void gpio_chip_close(struct gpio_chip *chip) {
+    gpiod_chip_close(chip->chip);
+    free(chip);
+}
+
+/**
+ * Request lines.
+ * @param chip The chip.
+ * @param consumer The name of the consumer.
+ * @param offsets The offsets of the lines.
+ * @param count The number of lines.
+ * @param settings The settings of all the lines.
+ * @param values If not NULL, the output values of the lines.
+ * @param event_buffer_size The size of the kernel event queue (0: default size).
+ * @return The request, or NULL.
+ */
+
+static struct gpiod_line_request *request_lines(struct gpio_chip *chip, const char *consumer,
+                                                const unsigned int *offsets, int count,
+                                                struct gpiod_line_settings *settings,
+                                                const enum gpiod_line_value *values, int event_buffer_size) {
+    struct gpiod_line_config *line_config = gpiod_line_config_new();
+    struct gpiod_request_config *request_config = gpiod_request_config_new();
+    struct gpiod_line_request *request = NULL;
+    int saved;
+
+    if (NULL != line_config && NULL != request_config
+        && 0 == gpiod_line_config_add_line_settings(line_config, offsets, (size_t)count, settings)
+        && (NULL == values || 0 == gpiod_line_config_set_output_values(line_config, values, (size_t)count))) {
+        gpiod_request_config_set_consumer(request_config, consumer);
+        if (event_buffer_size > 0) {
+            gpiod_request_config_set_event_buffer_size(request_config, (size_t)event_buffer_size);
+        }
+        request = gpiod_chip_request_lines(chip->chip, request_config, line_config);
+    }
+
+    saved = errno;
+    if (NULL != request_config) {
+        gpiod_request_config_free(request_config);
+    }
+    if (NULL != line_config) {
+        gpiod_line_config_free(line_config);
+    }
+    errno = saved;
+    return request;
+}
+
+/**
+ * Reset lines: request them as inputs, then release them.
+ * @param chip The chip.
+ * @param offsets The offsets of the lines.
+ * @param count The number of lines.
+ * @return 0 or -1.
+ */
+
+int gpio_chip_reset_lines(struct gpio_chip *chip, const unsigned int *offsets, int count) {
+    struct gpiod_line_settings *settings = gpiod_line_settings_new();
+    struct gpiod_line_request *request = NULL;
+
+    if (NULL != settings && 0 == gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT)) {
+        request = request_lines(chip, "reset", offsets, count, settings, NULL, 0);
+    }
+    if (NULL != settings) {
+        gpiod_line_settings_free(settings);
+    }
+    if (NULL == request) {
+        return -1;
+    }
+    gpiod_line_request_release(request);
+    return 0;
+}
+
+/**
+ * Request lines as outputs.
+ * @param chip The chip.
+ * @param consumer The name of the consumer.
+ * @param offsets The offsets of the lines.
+ * @param count The number of lines.
+ * @param values The initial values of the lines (in the order of `offsets`).
+ * @return The request, or NULL.
+ */
+
+struct gpio_output *gpio_output_request(struct gpio_chip *chip, const char *consumer,
+                                        const unsigned int *offsets, int count, const int *values) {
+    struct gpio_output *output = calloc(1, sizeof(struct gpio_output));
+    struct gpiod_line_settings *settings = gpiod_line_settings_new();
+
+    if (NULL != output) {
+        output->count           = count;
+        output->offsets         = calloc((size_t)count, sizeof(unsigned int));
+        output->values          = calloc((size_t)count, sizeof(enum gpiod_line_value));
+        output->changed_offsets = calloc((size_t)count, sizeof(unsigned int));
+        output->changed_values  = calloc((size_t)count, sizeof(enum gpiod_line_value));
+    }
+    if (NULL != output && NULL != output->offsets && NULL != output->values && NULL != output->changed_offsets
+        && NULL != output->changed_values) {
+        for (int i=0; i<count; i++) {
+            output->offsets[i] = offsets[i];
+            output->values[i]  = values[i] ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+        }
+    }
+    if (NULL == output || NULL == output->offsets || NULL == output->values || NULL == output->changed_offsets
+        || NULL == output->changed_values || NULL == settings
+        || 0 != gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_OUTPUT)
+        || NULL == (output->request = request_lines(chip, consumer, offsets, count, settings, output->values, 0))) {
+        if (NULL != settings) {
+            gpiod_line_settings_free(settings);
+        }
+        if (NULL != output) {
+            free(output->offsets);
+            free(output->values);
+            free(output->changed_offsets);
+            free(output->changed_values);
+            free(output);
+        }
+        return NULL;
+    }
+    gpiod_line_settings_free(settings);
+    return output;
+}
+
+/**
+ * Change the value of one line. Nothing is written if the line already has the value.
+ * @param output The request.
+ * @param index The index of the line in the request.
+ * @param value The value.
+ * @return 0 or -1.
+ */
+
+int gpio_output_set_value(struct gpio_output *output, int index, int value) {
+    enum gpiod_line_value line_value = value ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+
+    if (line_value == output->values[index]) {
+        output->counters.elided++;
+        return 0;
+    }
+    output->counters.issued++;
+    if (-1 == gpiod_line_request_set_value(output->request, output->offsets[index], line_value)) {
+        return -1;
+    }
+    output->values[index] = line_value;
+    return 0;
+}
+
+/**
+ * Change the values of the lines of a request, with a single ioctl that only carries the lines that change.
+ * Nothing is written if all the lines already have the values.
+ * @param output The request.
+ * @param values The values (in the order of the request).
+ * @return 0 or -1.
+ */
+
+int gpio_output_set_values(struct gpio_output *output, const int *values) {
+    int count = 0;
+
+    for (int i=0; i<output->count; i++) {
+        enum gpiod_line_value line_value = values[i] ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+
+        if (line_value != output->values[i]) {
+            output->changed_offsets[count] = output->offsets[i];
+            output->changed_values[count]  = line_value;
+            count++;
+        }
+    }
+    if (0 == count) {
+        output->counters.elided++;
+        return 0;
+    }
+    output->counters.issued++;
+    if (-1 == gpiod_line_request_set_values_subset(output->request, (size_t)count, output->changed_offsets,
+                                                   output->changed_values)) {
+        return -1;
+    }
+    for (int i=0; i<output->count; i++) {
+        output->values[i] = values[i] ? GPIOD_LINE_VALUE_ACTIVE : GPIOD_LINE_VALUE_INACTIVE;
+    }
+    return 0;
+}
+
+/**
+ * Return the numbers of writes issued and elided by a request.
+ * @param output The request.
+ * @return The counters.
+ */
+
+const struct gpio_output_counters *gpio_output_get_counters(struct gpio_output *output) {
+    return &output->counters;
+}
+
+/**
+ * Release the lines of a request.
+ * @param output The request.
+ */
+
+void gpio_output_release(struct gpio_output *output) {
+    gpiod_line_request_release(output->request);
+    free(output->offsets);
+    free(output->values);
+    free(output->changed_offsets);
+    free(output->changed_values);
+    free(output);
+}
+
+/**
+ * Request lines as inputs, with edge detection on both edges.
+ * @param chip The chip.
+ * @param consumer The name of the consumer.
+ * @param offsets The offsets of the lines.
+ * @param count The number of lines.
+ * @param event_buffer_size The size of the kernel event queue, and the maximum number of events read at once
+ *        (below 2, the kernel queue has its default size).
+ * @return The request, or NULL.
+ */
+
+struct gpio_input *gpio_input_request(struct gpio_chip *chip, const char *consumer,
+                                      const unsigned int *offsets, int count, int event_buffer_size) {
+    struct gpio_input *input = calloc(1, sizeof(struct gpio_input));
+    struct gpiod_line_settings *settings = gpiod_line_settings_new();
+    // The kernel rejects a queue of less than 2 events: the default size (0) is used instead.
+    int queue_size = event_buffer_size < 2 ? 0 : event_buffer_size;
+
+    if (event_buffer_size < 1) {
+        event_buffer_size = 1;
+    }
+    if (NULL == input || NULL == settings
+        || 0 != gpiod_line_settings_set_direction(settings, GPIOD_LINE_DIRECTION_INPUT)
+        || 0 != gpiod_line_settings_set_edge_detection(settings, GPIOD_LINE_EDGE_BOTH)
+        || NULL == (input->values = calloc((size_t)count, sizeof(enum gpiod_line_value)))
+        || NULL == (input->buffer = gpiod_edge_event_buffer_new((size_t)event_buffer_size))
+        || NULL == (input->request = request_lines(chip, consumer, offsets, count, settings, NULL, queue_size))) {
+        if (NULL != input && NULL != input->buffer) {
+            gpiod_edge_event_buffer_free(input->buffer);
+        }
+        if (NULL != input) {
+            free(input->values);
+        }
+        if (NULL != settings) {
+            gpiod_line_settings_free(settings);
+        }
+        free(input);
+        return NULL;
+    }
+    gpiod_line_settings_free(settings);
+    input->count = count;
+    return input;
+}
+
+/**
+ * Return the file descriptor that becomes readable when events are pending (to use with poll, epoll...).
+ * @param input The request.
+ * @return The file descriptor.
+ */
+
+int gpio_input_fd(struct gpio_input *input) {
+    return gpiod_line_request_get_fd(input->request);
+}
+
+/**
+ * Return the maximum number of events returned by a single read. A read that returns this number of events may
+ * have found the kernel queue full.
+ * @param input The request.
+ * @return The number of events.
+ */
+
+int gpio_input_batch_size(struct gpio_input *input) {
+    return (int)gpiod_edge_event_buffer_get_capacity(input->buffer);
+}
+
+/**
+ * Tell whether the size of the kernel queue follows the event buffer size given to `gpio_input_request()` (that is,
+ * whether requesting the lines again with a larger size can absorb larger bursts).
+ * @return 1 if the queue can be sized, 0 otherwise.
+ */
+
+int gpio_input_resizable(void) {
+    return 1;
+}
+
+/**
+ * Wait for events.
+ * @param input The request.
+ * @param timeout The maximum time to wait, in nano seconds. If negative, the function waits indefinitely.
+ * @return 1 if events are pending, 0 on timeout, -1 on error.
+ */
+
+int gpio_input_wait(struct gpio_input *input, int64_t timeout) {
+    return gpiod_line_request_wait_edge_events(input->request, timeout);
+}
+
+/**
+ * Read pending events. If no event is pending, the function blocks until at least one event is available.
+ * @param input The request.
+ * @param events The array that receives the events.
+ * @param max The maximum number of events to read.
+ * @return The number of events read, or -1.
+ */
+
+int gpio_input_read(struct gpio_input *input, struct gpio_event *events, int max) {
+    size_t capacity = gpiod_edge_event_buffer_get_capacity(input->buffer);
+    int count = gpiod_line_request_read_edge_events(input->request, input->buffer,
+                                                    (size_t)max < capacity ? (size_t)max : capacity);
+
+    for (int i=0; i<count; i++) {
+        struct gpiod_edge_event *event = gpiod_edge_event_buffer_get_event(input->buffer, (unsigned long)i);
+
+        events[i].timestamp    = (int64_t)gpiod_edge_event_get_timestamp_ns(event);
+        events[i].offset       = gpiod_edge_event_get_line_offset(event);
+        events[i].rising       = GPIOD_EDGE_EVENT_RISING_EDGE == gpiod_edge_event_get_event_type(event);
+        events[i].global_seqno = (uint32_t)gpiod_edge_event_get_global_seqno(event);
+        events[i].line_seqno   = (uint32_t)gpiod_edge_event_get_line_seqno(event);
+    }
+    return count;
+}
+
+/**
+ * Read the current values of the lines of a request.
+ * @param input The request.
+ * @param values The array that receives the values (in the order of the offsets of the request).
+ * @return 0 or -1.
+ */
+
+int gpio_input_get_values(struct gpio_input *input, int *values) {
+    if (-1 == gpiod_line_request_get_values(input->request, input->values)) {
+        return -1;
+    }
+    for (int i=0; i<input->count; i++) {
+        values[i] = GPIOD_LINE_VALUE_ACTIVE == input->values[i];
+    }
+    return 0;
+}
+
+/**
+ * Release the lines of a request.
+ * @param input The request.
+ */
+
+void gpio_input_release(struct gpio_input *input) {
+    gpiod_line_request_release(input->request);
+    gpiod_edge_event_buffer_free(input->buffer);
+    free(input->values);
+    free(input);
+}
@@ -0,0 +1,109 @@
+#include <string.h>
+#include "histogram.h"
+
+#define SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+
+static int bucket_of(int64_t value) {
+    int msb, shift;
+
+    if (value < SUB_BUCKETS) {
+        return value < 0 ? 0 : (int)value;
+    }
+    msb   = 63 - __builtin_clzll((unsigned long long)value);
+    shift = msb - HISTOGRAM_SUB_BITS;
+    return (shift + 1) * SUB_BUCKETS + (int)((value >> shift) - SUB_BUCKETS);
+}
+
+/** Return the greatest value that falls into a bucket. */
+static int64_t value_of(int bucket) {
+    int shift;
+
+    if (bucket < SUB_BUCKETS) {
+        return bucket;
+    }
+    shift = bucket / SUB_BUCKETS - 1;
+    return ((int64_t)(bucket % SUB_BUCKETS + SUB_BUCKETS + 1) << shift) - 1;
+}
+
+/**
+ * Initialise a histogram.
+ * @param histogram The histogram to initialise.
+ */
+
+void histogram_init(struct histogram *histogram) {
+    memset(histogram, 0, sizeof(struct histogram));
+    histogram->min = INT64_MAX;
+}
+
+/**
+ * Record a value. Negative values are recorded as 0.
+ * @param histogram The histogram.
+ * @param value The value.
+ */
+
+void histogram_record(struct histogram *histogram, int64_t value) {
+    int64_t current;
+
+    __atomic_fetch_add(&histogram->counts[bucket_of(value)], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&histogram->total, 1, __ATOMIC_RELAXED);
+
+    current = __atomic_load_n(&histogram->min, __ATOMIC_RELAXED);
+    while (value < current && !__atomic_compare_exchange_n(&histogram->min, &current, value, 1,
+                                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // `current` has been reloaded.
+    }
+    current = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    while (value > current && !__atomic_compare_exchange_n(&histogram->max, &current, value, 1,
+                                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        // `current` has been reloaded.
+    }
+}
+
+/**
+ * Return (an upper bound of) the value below which a given percentage of the recorded values fall.
+ * @param histogram The histogram.
+ * @param percentile The percentage, in the range [0, 100].
+ * @return The value. If no value has been recorded, the function returns 0.
+ */
+
+int64_t histogram_percentile(const struct histogram *histogram, double percentile) {
+    uint64_t total = __atomic_load_n(&histogram->total, __ATOMIC_RELAXED);
+    int64_t  max   = __atomic_load_n(&histogram->max, __ATOMIC_RELAXED);
+    uint64_t rank  = (uint64_t)((double)total * percentile / 100.0 + 0.5);
+    uint64_t seen  = 0;
+
+    if (0 == total) {
+        return 0;
+    }
+    if (rank < 1) {
+        rank = 1;
+    }
+    for (int bucket=0; bucket<HISTOGRAM_BUCKETS; bucket++) {
+        seen += __atomic_load_n(&histogram->counts[bucket], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            int64_t value = value_of(bucket);
+            return value > max ? max : value;
+        }
+    }
+    return max;
+}
+
+/**
+ * Print the main percentiles of a histogram.
+ * @param stream The stream to print to.
+ * @param name The name of the histogram.
+ * @param histogram The histogram.
+ */
+
+void histogram_print(FILE *stream, const char *name, const struct histogram *histogram) {
+    uint64_t total = __atomic_load_n(&histogram->total, __ATOMIC_RELAXED);
+
+    fprintf(stream, "%s: %llu values, min %lld, p50 %lld, p90 %lld, p99 %lld, p99.9 %lld, max %lld\n",
+            name, (unsigned long long)total,
+            (long long)(total > 0 ? __atomic_load_n(&histogram->min, __ATOMIC_RELAXED) : 0),
+            (long long)histogram_percentile(histogram, 50.0),
+            (long long)histogram_percentile(histogram, 90.0),
+            (long long)histogram_percentile(histogram, 99.0),
+            (long long)histogram_percentile(histogram, 99.9),
+            (long long)__atomic_load_n(&histogram->max, __ATOMIC_RELAXED));
+}
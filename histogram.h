@@ -0,0 +1,31 @@
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** Each power of two is split into 2^HISTOGRAM_SUB_BITS buckets: the relative error is below 1/32. */
+#define HISTOGRAM_SUB_BITS 5
+#define HISTOGRAM_BUCKETS  ((65 - HISTOGRAM_SUB_BITS) << HISTOGRAM_SUB_BITS)
+
+/**
+ * Log-linear histogram of non-negative values (durations, in nano seconds).
+ * The memory footprint is constant, whatever the number of recorded values.
+ *
+ * The histogram is lock-free: all fields are updated with atomic operations, so a thread can print a histogram
+ * while another thread records values into it (the printed values may be off by the values recorded meanwhile).
+ */
+
+struct histogram {
+    uint64_t counts[HISTOGRAM_BUCKETS];
+    uint64_t total;
+    int64_t  min;
+    int64_t  max;
+};
+
+void histogram_init(struct histogram *histogram);
+void histogram_record(struct histogram *histogram, int64_t value);
+int64_t histogram_percentile(const struct histogram *histogram, double percentile);
+void histogram_print(FILE *stream, const char *name, const struct histogram *histogram);
+
+#endif // HISTOGRAM_H
@@ -0,0 +1,363 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "journal.h"
+
+/**
+ * Build the path of a segment.
+ * @param buffer The buffer that receives the path.
+ * @param size The size of the buffer.
+ * @param path The path of the journal.
+ * @param index The index of the segment.
+ */
+
+static void segment_path(char *buffer, size_t size, const char *path, uint64_t index) {
+    snprintf(buffer, size, "%s.%llu", path, (unsigned long long)index);
+}
+
+/**
+ * Find the segments of a journal on disk, and optionally remove them.
+ * @param path The path of the journal.
+ * @param remove If not 0, the segments are removed.
+ * @param first If not NULL, receives the index of the oldest segment (the older ones may have been deleted).
+ * @return The number of segments found, or -1 on error.
+ */
+
+static int scan_segments(const char *path, int remove, uint64_t *first) {
+    char directory[JOURNAL_PATH_SIZE];
+    const char *name = strrchr(path, '/');
+    size_t name_length;
+    struct dirent *entry;
+    DIR *dir;
+    int found = 0;
+
+    if (NULL == name) {
+        strcpy(directory, ".");
+        name = path;
+    } else {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(name - path) > 0 ? (int)(name - path) : 1, path);
+        name++;
+    }
+    name_length = strlen(name);
+    if (NULL == (dir = opendir(directory))) {
+        return -1;
+    }
+    while (NULL != (entry = readdir(dir))) {
+        char segment[JOURNAL_PATH_SIZE + 32];
+        char *end;
+        unsigned long long index;
+
+        if (0 != strncmp(entry->d_name, name, name_length) || '.' != entry->d_name[name_length]
+            || 0 == entry->d_name[name_length + 1]) {
+            continue;
+        }
+        index = strtoull(entry->d_name + name_length + 1, &end, 10);
+        if (0 != *end) {
+            continue;
+        }
+        if (NULL != first && (0 == found || index < *first)) {
+            *first = index;
+        }
+        found++;
+        if (remove) {
+            segment_path(segment, sizeof(segment), path, index);
+            unlink(segment);
+        }
+    }
+    closedir(dir);
+    return found;
+}
+
+/**
+ * Create, preallocate and map the current segment of a journal.
+ * @param journal The journal.
+ * @return 0 on success, -1 on error.
+ */
+
+static int open_segment(struct journal *journal) {
+    char path[JOURNAL_PATH_SIZE + 32];
+    struct journal_header *header;
+    int fd;
+    int status;
+
+    segment_path(path, sizeof(path), journal->path, journal->segment_index);
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (-1 == fd) {
+        return -1;
+    }
+    // Allocate the blocks now, rather than when the pages are written. Some file systems cannot do it.
+    status = posix_fallocate(fd, 0, (off_t)journal->segment_size);
+    if ((0 != status && -1 == ftruncate(fd, (off_t)journal->segment_size))
+        || MAP_FAILED == (journal->mapping = mmap(NULL, journal->segment_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                                                  fd, 0))) {
+        journal->mapping = NULL;
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    header = (struct journal_header*)journal->mapping;
+    header->version        = JOURNAL_VERSION;
+    header->record_size    = sizeof(struct journal_record);
+    header->segment_index  = journal->segment_index;
+    header->first_sequence = journal->sequence;
+    header->capacity       = journal->capacity;
+    // The magic is written last: a concurrent reader never sees a partial header.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(header->magic, JOURNAL_MAGIC, sizeof(header->magic));
+    journal->records = (struct journal_record*)((char*)journal->mapping + JOURNAL_HEADER_SIZE);
+    journal->count   = 0;
+
+    if (journal->max_segments > 0 && journal->segment_index >= journal->max_segments) {
+        segment_path(path, sizeof(path), journal->path, journal->segment_index - journal->max_segments);
+        unlink(path);
+    }
+    return 0;
+}
+
+/**
+ * Create a journal. The existing segments of a journal with the same path are removed (a reader must not roll into
+ * the segments of a longer previous run).
+ * @param journal The journal to create.
+ * @param path The path of the journal (the segments are named `<path>.<index>`).
+ * @param segment_size The size of a segment, in bytes (0: `JOURNAL_SEGMENT_SIZE`).
+ * @param max_segments The maximum number of segments kept on disk (0: no limit).
+ * @return 0 on success, -1 on error.
+ */
+
+int journal_open(struct journal *journal, const char *path, size_t segment_size, uint64_t max_segments) {
+    if (strlen(path) >= JOURNAL_PATH_SIZE) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    if (0 == segment_size) {
+        segment_size = JOURNAL_SEGMENT_SIZE;
+    }
+    if (segment_size < JOURNAL_HEADER_SIZE + sizeof(struct journal_record)) {
+        errno = EINVAL;
+        return -1;
+    }
+    strcpy(journal->path, path);
+    journal->segment_size  = segment_size;
+    journal->max_segments  = max_segments;
+    journal->segment_index = 0;
+    journal->sequence      = 0;
+    journal->capacity      = (segment_size - JOURNAL_HEADER_SIZE) / sizeof(struct journal_record);
+    journal->mapping       = NULL;
+    if (-1 == scan_segments(path, 1, NULL)) {
+        return -1;
+    }
+    return open_segment(journal);
+}
+
+/**
+ * Append a record to a journal.
+ * This function performs no system call, except when the current segment is full.
+ * @param journal The journal. If NULL, nothing is recorded.
+ * @param timestamp The timestamp of the record.
+ * @param line_id The (GPIO) line ID.
+ * @param kind The kind of record: `JOURNAL_EDGE` or `JOURNAL_TRANSITION`.
+ * @param value The value (see the kind of record).
+ * @return 0 on success, -1 on error.
+ */
+
+int journal_append(struct journal *journal, int64_t timestamp, unsigned int line_id, int kind, int value) {
+    struct journal_record *record;
+
+    if (NULL == journal) {
+        return 0;
+    }
+    if (journal->count == journal->capacity) {
+        munmap(journal->mapping, journal->segment_size);
+        journal->segment_index++;
+        if (-1 == open_segment(journal)) {
+            return -1;
+        }
+    }
+
+    record = &journal->records[journal->count++];
+    record->timestamp = timestamp;
+    record->sequence  = journal->sequence++;
+    record->line_id   = line_id;
+    record->value     = (uint8_t)value;
+    // The kind is written last: a concurrent reader never sees a partial record.
+    __atomic_store_n(&record->kind, (uint8_t)kind, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/**
+ * Close a journal. The records are written back to the file by the kernel.
+ * @param journal The journal.
+ */
+
+void journal_close(struct journal *journal) {
+    if (NULL != journal->mapping) {
+        munmap(journal->mapping, journal->segment_size);
+        journal->mapping = NULL;
+    }
+}
+
+// ---------------------------------------------------------------------------------
+// READER
+// ---------------------------------------------------------------------------------
+
+/**
+ * Map a segment for reading (and unmap the previous one).
+ * @param reader The reader.
+ * @param index The index of the segment.
+ * @return 0 on success, -1 on error (ENOENT: no such segment, EAGAIN: the segment is being created).
+ */
+
+static int map_segment(struct journal_reader *reader, uint64_t index) {
+    char path[JOURNAL_PATH_SIZE + 32];
+    const struct journal_header *header;
+    struct stat status;
+    void *mapping;
+    int fd;
+
+    segment_path(path, sizeof(path), reader->path, index);
+    if (-1 == (fd = open(path, O_RDONLY | O_CLOEXEC))) {
+        return -1;
+    }
+    if (-1 == fstat(fd, &status)) {
+        close(fd);
+        return -1;
+    }
+    // The writer creates the file, then allocates it and writes the header: no data yet.
+    if ((size_t)status.st_size < JOURNAL_HEADER_SIZE) {
+        close(fd);
+        errno = EAGAIN;
+        return -1;
+    }
+    if (MAP_FAILED == (mapping = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_SHARED, fd, 0))) {
+        close(fd);
+        return -1;
+    }
+    close(fd);
+
+    header = (const struct journal_header*)mapping;
+    if (0 == __atomic_load_n(&header->magic[0], __ATOMIC_ACQUIRE)) {
+        munmap(mapping, (size_t)status.st_size);
+        errno = EAGAIN;
+        return -1;
+    }
+    if (0 != memcmp(header->magic, JOURNAL_MAGIC, sizeof(header->magic))
+        || sizeof(struct journal_record) != header->record_size
+        || JOURNAL_HEADER_SIZE + header->capacity * sizeof(struct journal_record) > (uint64_t)status.st_size) {
+        munmap(mapping, (size_t)status.st_size);
+        errno = EINVAL;
+        return -1;
+    }
+    madvise(mapping, (size_t)status.st_size, MADV_SEQUENTIAL);
+
+    if (NULL != reader->mapping) {
+        munmap(reader->mapping, reader->mapping_size);
+    }
+    reader->mapping       = mapping;
+    reader->mapping_size  = (size_t)status.st_size;
+    reader->segment_index = index;
+    reader->records       = (const struct journal_record*)((const char*)mapping + JOURNAL_HEADER_SIZE);
+    reader->capacity      = header->capacity;
+    reader->next          = 0;
+    return 0;
+}
+
+/**
+ * Open a journal for reading, from its oldest segment on disk.
+ * @param reader The reader to open.
+ * @param path The path of the journal.
+ * @return 0 on success, -1 on error.
+ */
+
+int journal_reader_open(struct journal_reader *reader, const char *path) {
+    uint64_t first = 0;
+    int found;
+
+    if (strlen(path) >= JOURNAL_PATH_SIZE) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(reader->path, path);
+    reader->mapping = NULL;
+    reader->skipped = 0;
+
+    if (-1 == (found = scan_segments(path, 0, &first))) {
+        return -1;
+    }
+    if (0 == found) {
+        errno = ENOENT;
+        return -1;
+    }
+    return map_segment(reader, first);
+}
+
+/**
+ * Move a reader to the segment that follows its current one. If the writer has already deleted that segment (the
+ * reader is too slow for the retention), the reader skips to the oldest segment on disk, and counts the segments lost.
+ * @param reader The reader.
+ * @return 0 on success, -1 on error (ENOENT: no such segment yet, EAGAIN: the segment is being created).
+ */
+
+static int next_segment(struct journal_reader *reader) {
+    uint64_t expected = reader->segment_index + 1;
+    uint64_t first = 0;
+    int found;
+
+    if (0 == map_segment(reader, expected)) {
+        return 0;
+    }
+    if (ENOENT != errno) {
+        return -1;
+    }
+    if (-1 == (found = scan_segments(reader->path, 0, &first))) {
+        return -1;
+    }
+    // Not created yet.
+    if (0 == found || first <= expected) {
+        errno = ENOENT;
+        return -1;
+    }
+    if (-1 == map_segment(reader, first)) {
+        return -1;
+    }
+    reader->skipped += first - expected;
+    return 0;
+}
+
+/**
+ * Read the next record of a journal. The segments deleted before they could be read are skipped (see `skipped`).
+ * @param reader The reader.
+ * @param record The record that receives the next record.
+ * @return 1 if a record has been read, 0 at the end of the journal (for now), -1 on error.
+ */
+
+int journal_reader_next(struct journal_reader *reader, struct journal_record *record) {
+    if (reader->next == reader->capacity) {
+        if (-1 == next_segment(reader)) {
+            return ENOENT == errno || EAGAIN == errno ? 0 : -1;
+        }
+    }
+    if (JOURNAL_EMPTY == __atomic_load_n(&reader->records[reader->next].kind, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    *record = reader->records[reader->next++];
+    return 1;
+}
+
+/**
+ * Close a reader.
+ * @param reader The reader.
+ */
+
+void journal_reader_close(struct journal_reader *reader) {
+    if (NULL != reader->mapping) {
+        munmap(reader->mapping, reader->mapping_size);
+        reader->mapping = NULL;
+    }
+}
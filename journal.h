@@ -0,0 +1,93 @@
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define JOURNAL_MAGIC          "GPIOJNL1"
+#define JOURNAL_VERSION        1
+#define JOURNAL_HEADER_SIZE    64
+#define JOURNAL_SEGMENT_SIZE   (64 * 1024 * 1024)
+#define JOURNAL_PATH_SIZE      256
+
+/** An empty slot: the segments are preallocated with zeros. */
+#define JOURNAL_EMPTY      0
+/** An edge on an input line (`value`: 1 for rising, 0 for falling). */
+#define JOURNAL_EDGE       1
+/** A change of state of an output line (`value`: the new value). */
+#define JOURNAL_TRANSITION 2
+
+/**
+ * Append-only binary journal of edges and transitions.
+ *
+ * The journal is a series of segment files, named `<path>.<index>`. Each segment is preallocated and mapped in
+ * memory: the records are written directly into the mapping (no system call, no copy). When a segment is full, the
+ * writer moves to the next one. If a maximum number of segments is given, the oldest segment is deleted, so that the
+ * journal does not grow without bound.
+ *
+ * A journal has a single writer. The records of a segment are followed by empty (zero) slots: a reader stops at
+ * the first empty slot, so a journal can be read while it is being written, or after a crash.
+ */
+
+struct journal_header {
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t segment_index;
+    /** The sequence number of the first record of the segment. */
+    uint64_t first_sequence;
+    /** The number of records the segment can hold. */
+    uint64_t capacity;
+    uint8_t  reserved[JOURNAL_HEADER_SIZE - 40];
+};
+
+struct journal_record {
+    /** The kernel timestamp of the edge, or the instant of the transition (CLOCK_MONOTONIC, in nano seconds). */
+    int64_t  timestamp;
+    /** The sequence number of the record in the journal (starts at 0, no gap). */
+    uint64_t sequence;
+    uint32_t line_id;
+    uint8_t  kind;
+    uint8_t  value;
+    uint16_t reserved;
+};
+
+struct journal {
+    char                  path[JOURNAL_PATH_SIZE];
+    size_t                segment_size;
+    /** The maximum number of segments kept on disk (0: no limit). */
+    uint64_t              max_segments;
+    uint64_t              segment_index;
+    uint64_t              sequence;
+    struct journal_record *records;
+    uint64_t              capacity;
+    uint64_t              count;
+    void                  *mapping;
+};
+
+int journal_open(struct journal *journal, const char *path, size_t segment_size, uint64_t max_segments);
+int journal_append(struct journal *journal, int64_t timestamp, unsigned int line_id, int kind, int value);
+void journal_close(struct journal *journal);
+
+/**
+ * Sequential reader of a journal. Only one segment is mapped at a time, so the size of a journal is not limited by
+ * the memory.
+ */
+
+struct journal_reader {
+    char                        path[JOURNAL_PATH_SIZE];
+    uint64_t                    segment_index;
+    const struct journal_record *records;
+    uint64_t                    capacity;
+    uint64_t                    next;
+    void                        *mapping;
+    size_t                      mapping_size;
+    /** The number of segments deleted by the writer before they could be read (skipped). */
+    uint64_t                    skipped;
+};
+
+int journal_reader_open(struct journal_reader *reader, const char *path);
+int journal_reader_next(struct journal_reader *reader, struct journal_record *record);
+void journal_reader_close(struct journal_reader *reader);
+
+#endif // JOURNAL_H
@@ -0,0 +1,149 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "journal.h"
+
+// Print the records of one or more journals (see journal.h), merged by timestamp.
+//
+//     $ ./journal_dump /tmp/gpio2-issuer /tmp/gpio2-receiver
+//     $ ./journal_dump -s /tmp/gpio2-receiver
+//
+// The journals are read one segment at a time: their size is not limited by the memory.
+
+#define MAX_JOURNALS 8
+
+struct source {
+    const char            *path;
+    struct journal_reader reader;
+    struct journal_record record;
+    /** 1 if `record` holds the next record of the journal. */
+    int                   pending;
+    long                  count;
+    /** The number of missing sequence numbers. */
+    long                  gaps;
+    /** The number of skipped segments already reported. */
+    uint64_t              skipped;
+    int64_t               first_timestamp;
+    int64_t               last_timestamp;
+};
+
+/**
+ * Print an error message and terminate the program.
+ * @param message The message to print.
+ */
+
+void error(char *message) {
+    fprintf(stderr, "ERROR: %s\n", message);
+    exit(1);
+}
+
+/**
+ * Read the next record of a journal, and update its statistics.
+ * @param source The journal.
+ */
+
+void advance(struct source *source) {
+    uint64_t expected = source->count > 0 ? source->record.sequence + 1 : 0;
+    int status = journal_reader_next(&source->reader, &source->record);
+
+    if (-1 == status) {
+        error("cannot read a journal segment");
+    }
+    if (source->reader.skipped > source->skipped) {
+        fprintf(stderr, "WARNING: %s: %llu segments deleted before they could be read\n", source->path,
+                (unsigned long long)(source->reader.skipped - source->skipped));
+        source->skipped = source->reader.skipped;
+    }
+    source->pending = status;
+    if (!status) {
+        return;
+    }
+    if (0 == source->count) {
+        source->first_timestamp = source->record.timestamp;
+    } else if (source->record.sequence > expected) {
+        source->gaps += (long)(source->record.sequence - expected);
+    }
+    source->last_timestamp = source->record.timestamp;
+    source->count++;
+}
+
+void print_record(const struct source *source) {
+    const struct journal_record *record = &source->record;
+
+    if (JOURNAL_EDGE == record->kind) {
+        printf("%lld %s #%llu line %u edge %s\n", (long long)record->timestamp, source->path,
+               (unsigned long long)record->sequence, record->line_id, record->value ? "rising" : "falling");
+    } else {
+        printf("%lld %s #%llu line %u set %s\n", (long long)record->timestamp, source->path,
+               (unsigned long long)record->sequence, record->line_id, record->value ? "up" : "down");
+    }
+}
+
+void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [-s] journal...\n", program);
+    fprintf(stderr, "  -s: print a summary of each journal instead of the records.\n");
+    fprintf(stderr, "At most %d journals.\n", MAX_JOURNALS);
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    struct source all_sources[MAX_JOURNALS];
+    int count;
+    int summary = 0;
+    int option;
+
+    while (-1 != (option = getopt(argc, argv, "s"))) {
+        switch (option) {
+            case 's': summary = 1; break;
+            default: usage(argv[0]);
+        }
+    }
+    count = argc - optind;
+    if (count < 1 || count > MAX_JOURNALS) {
+        usage(argv[0]);
+    }
+
+    for (int i=0; i<count; i++) {
+        all_sources[i].path    = argv[optind + i];
+        all_sources[i].count   = 0;
+        all_sources[i].gaps    = 0;
+        all_sources[i].skipped = 0;
+        if (-1 == journal_reader_open(&all_sources[i].reader, all_sources[i].path)) {
+            error("cannot open a journal");
+        }
+        advance(&all_sources[i]);
+    }
+
+    // Merge: always print the pending record with the smallest timestamp.
+    for (;;) {
+        struct source *next = NULL;
+
+        for (int i=0; i<count; i++) {
+            if (all_sources[i].pending
+                && (NULL == next || all_sources[i].record.timestamp < next->record.timestamp)) {
+                next = &all_sources[i];
+            }
+        }
+        if (NULL == next) {
+            break;
+        }
+        if (!summary) {
+            print_record(next);
+        }
+        advance(next);
+    }
+
+    for (int i=0; i<count; i++) {
+        struct source *source = &all_sources[i];
+        int64_t span = source->last_timestamp - source->first_timestamp;
+
+        if (summary) {
+            printf("%s: %ld records, %ld missing, %.3f s, %.0f records/s, last segment: %llu, %llu skipped\n",
+                   source->path, source->count, source->gaps, (double)span / 1e9,
+                   span > 0 ? (double)(source->count - 1) * 1e9 / (double)span : 0.0,
+                   (unsigned long long)source->reader.segment_index, (unsigned long long)source->reader.skipped);
+        }
+        journal_reader_close(&source->reader);
+    }
+    return 0;
+}
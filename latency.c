@@ -0,0 +1,99 @@
+#include <stdlib.h>
+#include "timing.h"
+#include "latency.h"
+
+/**
+ * Initialise a probe.
+ * @param probe The probe to initialise.
+ * @param count The number of changes of state of the output.
+ * @return 0 on success, -1 on error.
+ */
+
+int latency_probe_init(struct latency_probe *probe, long count) {
+    probe->issued     = calloc((size_t)count, sizeof(int64_t));
+    probe->count      = count;
+    probe->next_cycle = 1; // Cycle 0 sets the initial value: it does not produce any edge.
+    probe->unmatched  = 0;
+    histogram_init(&probe->loopback);
+    histogram_init(&probe->reflex);
+    return NULL == probe->issued ? -1 : 0;
+}
+
+/**
+ * Free the resources of a probe.
+ * @param probe The probe.
+ */
+
+void latency_probe_terminate(struct latency_probe *probe) {
+    if (NULL != probe) {
+        free(probe->issued);
+    }
+}
+
+/**
+ * Record the time of a change of state. Call it just before the write to the output.
+ * @param probe The probe.
+ * @param cycle The cycle of the change of state.
+ */
+
+void latency_probe_issue(struct latency_probe *probe, long cycle) {
+    if (NULL == probe || cycle < 0 || cycle >= probe->count) {
+        return;
+    }
+    // Released for the receiver, which reads it once the edge has been timestamped by the kernel.
+    __atomic_store_n(&probe->issued[cycle], timing_now(), __ATOMIC_RELEASE);
+}
+
+/**
+ * Match an edge of the input with a change of state, and record the loopback latency.
+ * @param probe The probe.
+ * @param event The edge.
+ */
+
+void latency_probe_receive(struct latency_probe *probe, const struct gpio_event *event) {
+    long cycle;
+    int64_t issued;
+
+    if (NULL == probe) {
+        return;
+    }
+    cycle = probe->next_cycle;
+    if ((cycle & 0x1) != (event->rising != 0)) {
+        cycle++; // An edge has been lost.
+    }
+    probe->next_cycle = cycle + 1;
+
+    issued = cycle < probe->count ? __atomic_load_n(&probe->issued[cycle], __ATOMIC_ACQUIRE) : 0;
+    if (0 == issued || event->timestamp < issued) {
+        probe->unmatched++;
+        return;
+    }
+    histogram_record(&probe->loopback, event->timestamp - issued);
+}
+
+/**
+ * Record the reflex latency. Call it just after the reaction to an edge.
+ * @param probe The probe.
+ * @param edge_timestamp The kernel timestamp of the edge.
+ */
+
+void latency_probe_react(struct latency_probe *probe, int64_t edge_timestamp) {
+    if (NULL != probe) {
+        histogram_record(&probe->reflex, timing_now() - edge_timestamp);
+    }
+}
+
+/**
+ * Print the latency distributions of a probe.
+ * @param stream The stream to print to.
+ * @param probe The probe.
+ */
+
+void latency_probe_print(FILE *stream, const struct latency_probe *probe) {
+    if (NULL == probe) {
+        return;
+    }
+    histogram_print(stream, "loopback latency", &probe->loopback);
+    histogram_print(stream, "reflex latency", &probe->reflex);
+    fprintf(stream, "latency: %ld edges without matching change of state\n", probe->unmatched);
+}
@@ -0,0 +1,43 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "gpio.h"
+#include "histogram.h"
+
+/**
+ * Loopback latency probe.
+ *
+ * With an output line wired to an input line (GPIO16 -> GPIO21, or a gpio-sim line driven through its `pull`
+ * attribute), every change of state of the output produces an edge on the input. The probe records the time of every
+ * change of state, and matches it with the kernel timestamp of the corresponding edge:
+ *
+ *   - loopback latency: from the change of state of the output to the kernel timestamp of the edge.
+ *   - reflex latency: from the kernel timestamp of the edge to the end of the reaction (the write to the controller
+ *     line).
+ *
+ * Change of state `cycle` sets the value `cycle & 1`: a rising edge matches an odd cycle, a falling edge an even one.
+ * This lets the probe resynchronise after a lost edge. All the functions accept a NULL probe, and then do nothing.
+ */
+
+struct latency_probe {
+    /** For every cycle, the time just before the change of state (0: not issued). */
+    int64_t *issued;
+    long    count;
+    /** The cycle expected to match the next edge. */
+    long    next_cycle;
+    /** The number of edges that did not match any change of state. */
+    long    unmatched;
+    struct histogram loopback;
+    struct histogram reflex;
+};
+
+int latency_probe_init(struct latency_probe *probe, long count);
+void latency_probe_terminate(struct latency_probe *probe);
+void latency_probe_issue(struct latency_probe *probe, long cycle);
+void latency_probe_receive(struct latency_probe *probe, const struct gpio_event *event);
+void latency_probe_react(struct latency_probe *probe, int64_t edge_timestamp);
+void latency_probe_print(FILE *stream, const struct latency_probe *probe);
+
+#endif // LATENCY_H
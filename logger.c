@@ -0,0 +1,197 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+#include "timing.h"
+#include "logger.h"
+
+static struct log_buffer ALL_BUFFERS[LOGGER_MAX_THREADS];
+static int ALL_BUFFERS_COUNT = 0;
+static FILE *STREAM = NULL;
+static int MODE = LOGGER_OFF;
+static int STOPPING = 0;
+static pthread_t THREAD;
+
+/**
+ * Parse a logging mode: "off", "sync" or "async".
+ * @param text The text to parse.
+ * @return The mode, or -1 if the text is not valid.
+ */
+
+int logger_parse_mode(const char *text) {
+    if (0 == strcmp(text, "off")) {
+        return LOGGER_OFF;
+    }
+    if (0 == strcmp(text, "sync")) {
+        return LOGGER_SYNC;
+    }
+    if (0 == strcmp(text, "async")) {
+        return LOGGER_ASYNC;
+    }
+    return -1;
+}
+
+/**
+ * Print a record: the instant it was written (in asynchronous mode, it is printed up to a flush period later), then
+ * the message of its formatter.
+ * @param record The record.
+ */
+
+static void print_record(const struct log_record *record) {
+    fprintf(STREAM, "[%lld.%06lld] ", (long long)(record->timestamp / NSEC_PER_SEC),
+            (long long)(record->timestamp % NSEC_PER_SEC / 1000));
+    record->formatter(STREAM, record);
+}
+
+/**
+ * Format and print the pending records of a buffer.
+ * @param buffer The buffer.
+ * @return The number of records printed.
+ */
+
+static long drain(struct log_buffer *buffer) {
+    size_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+    size_t tail = buffer->tail;
+    long count = (long)(head - tail);
+
+    for (; tail != head; tail++) {
+        print_record(&buffer->records[tail & (LOGGER_BUFFER_SIZE - 1)]);
+    }
+    __atomic_store_n(&buffer->tail, tail, __ATOMIC_RELEASE);
+    return count;
+}
+
+static void* logger_thread(void *in_args) {
+    int64_t deadline = timing_now();
+
+    (void)in_args;
+    for (;;) {
+        int stopping = __atomic_load_n(&STOPPING, __ATOMIC_ACQUIRE);
+        int count = __atomic_load_n(&ALL_BUFFERS_COUNT, __ATOMIC_ACQUIRE);
+        long printed = 0;
+
+        if (count > LOGGER_MAX_THREADS) {
+            count = LOGGER_MAX_THREADS;
+        }
+        for (int i=0; i<count; i++) {
+            printed += drain(&ALL_BUFFERS[i]);
+        }
+        if (printed > 0) {
+            fflush(STREAM);
+        }
+        if (stopping) {
+            return NULL;
+        }
+        deadline += LOGGER_FLUSH_PERIOD;
+        timing_sleep_until(deadline);
+    }
+}
+
+/**
+ * Start the logger.
+ * In asynchronous mode, this function starts the background thread: call it after `stats_start_signal_thread()`.
+ * @param stream The stream the records are printed to.
+ * @param mode The mode: `LOGGER_OFF`, `LOGGER_SYNC` or `LOGGER_ASYNC`.
+ * @return 0 on success, -1 on error.
+ */
+
+int logger_start(FILE *stream, int mode) {
+    int status;
+
+    STREAM = stream;
+    MODE   = mode;
+    __atomic_store_n(&STOPPING, 0, __ATOMIC_RELEASE);
+    if (LOGGER_ASYNC != mode) {
+        return 0;
+    }
+    if (0 != (status = pthread_create(&THREAD, NULL, &logger_thread, NULL))) {
+        errno = status;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Register the calling thread. This function must be called before the hot path of the thread.
+ * @return The buffer of the thread, or NULL if the logger is off or too many threads are registered (then, the
+ *         records of the thread are discarded).
+ */
+
+struct log_buffer *logger_register(void) {
+    int index;
+
+    if (LOGGER_OFF == MODE) {
+        return NULL;
+    }
+    index = __atomic_fetch_add(&ALL_BUFFERS_COUNT, 1, __ATOMIC_ACQ_REL);
+    return index < LOGGER_MAX_THREADS ? &ALL_BUFFERS[index] : NULL;
+}
+
+/**
+ * Log a record. In asynchronous mode, this function neither blocks nor performs any system call.
+ * @param buffer The buffer of the calling thread. If NULL, the record is discarded.
+ * @param formatter The function that formats the record.
+ * @param cycle The cycle.
+ * @param line_id The (GPIO) line ID.
+ * @param value The value of the line.
+ * @param extra A value specific to the record.
+ */
+
+void log_write(struct log_buffer *buffer, log_formatter formatter, long cycle, int line_id, int value,
+               int64_t extra) {
+    struct log_record *record;
+    struct log_record sync_record;
+    size_t head;
+
+    if (NULL == buffer) {
+        return;
+    }
+    if (LOGGER_SYNC == MODE) {
+        record = &sync_record;
+    } else {
+        head = buffer->head;
+        if (head - __atomic_load_n(&buffer->tail, __ATOMIC_ACQUIRE) >= LOGGER_BUFFER_SIZE) {
+            __atomic_store_n(&buffer->dropped, buffer->dropped + 1, __ATOMIC_RELAXED);
+            return;
+        }
+        record = &buffer->records[head & (LOGGER_BUFFER_SIZE - 1)];
+    }
+
+    record->formatter = formatter;
+    record->timestamp = timing_now();
+    record->cycle     = cycle;
+    record->extra     = extra;
+    record->line_id   = line_id;
+    record->value     = value;
+
+    if (LOGGER_SYNC == MODE) {
+        print_record(record);
+    } else {
+        __atomic_store_n(&buffer->head, head + 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Stop the logger: in asynchronous mode, print the pending records and stop the background thread.
+ */
+
+void logger_stop(void) {
+    long dropped = 0;
+    int count = __atomic_load_n(&ALL_BUFFERS_COUNT, __ATOMIC_ACQUIRE);
+
+    if (LOGGER_ASYNC != MODE) {
+        return;
+    }
+    __atomic_store_n(&STOPPING, 1, __ATOMIC_RELEASE);
+    pthread_join(THREAD, NULL);
+
+    if (count > LOGGER_MAX_THREADS) {
+        count = LOGGER_MAX_THREADS;
+    }
+    for (int i=0; i<count; i++) {
+        dropped += __atomic_load_n(&ALL_BUFFERS[i].dropped, __ATOMIC_RELAXED);
+    }
+    if (dropped > 0) {
+        fprintf(STREAM, "logger: %ld records dropped (buffers full)\n", dropped);
+    }
+    fflush(STREAM);
+}
@@ -0,0 +1,65 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/** The maximum number of threads that can log. */
+#define LOGGER_MAX_THREADS 32
+/** The number of records of the buffer of a thread (a power of two). */
+#define LOGGER_BUFFER_SIZE 1024
+/** The period of the background thread (in nano seconds). */
+#define LOGGER_FLUSH_PERIOD 10000000
+
+/** The records are discarded. */
+#define LOGGER_OFF   0
+/** The records are formatted and printed by the thread that logs them (the behaviour of printf). */
+#define LOGGER_SYNC  1
+/** The records are formatted and printed by a background thread. */
+#define LOGGER_ASYNC 2
+
+struct log_record;
+
+/**
+ * Function that formats a record.
+ * @param stream The stream to print to.
+ * @param record The record.
+ */
+
+typedef void (*log_formatter)(FILE *stream, const struct log_record *record);
+
+/**
+ * Fixed-size binary record. The formatting takes place later, out of the hot path.
+ */
+
+struct log_record {
+    log_formatter formatter;
+    /** The instant the record was written (CLOCK_MONOTONIC, in nano seconds), printed before the message. */
+    int64_t       timestamp;
+    long          cycle;
+    /** A value specific to the record (ex: a lateness, a number of events). */
+    int64_t       extra;
+    int           line_id;
+    int           value;
+};
+
+/**
+ * Buffer of the records of one thread: a lock-free single-producer (the thread)/single-consumer (the background
+ * thread) ring. When the ring is full, the records are dropped, so that logging never blocks.
+ */
+
+struct log_buffer {
+    size_t head __attribute__((aligned(64)));
+    long   dropped;
+    size_t tail __attribute__((aligned(64)));
+    struct log_record records[LOGGER_BUFFER_SIZE] __attribute__((aligned(64)));
+};
+
+int logger_parse_mode(const char *text);
+int logger_start(FILE *stream, int mode);
+struct log_buffer *logger_register(void);
+void log_write(struct log_buffer *buffer, log_formatter formatter, long cycle, int line_id, int value,
+               int64_t extra);
+void logger_stop(void);
+
+#endif // LOGGER_H
@@ -0,0 +1,233 @@
+#include <errno.h>
+#include <stdlib.h>
+#include "monitor.h"
+
+/**
+ * Initialise a monitor.
+ * @param monitor The monitor to initialise.
+ * @param capacity The maximum number of lines.
+ * @return 0 on success, -1 on error.
+ */
+
+int monitor_init(struct monitor *monitor, int capacity) {
+    monitor->input      = NULL;
+    monitor->chip       = NULL;
+    monitor->consumer   = NULL;
+    monitor->count      = 0;
+    monitor->capacity   = capacity;
+    monitor->table      = NULL;
+    monitor->table_size = 0;
+    monitor->events     = NULL;
+    monitor->batch_size = 0;
+    monitor->unhandled  = 0;
+    monitor->entries    = calloc((size_t)capacity, sizeof(struct monitor_entry));
+    return NULL == monitor->entries ? -1 : 0;
+}
+
+/**
+ * Add a line to a monitor. The lines must be added before the monitor is started.
+ * @param monitor The monitor.
+ * @param offset The offset of the line.
+ * @param handler The function called for every edge of the line.
+ * @param context The context passed to the handler.
+ * @return 0 on success, -1 on error (too many lines, or line already monitored).
+ */
+
+int monitor_add(struct monitor *monitor, unsigned int offset, monitor_handler handler, void *context) {
+    if (NULL != monitor->input) {
+        errno = EBUSY;
+        return -1;
+    }
+    if (monitor->count >= monitor->capacity) {
+        errno = ENOSPC;
+        return -1;
+    }
+    for (int i=0; i<monitor->count; i++) {
+        if (monitor->entries[i].offset == offset) {
+            errno = EEXIST;
+            return -1;
+        }
+    }
+    monitor->entries[monitor->count].offset  = offset;
+    monitor->entries[monitor->count].handler = handler;
+    monitor->entries[monitor->count].context = context;
+    monitor->count++;
+    return 0;
+}
+
+/**
+ * Request the lines of a monitor.
+ * @param monitor The monitor.
+ * @param batch_size The maximum number of events read at once (and the size of the kernel queue).
+ * @return 0 on success, -1 on error.
+ */
+
+static int request(struct monitor *monitor, int batch_size) {
+    unsigned int *offsets = calloc((size_t)monitor->count, sizeof(unsigned int));
+
+    if (NULL == offsets) {
+        return -1;
+    }
+    for (int i=0; i<monitor->count; i++) {
+        offsets[i] = monitor->entries[i].offset;
+    }
+    monitor->input = gpio_input_request(monitor->chip, monitor->consumer, offsets, monitor->count, batch_size);
+    free(offsets);
+    return NULL == monitor->input ? -1 : 0;
+}
+
+/**
+ * Request the lines of a monitor and build its dispatch table.
+ * @param monitor The monitor.
+ * @param chip The chip.
+ * @param consumer The name of the consumer (it must remain valid until the monitor is terminated).
+ * @param batch_size The maximum number of events read at once.
+ * @return 0 on success, -1 on error.
+ */
+
+int monitor_start(struct monitor *monitor, struct gpio_chip *chip, const char *consumer, int batch_size) {
+    monitor->table_size = 0;
+    for (int i=0; i<monitor->count; i++) {
+        if (monitor->entries[i].offset >= monitor->table_size) {
+            monitor->table_size = monitor->entries[i].offset + 1;
+        }
+    }
+
+    monitor->chip       = chip;
+    monitor->consumer   = consumer;
+    monitor->batch_size = batch_size;
+    monitor->events     = calloc((size_t)batch_size, sizeof(struct gpio_event));
+    monitor->table      = calloc(monitor->table_size, sizeof(struct monitor_entry));
+    if (NULL == monitor->events || NULL == monitor->table) {
+        return -1;
+    }
+    for (int i=0; i<monitor->count; i++) {
+        monitor->table[monitor->entries[i].offset] = monitor->entries[i];
+    }
+
+    if (-1 == request(monitor, batch_size)) {
+        return -1;
+    }
+    event_counters_init(&monitor->counters, gpio_input_batch_size(monitor->input));
+    return 0;
+}
+
+/**
+ * Return the file descriptor that becomes readable when edges are pending on any of the lines.
+ * @param monitor The monitor.
+ * @return The file descriptor.
+ */
+
+int monitor_fd(struct monitor *monitor) {
+    return gpio_input_fd(monitor->input);
+}
+
+/**
+ * Wait for edges on any of the lines.
+ * @param monitor The monitor.
+ * @param timeout The maximum time to wait, in nano seconds. If negative, the function waits indefinitely.
+ * @return 1 if edges are pending, 0 on timeout, -1 on error.
+ */
+
+int monitor_wait(struct monitor *monitor, int64_t timeout) {
+    return gpio_input_wait(monitor->input, timeout);
+}
+
+/**
+ * Read the pending edges (in `monitor->events`), without dispatching them.
+ * @param monitor The monitor.
+ * @return The number of edges read, or -1 on error.
+ */
+
+int monitor_read(struct monitor *monitor) {
+    int count = gpio_input_read(monitor->input, monitor->events, monitor->batch_size);
+
+    if (count > 0) {
+        event_counters_update(&monitor->counters, monitor->events, count);
+    }
+    return count;
+}
+
+/**
+ * Size the event buffer after the bursts observed so far (see `event_counters_recommended_size()`). If the queue
+ * has been found deeper than half of its size, the lines are requested again with a larger buffer, up to
+ * MONITOR_MAX_BUFFER_SIZE. The edges that occur while the lines are requested again are lost, and the file
+ * descriptor of the monitor changes: do not call it while the descriptor is watched (ex: by a reactor).
+ * @param monitor The monitor.
+ * @return 1 if the buffer has been enlarged, 0 if it is kept, or -1 on error (the lines are released).
+ */
+
+int monitor_adapt(struct monitor *monitor) {
+    int size = event_counters_recommended_size(&monitor->counters, MONITOR_MAX_BUFFER_SIZE);
+    struct gpio_event *events;
+
+    if (size <= monitor->batch_size) {
+        return 0;
+    }
+    events = realloc(monitor->events, (size_t)size * sizeof(struct gpio_event));
+    if (NULL == events) {
+        return -1;
+    }
+    monitor->events     = events;
+    monitor->batch_size = size;
+    gpio_input_release(monitor->input);
+    monitor->input = NULL;
+    if (-1 == request(monitor, size)) {
+        return -1;
+    }
+    event_counters_restart(&monitor->counters, gpio_input_batch_size(monitor->input));
+    return 1;
+}
+
+/**
+ * Dispatch edges to the handlers of their lines.
+ * @param monitor The monitor.
+ * @param events The edges.
+ * @param count The number of edges.
+ */
+
+void monitor_dispatch(struct monitor *monitor, const struct gpio_event *events, int count) {
+    for (int i=0; i<count; i++) {
+        const struct monitor_entry *entry;
+
+        if (events[i].offset >= monitor->table_size
+            || NULL == (entry = &monitor->table[events[i].offset])->handler) {
+            monitor->unhandled++;
+            continue;
+        }
+        entry->handler(entry->context, &events[i]);
+    }
+}
+
+/**
+ * Read the pending edges and dispatch them.
+ * @param monitor The monitor.
+ * @return The number of edges, or -1 on error.
+ */
+
+int monitor_process(struct monitor *monitor) {
+    int count = monitor_read(monitor);
+
+    if (count > 0) {
+        monitor_dispatch(monitor, monitor->events, count);
+    }
+    return count;
+}
+
+/**
+ * Release the lines and free the resources of a monitor.
+ * @param monitor The monitor.
+ */
+
+void monitor_terminate(struct monitor *monitor) {
+    if (NULL != monitor->input) {
+        gpio_input_release(monitor->input);
+        monitor->input = NULL;
+    }
+    free(monitor->events);
+    free(monitor->table);
+    free(monitor->entries);
+    monitor->events  = NULL;
+    monitor->table   = NULL;
+    monitor->entries = NULL;
+}
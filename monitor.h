@@ -0,0 +1,64 @@
+#ifndef MONITOR_H
+#define MONITOR_H
+
+#include <stdint.h>
+#include "gpio.h"
+#include "event_counters.h"
+
+/** The greatest event buffer of the kernel (16 events per line, for 64 lines). See `monitor_adapt()`. */
+#define MONITOR_MAX_BUFFER_SIZE 1024
+
+/**
+ * Function called for every edge of a monitored line.
+ * @param context The context given to `monitor_add()`.
+ * @param event The edge.
+ */
+
+typedef void (*monitor_handler)(void *context, const struct gpio_event *event);
+
+struct monitor_entry {
+    unsigned int    offset;
+    monitor_handler handler;
+    void            *context;
+};
+
+/**
+ * Monitor of many input lines, from a single thread.
+ *
+ * All the lines are requested at once: they share a single file descriptor (see `gpio_input_fd()`), whatever their
+ * number. The edges are read in batches and dispatched to the handlers through a table indexed by the offsets of
+ * the lines, so that adding a line costs neither a thread nor a search.
+ */
+
+struct monitor {
+    struct gpio_input    *input;
+    /** The chip and the consumer name of the request (to request the lines again, see `monitor_adapt()`). */
+    struct gpio_chip     *chip;
+    const char           *consumer;
+    /** The lines, in the order of registration. */
+    struct monitor_entry *entries;
+    int                  count;
+    int                  capacity;
+    /** The dispatch table: `table[offset]`, for all offsets up to the greatest monitored offset. */
+    struct monitor_entry *table;
+    unsigned int         table_size;
+    /** The buffer that receives the events. */
+    struct gpio_event    *events;
+    int                  batch_size;
+    /** The number of edges of lines without handler. */
+    long                 unhandled;
+    struct event_counters counters;
+};
+
+int monitor_init(struct monitor *monitor, int capacity);
+int monitor_add(struct monitor *monitor, unsigned int offset, monitor_handler handler, void *context);
+int monitor_start(struct monitor *monitor, struct gpio_chip *chip, const char *consumer, int batch_size);
+int monitor_fd(struct monitor *monitor);
+int monitor_wait(struct monitor *monitor, int64_t timeout);
+int monitor_read(struct monitor *monitor);
+int monitor_adapt(struct monitor *monitor);
+void monitor_dispatch(struct monitor *monitor, const struct gpio_event *events, int count);
+int monitor_process(struct monitor *monitor);
+void monitor_terminate(struct monitor *monitor);
+
+#endif // MONITOR_H
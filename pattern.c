@@ -0,0 +1,361 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+#include "pattern.h"
+
+/**
+ * Initialise an empty pattern.
+ * @param pattern The pattern to initialise.
+ * @param line_ids The (GPIO) line IDs of the pattern: the line of index N is `line_ids[N]`.
+ * @param line_count The number of lines (at most PATTERN_MAX_LINES).
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pattern_init(struct pattern *pattern, const int *line_ids, int line_count) {
+    if (line_count < 1 || line_count > PATTERN_MAX_LINES) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (int i=0; i<line_count; i++) {
+        pattern->line_ids[i] = line_ids[i];
+    }
+    pattern->line_count   = line_count;
+    pattern->steps        = NULL;
+    pattern->size         = 0;
+    pattern->capacity     = 0;
+    pattern->length       = 0;
+    pattern->entries      = NULL;
+    pattern->write_lines  = NULL;
+    pattern->write_values = NULL;
+    return 0;
+}
+
+/**
+ * Append a step to a pattern. The steps must be added in the order of their offsets. A step with the same offset
+ * as the previous one is merged into it.
+ * @param pattern The pattern.
+ * @param offset The offset of the step from the beginning of the pattern, in nano seconds.
+ * @param mask The lines that change (bit N is the line of index N).
+ * @param values The new values of the lines of `mask`.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pattern_add(struct pattern *pattern, int64_t offset, uint32_t mask, uint32_t values) {
+    struct pattern_step *last = pattern->size > 0 ? &pattern->steps[pattern->size - 1] : NULL;
+
+    if (offset < 0 || (NULL != last && offset < last->offset)
+        || (pattern->line_count < PATTERN_MAX_LINES && 0 != (mask >> pattern->line_count))) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (NULL != last && offset == last->offset) {
+        last->mask  |= mask;
+        last->values = (last->values & ~mask) | (values & mask);
+        return 0;
+    }
+    if (pattern->size == pattern->capacity) {
+        size_t capacity = 0 == pattern->capacity ? 16 : 2 * pattern->capacity;
+        struct pattern_step *steps = realloc(pattern->steps, capacity * sizeof(struct pattern_step));
+
+        if (NULL == steps) {
+            errno = ENOMEM;
+            return -1;
+        }
+        pattern->steps    = steps;
+        pattern->capacity = capacity;
+    }
+    pattern->steps[pattern->size].offset = offset;
+    pattern->steps[pattern->size].mask   = mask;
+    pattern->steps[pattern->size].values = values & mask;
+    pattern->size++;
+    return 0;
+}
+
+/**
+ * Append the steps described by a text to a pattern. Each line describes a step: its offset, then the new values
+ * of the lines that change, as `<index>=<value>`. Empty lines and lines that start with '#' are ignored.
+ *
+ *     # Green (0) and red (1) LEDs.
+ *     0     0=1 1=0
+ *     250ms 0=0 1=1
+ *     500ms 1=0
+ *
+ * @param pattern The pattern.
+ * @param text The text to parse.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pattern_parse(struct pattern *pattern, const char *text) {
+    while ('\0' != *text) {
+        const char *end = strchr(text, '\n');
+        const char *cursor = text;
+        int64_t offset;
+        uint32_t mask = 0, values = 0;
+
+        if (NULL == end) {
+            end = text + strlen(text);
+        }
+        while (cursor < end && (' ' == *cursor || '\t' == *cursor || '\r' == *cursor)) {
+            cursor++;
+        }
+        if (cursor < end && '#' != *cursor) {
+            if (NULL == (cursor = timing_parse_duration(cursor, &offset))) {
+                errno = EINVAL;
+                return -1;
+            }
+            for (;;) {
+                char *next;
+                long index, value;
+
+                while (cursor < end && (' ' == *cursor || '\t' == *cursor || '\r' == *cursor)) {
+                    cursor++;
+                }
+                if (cursor >= end) {
+                    break;
+                }
+                index = strtol(cursor, &next, 10);
+                if (next == cursor || '=' != *next || index < 0 || index >= pattern->line_count) {
+                    errno = EINVAL;
+                    return -1;
+                }
+                cursor = next + 1;
+                value = strtol(cursor, &next, 10);
+                if (next == cursor || (0 != value && 1 != value)) {
+                    errno = EINVAL;
+                    return -1;
+                }
+                cursor  = next;
+                mask   |= 1U << index;
+                values  = (values & ~(1U << index)) | ((uint32_t)value << index);
+            }
+            if (-1 == pattern_add(pattern, offset, mask, values)) {
+                return -1;
+            }
+        }
+        text = '\0' == *end ? end : end + 1;
+    }
+    return 0;
+}
+
+/**
+ * Compile a pattern: expand the masks of the steps into arrays of writes, ready to be passed to the backend.
+ * The pattern can be recompiled after new steps have been added.
+ * @param pattern The pattern.
+ * @param length The duration of one pass, in nano seconds (0: the offset of the last step). It cannot be less than
+ *        the offset of the last step.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pattern_compile(struct pattern *pattern, int64_t length) {
+    size_t writes = 0;
+    uint32_t first = 0;
+
+    if (0 == pattern->size || length < 0
+        || (length > 0 && length < pattern->steps[pattern->size - 1].offset)) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i=0; i<pattern->size; i++) {
+        writes += (size_t)__builtin_popcount(pattern->steps[i].mask);
+    }
+
+    free(pattern->entries);
+    free(pattern->write_lines);
+    free(pattern->write_values);
+    pattern->entries      = calloc(pattern->size, sizeof(struct pattern_entry));
+    pattern->write_lines  = calloc(writes > 0 ? writes : 1, sizeof(int));
+    pattern->write_values = calloc(writes > 0 ? writes : 1, sizeof(int));
+    if (NULL == pattern->entries || NULL == pattern->write_lines || NULL == pattern->write_values) {
+        free(pattern->entries);
+        free(pattern->write_lines);
+        free(pattern->write_values);
+        pattern->entries      = NULL;
+        pattern->write_lines  = NULL;
+        pattern->write_values = NULL;
+        errno = ENOMEM;
+        return -1;
+    }
+
+    for (size_t i=0; i<pattern->size; i++) {
+        const struct pattern_step *step = &pattern->steps[i];
+
+        pattern->entries[i].offset = step->offset;
+        pattern->entries[i].first  = first;
+        for (int line=0; line<pattern->line_count; line++) {
+            if (step->mask & (1U << line)) {
+                pattern->write_lines[first]  = pattern->line_ids[line];
+                pattern->write_values[first] = (step->values >> line) & 0x1;
+                first++;
+            }
+        }
+        pattern->entries[i].count = first - pattern->entries[i].first;
+    }
+    pattern->length = 0 == length ? pattern->steps[pattern->size - 1].offset : length;
+    return 0;
+}
+
+/**
+ * Free the resources allocated by a pattern.
+ * @param pattern The pattern.
+ */
+
+void pattern_terminate(struct pattern *pattern) {
+    free(pattern->steps);
+    free(pattern->entries);
+    free(pattern->write_lines);
+    free(pattern->write_values);
+    pattern->steps        = NULL;
+    pattern->entries      = NULL;
+    pattern->write_lines  = NULL;
+    pattern->write_values = NULL;
+    pattern->size         = 0;
+    pattern->capacity     = 0;
+}
+
+// ---------------------------------------------------------------------------------
+// PLAYBACK
+// ---------------------------------------------------------------------------------
+
+/**
+ * Initialise a player.
+ * @param player The player to initialise.
+ * @param pattern The compiled pattern to play.
+ * @param backend The object used to change the value of the lines.
+ * @param spin_margin The busy-wait margin of the precision timing mode (0: sleep only).
+ */
+
+void pattern_player_init(struct pattern_player *player, const struct pattern *pattern,
+                         const struct output_backend *backend, int64_t spin_margin) {
+    player->pattern     = pattern;
+    player->backend     = *backend;
+    player->spin_margin = spin_margin;
+    player->stop        = 0;
+    player->passes      = 0;
+    player->steps       = 0;
+    player->commits     = 0;
+    player->overruns    = 0;
+    histogram_init(&player->lateness);
+}
+
+static int commit(struct pattern_player *player, const struct pattern_entry *entry) {
+    const struct pattern *pattern = player->pattern;
+    struct output_backend *backend = &player->backend;
+
+    if (0 == entry->count) {
+        return 0;
+    }
+    if (NULL != backend->set_values) {
+        player->commits++;
+        return backend->set_values(backend->context, (int)entry->count, &pattern->write_lines[entry->first],
+                                   &pattern->write_values[entry->first]);
+    }
+    for (uint32_t i=entry->first; i<entry->first + entry->count; i++) {
+        player->commits++;
+        if (-1 == backend->set_value(backend->context, pattern->write_lines[i], pattern->write_values[i])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Play one pass of the pattern.
+ * @param player The player.
+ * @param start The beginning of the pass.
+ * @param next_start The beginning of the next pass (INT64_MAX: none), used to detect the overruns.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+static int play_pass(struct pattern_player *player, int64_t start, int64_t next_start) {
+    const struct pattern *pattern = player->pattern;
+
+    for (size_t i=0; i<pattern->size; i++) {
+        const struct pattern_entry *entry = &pattern->entries[i];
+        int64_t deadline = start + entry->offset;
+        int64_t next = i + 1 < pattern->size ? start + pattern->entries[i + 1].offset
+                                             : (INT64_MAX == next_start ? INT64_MAX
+                                                                        : next_start + pattern->entries[0].offset);
+        int64_t done;
+
+        if (-1 == timing_sleep_until_precise(deadline, player->spin_margin) || -1 == commit(player, entry)) {
+            return -1;
+        }
+        done = timing_now();
+        histogram_record(&player->lateness, done - deadline);
+        if (done > next) {
+            player->overruns++;
+        }
+    }
+    player->steps += (long)pattern->size;
+    player->passes++;
+    return 0;
+}
+
+/**
+ * Play a compiled pattern, once (one-shot) or in a loop.
+ * @param player The player.
+ * @param epoch The beginning of the first pass (see `timing_now()`).
+ * @param passes The number of passes (1: one-shot), or PATTERN_FOREVER to loop until `pattern_player_stop()` is
+ *        called. Looping requires a pattern whose length is not 0.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pattern_play(struct pattern_player *player, int64_t epoch, long passes) {
+    int64_t length = player->pattern->length;
+
+    if (NULL == player->pattern->entries || passes < 0 || (1 != passes && 0 == length)) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (long pass=0; PATTERN_FOREVER == passes || pass < passes; pass++) {
+        int64_t start = epoch + pass * length;
+        int last = pass + 1 == passes;
+
+        if (__atomic_load_n(&player->stop, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        if (-1 == play_pass(player, start, last ? INT64_MAX : start + length)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Play a compiled pattern once per trigger (ex: an edge on an input line, a command...).
+ * @param player The player.
+ * @param trigger The function that waits for the next trigger (see `pattern_trigger`).
+ * @param context Opaque data passed to `trigger`.
+ * @return Upon successful completion (the trigger function has returned 0, or `pattern_player_stop()` has been
+ *         called), the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pattern_play_triggered(struct pattern_player *player, pattern_trigger trigger, void *context) {
+    if (NULL == player->pattern->entries) {
+        errno = EINVAL;
+        return -1;
+    }
+    while (!__atomic_load_n(&player->stop, __ATOMIC_ACQUIRE)) {
+        int64_t start;
+        int status = trigger(context, &start);
+
+        if (1 != status) {
+            return status;
+        }
+        if (-1 == play_pass(player, start, INT64_MAX)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Stop a looping or triggered playback, at the end of the current pass. This function can be called from any
+ * thread.
+ * @param player The player.
+ */
+
+void pattern_player_stop(struct pattern_player *player) {
+    __atomic_store_n(&player->stop, 1, __ATOMIC_RELEASE);
+}
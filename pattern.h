@@ -0,0 +1,104 @@
+#ifndef PATTERN_H
+#define PATTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+#include "scheduler.h"
+
+/** The maximum number of lines of a pattern (the size of the masks). */
+#define PATTERN_MAX_LINES 32
+
+/** Value of `passes` (see `pattern_play()`): loop until `pattern_player_stop()` is called. */
+#define PATTERN_FOREVER 0
+
+/**
+ * A step of a pattern: at `offset` nano seconds from the beginning of the pattern, the lines of `mask` take the
+ * values of `values` (bit N is the line of index N in the pattern). The other lines keep their values.
+ */
+
+struct pattern_step {
+    int64_t  offset;
+    uint32_t mask;
+    uint32_t values;
+};
+
+/**
+ * A compiled step: the writes of the step are `write_lines[first]`...`write_lines[first + count - 1]`.
+ */
+
+struct pattern_entry {
+    int64_t  offset;
+    uint32_t first;
+    uint32_t count;
+};
+
+/**
+ * A multi-line waveform (protocol preamble, test vector, LED animation...).
+ *
+ * The pattern is built step by step (see `pattern_add()` and `pattern_parse()`), then compiled ahead of time into
+ * a compact array of entries, whose writes are ready to be passed to `output_backend.set_values()`: the playback
+ * loop does not interpret the masks.
+ */
+
+struct pattern {
+    /** The (GPIO) line IDs of the pattern, by index. */
+    int     line_ids[PATTERN_MAX_LINES];
+    int     line_count;
+    /** The steps, sorted by offset (two steps never have the same offset). */
+    struct pattern_step *steps;
+    size_t  size;
+    size_t  capacity;
+    /** The duration of one pass, in nano seconds: a loop starts the next pass `length` after the previous one. */
+    int64_t length;
+    /** The compiled steps (NULL until `pattern_compile()` is called). */
+    struct pattern_entry *entries;
+    int     *write_lines;
+    int     *write_values;
+};
+
+/**
+ * Plays a compiled pattern with absolute deadlines: the step N of the pass P is due at
+ * `start + P * length + offset(N)`, whatever the time taken by the previous writes.
+ */
+
+struct pattern_player {
+    const struct pattern  *pattern;
+    struct output_backend backend;
+    /** The busy-wait margin of the precision timing mode (0: sleep only). See `timing_calibrate()`. */
+    int64_t spin_margin;
+    /** Set by `pattern_player_stop()`. */
+    int     stop;
+    /** The number of passes. */
+    long    passes;
+    /** The number of steps. */
+    long    steps;
+    /** The number of calls to the backend. */
+    long    commits;
+    /** The number of steps committed after the deadline of the next step (the step rate was not sustained). */
+    long    overruns;
+    /** The lateness of the steps: from their deadline to the completion of their commit (in nano seconds). */
+    struct histogram lateness;
+};
+
+/**
+ * Wait for the trigger of a pass (see `pattern_play_triggered()`).
+ * Must return 1 and set `start` (the beginning of the pass) to play a pass, 0 to stop the playback, or -1 in
+ * case of error.
+ */
+
+typedef int (*pattern_trigger)(void *context, int64_t *start);
+
+int pattern_init(struct pattern *pattern, const int *line_ids, int line_count);
+int pattern_add(struct pattern *pattern, int64_t offset, uint32_t mask, uint32_t values);
+int pattern_parse(struct pattern *pattern, const char *text);
+int pattern_compile(struct pattern *pattern, int64_t length);
+void pattern_terminate(struct pattern *pattern);
+
+void pattern_player_init(struct pattern_player *player, const struct pattern *pattern,
+                         const struct output_backend *backend, int64_t spin_margin);
+int pattern_play(struct pattern_player *player, int64_t epoch, long passes);
+int pattern_play_triggered(struct pattern_player *player, pattern_trigger trigger, void *context);
+void pattern_player_stop(struct pattern_player *player);
+
+#endif // PATTERN_H
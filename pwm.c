@@ -0,0 +1,261 @@
+#include <errno.h>
+#include <stdlib.h>
+#include "timing.h"
+#include "pwm.h"
+
+static int64_t key(const struct pwm *pwm, size_t heap_index) {
+    return pwm->channels[pwm->heap[heap_index]].next;
+}
+
+static void sift_down(struct pwm *pwm, size_t i) {
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t smallest = i;
+        size_t tmp;
+
+        if (left < pwm->size && key(pwm, left) < key(pwm, smallest)) {
+            smallest = left;
+        }
+        if (left + 1 < pwm->size && key(pwm, left + 1) < key(pwm, smallest)) {
+            smallest = left + 1;
+        }
+        if (smallest == i) {
+            break;
+        }
+        tmp = pwm->heap[smallest];
+        pwm->heap[smallest] = pwm->heap[i];
+        pwm->heap[i] = tmp;
+        i = smallest;
+    }
+}
+
+static int commit(struct pwm *pwm, int count) {
+    struct output_backend *backend = &pwm->backend;
+
+    if (0 == count) {
+        return 0;
+    }
+    if (NULL != backend->set_values) {
+        pwm->commits++;
+        return backend->set_values(backend->context, count, pwm->due_lines, pwm->due_values);
+    }
+    for (int i=0; i<count; i++) {
+        pwm->commits++;
+        if (-1 == backend->set_value(backend->context, pwm->due_lines[i], pwm->due_values[i])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Move a channel to its next edge.
+ * @param channel The channel.
+ * @return The value of the line after the edge.
+ */
+
+static int advance(struct pwm_channel *channel) {
+    if (channel->falling) {
+        channel->falling = 0;
+        channel->start  += channel->period;
+        channel->next    = channel->start;
+        return 0;
+    }
+
+    // Beginning of a period: this is where a new duty cycle takes effect.
+    channel->high = __atomic_load_n(&channel->next_high, __ATOMIC_RELAXED);
+    if (channel->high > 0 && channel->high < channel->period) {
+        channel->falling = 1;
+        channel->next    = channel->start + channel->high;
+        return 1;
+    }
+    channel->start += channel->period;
+    channel->next   = channel->start;
+    return channel->high > 0;
+}
+
+/** Collect the edges that are due, commit them and reschedule their channels. */
+static int serve(struct pwm *pwm, int64_t now) {
+    int count = 0;
+    int64_t done;
+
+    while (key(pwm, 0) <= now) {
+        struct pwm_channel *channel = &pwm->channels[pwm->heap[0]];
+        int64_t deadline = channel->next;
+        int value = advance(channel);
+
+        // When the engine is late, a channel may go through several edges at once: only the last value is written.
+        if (-1 != channel->due) {
+            pwm->due_values[channel->due] = value;
+            channel->level = value;
+        } else if (value != channel->level) {
+            channel->level            = value;
+            channel->due              = count;
+            pwm->due_channels[count]  = pwm->heap[0];
+            pwm->due_deadlines[count] = deadline;
+            pwm->due_lines[count]     = channel->line_id;
+            pwm->due_values[count]    = value;
+            count++;
+        }
+        sift_down(pwm, 0);
+    }
+
+    if (-1 == commit(pwm, count)) {
+        return -1;
+    }
+    done = timing_now();
+    for (int i=0; i<count; i++) {
+        histogram_record(&pwm->lateness, done - pwm->due_deadlines[i]);
+    }
+    for (int i=0; i<count; i++) {
+        pwm->channels[pwm->due_channels[i]].due = -1;
+    }
+    pwm->edges += count;
+    return 0;
+}
+
+/**
+ * Initialise a PWM engine.
+ * @param pwm The engine to initialise.
+ * @param capacity The maximum number of channels.
+ * @param backend The object used to change the value of the lines.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pwm_init(struct pwm *pwm, size_t capacity, const struct output_backend *backend) {
+    pwm->channels      = calloc(capacity, sizeof(struct pwm_channel));
+    pwm->heap          = calloc(capacity, sizeof(size_t));
+    pwm->due_channels  = calloc(capacity, sizeof(size_t));
+    pwm->due_deadlines = calloc(capacity, sizeof(int64_t));
+    pwm->due_lines     = calloc(capacity, sizeof(int));
+    pwm->due_values    = calloc(capacity, sizeof(int));
+    pwm->size          = 0;
+    pwm->capacity      = capacity;
+    pwm->backend       = *backend;
+    pwm->wakeups       = 0;
+    pwm->edges         = 0;
+    pwm->commits       = 0;
+    histogram_init(&pwm->lateness);
+    if (NULL == pwm->channels || NULL == pwm->heap || NULL == pwm->due_channels || NULL == pwm->due_deadlines
+        || NULL == pwm->due_lines || NULL == pwm->due_values) {
+        pwm_terminate(pwm);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Add a channel to a PWM engine.
+ * @param pwm The engine.
+ * @param line_id The (GPIO) line ID.
+ * @param period The period, in nano seconds.
+ * @param high The time the line stays up during a period, in nano seconds (0: always down, `period`: always up).
+ * @return The index of the channel, or -1 on error (`errno` is set).
+ */
+
+int pwm_add(struct pwm *pwm, int line_id, int64_t period, int64_t high) {
+    struct pwm_channel *channel;
+
+    if (pwm->size == pwm->capacity) {
+        errno = ENOSPC;
+        return -1;
+    }
+    if (period <= 0 || high < 0 || high > period) {
+        errno = EINVAL;
+        return -1;
+    }
+    channel = &pwm->channels[pwm->size];
+    channel->period    = period;
+    channel->high      = high;
+    channel->next_high = high;
+    channel->line_id   = line_id;
+    channel->level     = 0;
+    channel->falling   = 0;
+    channel->start     = 0;
+    channel->next      = 0;
+    channel->due       = -1;
+    return (int)pwm->size++;
+}
+
+/**
+ * Change the duty cycle of a channel. This function can be called from any thread, while the engine is running:
+ * the new duty cycle takes effect at the beginning of the next period.
+ * @param pwm The engine.
+ * @param channel The index of the channel.
+ * @param high The time the line stays up during a period, in nano seconds.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pwm_set_duty(struct pwm *pwm, int channel, int64_t high) {
+    if (channel < 0 || (size_t)channel >= pwm->size || high < 0 || high > pwm->channels[channel].period) {
+        errno = EINVAL;
+        return -1;
+    }
+    __atomic_store_n(&pwm->channels[channel].next_high, high, __ATOMIC_RELAXED);
+    return 0;
+}
+
+/**
+ * Run the PWM engine for a given duration, then set all the lines down.
+ * @param pwm The engine.
+ * @param epoch The beginning of the first period of all the channels (see `timing_now()`).
+ * @param duration The duration, in nano seconds.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int pwm_run(struct pwm *pwm, int64_t epoch, int64_t duration) {
+    int64_t end = epoch + duration;
+    int count = 0;
+
+    if (0 == pwm->size) {
+        return 0;
+    }
+    for (size_t i=0; i<pwm->size; i++) {
+        pwm->channels[i].level   = 0;
+        pwm->channels[i].falling = 0;
+        pwm->channels[i].start   = epoch;
+        pwm->channels[i].next    = epoch;
+        pwm->heap[i] = i;
+    }
+    // All keys are equal: the array is already a heap.
+
+    while (key(pwm, 0) < end) {
+        if (-1 == timing_sleep_until(key(pwm, 0))) {
+            return -1;
+        }
+        pwm->wakeups++;
+        if (-1 == serve(pwm, timing_now())) {
+            return -1;
+        }
+    }
+
+    // Avoid useless current drain.
+    for (size_t i=0; i<pwm->size; i++) {
+        if (pwm->channels[i].level) {
+            pwm->channels[i].level = 0;
+            pwm->due_lines[count]  = pwm->channels[i].line_id;
+            pwm->due_values[count] = 0;
+            count++;
+        }
+    }
+    return commit(pwm, count);
+}
+
+/**
+ * Free the resources allocated by a PWM engine.
+ * @param pwm The engine.
+ */
+
+void pwm_terminate(struct pwm *pwm) {
+    free(pwm->channels);
+    free(pwm->heap);
+    free(pwm->due_channels);
+    free(pwm->due_deadlines);
+    free(pwm->due_lines);
+    free(pwm->due_values);
+    pwm->channels = NULL;
+    pwm->heap     = NULL;
+    pwm->size     = 0;
+    pwm->capacity = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef PWM_H
+#define PWM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "histogram.h"
+#include "scheduler.h"
+
+/**
+ * A PWM channel: a line that goes up at the beginning of every period, and down after `high` nano seconds.
+ */
+
+struct pwm_channel {
+    /** The period, in nano seconds. */
+    int64_t period;
+    /** The time the line stays up during the current period, in nano seconds. */
+    int64_t high;
+    /** The value of `high` for the next periods (see `pwm_set_duty()`). */
+    int64_t next_high;
+    /** The (GPIO) line ID. */
+    int     line_id;
+    /** The current value of the line. */
+    int     level;
+    /** 1 if the next edge is the falling edge of the current period, 0 if it is the beginning of a period. */
+    int     falling;
+    /** The beginning of the current period (CLOCK_MONOTONIC, in nano seconds). */
+    int64_t start;
+    /** The deadline of the next edge. */
+    int64_t next;
+    /** The index of the channel's edge in the edges due at the current wakeup (-1: none). */
+    int     due;
+};
+
+/**
+ * Single-thread software PWM engine: drives any number of channels with independent frequencies and duty cycles.
+ *
+ * Like the scheduler (see scheduler.h), the channels are kept in a binary min-heap keyed on their next edge, and
+ * all the edges that are due at a wakeup are committed together (with a single call to `set_values()`, if the
+ * backend supports it). A channel with a duty cycle of 0% or 100% does not produce any edge.
+ */
+
+struct pwm {
+    struct pwm_channel *channels;
+    /** The heap of channels (indexes in `channels`). */
+    size_t  *heap;
+    size_t  size;
+    size_t  capacity;
+    /** The edges due at the current wakeup: channels (indexes in `channels`), deadlines, lines and values. */
+    size_t  *due_channels;
+    int64_t *due_deadlines;
+    int     *due_lines;
+    int     *due_values;
+    struct output_backend backend;
+    /** The number of wakeups. */
+    long    wakeups;
+    /** The number of edges. */
+    long    edges;
+    /** The number of calls to the backend. */
+    long    commits;
+    /** The lateness of the edges: from their deadline to the completion of their commit (in nano seconds). */
+    struct histogram lateness;
+};
+
+int pwm_init(struct pwm *pwm, size_t capacity, const struct output_backend *backend);
+int pwm_add(struct pwm *pwm, int line_id, int64_t period, int64_t high);
+int pwm_set_duty(struct pwm *pwm, int channel, int64_t high);
+int pwm_run(struct pwm *pwm, int64_t epoch, int64_t duration);
+void pwm_terminate(struct pwm *pwm);
+
+#endif // PWM_H
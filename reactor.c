@@ -0,0 +1,218 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include "timing.h"
+#include "reactor.h"
+
+#define REACTOR_MAX_EVENTS 16
+
+/**
+ * Initialise a reactor.
+ * @param reactor The reactor to initialise.
+ * @param capacity The maximum number of sources.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int reactor_init(struct reactor *reactor, int capacity) {
+    reactor->sources  = calloc(capacity, sizeof(struct reactor_source));
+    reactor->capacity = capacity;
+    reactor->size     = 0;
+    reactor->active   = 0;
+    reactor->wakeups  = 0;
+    reactor->stopped  = 0;
+    if (NULL == reactor->sources) {
+        errno = ENOMEM;
+        return -1;
+    }
+    reactor->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (-1 == reactor->epoll_fd) {
+        free(reactor->sources);
+        reactor->sources = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static int add_source(struct reactor *reactor, int fd, int timer, reactor_handler handler, void *context) {
+    struct epoll_event event;
+    int index = 0;
+
+    // Reuse the slot of a removed source, if any (the sources of a long-running reactor come and go).
+    while (index < reactor->size && NULL != reactor->sources[index].handler) {
+        index++;
+    }
+    if (index == reactor->capacity) {
+        errno = ENOSPC;
+        return -1;
+    }
+    event.events   = EPOLLIN;
+    event.data.u32 = (uint32_t)index;
+    if (-1 == epoll_ctl(reactor->epoll_fd, EPOLL_CTL_ADD, fd, &event)) {
+        return -1;
+    }
+    reactor->sources[index].fd      = fd;
+    reactor->sources[index].timer   = timer;
+    reactor->sources[index].handler = handler;
+    reactor->sources[index].context = context;
+    if (index == reactor->size) {
+        reactor->size++;
+    }
+    reactor->active++;
+    return 0;
+}
+
+/**
+ * Add a periodic timer to a reactor.
+ *
+ * The timer expires at `epoch + N * period` (N > 0). Expiration instants are absolute, so the delays of the
+ * handlers do not accumulate.
+ * @param reactor The reactor.
+ * @param epoch The instant of cycle 0 (see `timing_now()`).
+ * @param period The period, in nano seconds.
+ * @param handler The function called when the timer expires.
+ * @param context The data passed to the handler.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int reactor_add_timer(struct reactor *reactor, int64_t epoch, int64_t period, reactor_handler handler, void *context) {
+    struct itimerspec specification;
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+
+    if (-1 == fd) {
+        return -1;
+    }
+    timing_from_ns(epoch + period, &specification.it_value);
+    timing_from_ns(period, &specification.it_interval);
+    if (-1 == timerfd_settime(fd, TFD_TIMER_ABSTIME, &specification, NULL)
+        || -1 == add_source(reactor, fd, 1, handler, context)) {
+        int saved = errno;
+        close(fd);
+        errno = saved;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Add a file descriptor to a reactor. The handler is called whenever the file descriptor is readable (see also
+ * `reactor_watch_fd()`).
+ * @param reactor The reactor.
+ * @param fd The file descriptor (for example, the one returned by `gpiod_line_event_get_fd()`).
+ * @param handler The function called when the file descriptor is readable. It must read the pending data.
+ * @param context The data passed to the handler.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int reactor_add_fd(struct reactor *reactor, int fd, reactor_handler handler, void *context) {
+    return add_source(reactor, fd, 0, handler, context);
+}
+
+/**
+ * Change the events watched on a file descriptor of a reactor (ex: wait until a socket is writable, without reading
+ * it). The handler is called when any of the events occurs, or when the peer hangs up.
+ * @param reactor The reactor.
+ * @param fd A file descriptor added with `reactor_add_fd()` (it is readable by default).
+ * @param events `REACTOR_READ`, `REACTOR_WRITE`, or both.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int reactor_watch_fd(struct reactor *reactor, int fd, int events) {
+    for (int i=0; i<reactor->size; i++) {
+        struct reactor_source *source = &reactor->sources[i];
+
+        if (NULL != source->handler && !source->timer && fd == source->fd) {
+            struct epoll_event event;
+
+            event.events   = (events & REACTOR_READ ? EPOLLIN : 0) | (events & REACTOR_WRITE ? EPOLLOUT : 0);
+            event.data.u32 = (uint32_t)i;
+            return epoll_ctl(reactor->epoll_fd, EPOLL_CTL_MOD, fd, &event);
+        }
+    }
+    errno = ENOENT;
+    return -1;
+}
+
+static void remove_source(struct reactor *reactor, struct reactor_source *source) {
+    epoll_ctl(reactor->epoll_fd, EPOLL_CTL_DEL, source->fd, NULL);
+    if (source->timer) {
+        close(source->fd);
+    }
+    source->fd      = -1;
+    source->handler = NULL;
+    reactor->active--;
+}
+
+/**
+ * Make `reactor_run()` return once the current batch of events has been handled (to be called from a handler).
+ * @param reactor The reactor.
+ */
+
+void reactor_stop(struct reactor *reactor) {
+    reactor->stopped = 1;
+}
+
+/**
+ * Run a reactor until no source is watched anymore, or until `reactor_stop()` is called.
+ * @param reactor The reactor.
+ * @return Upon successful completion, the function returns 0. Otherwise (an error occurred while waiting,
+ *         or a handler returned -1), it returns -1.
+ */
+
+int reactor_run(struct reactor *reactor) {
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+
+    while (reactor->active > 0 && !reactor->stopped) {
+        int count = epoll_wait(reactor->epoll_fd, events, REACTOR_MAX_EVENTS, -1);
+
+        if (-1 == count) {
+            if (EINTR == errno) {
+                continue;
+            }
+            return -1;
+        }
+        reactor->wakeups++;
+
+        for (int i=0; i<count; i++) {
+            struct reactor_source *source = &reactor->sources[events[i].data.u32];
+            uint64_t expirations = 0;
+            int status;
+
+            if (NULL == source->handler) {
+                continue; // Removed by a previous handler of this batch.
+            }
+            if (source->timer && sizeof(expirations) != read(source->fd, &expirations, sizeof(expirations))) {
+                if (EAGAIN == errno) {
+                    continue;
+                }
+                return -1;
+            }
+            status = source->handler(source->context, expirations);
+            if (-1 == status) {
+                return -1;
+            }
+            if (REACTOR_DONE == status) {
+                remove_source(reactor, source);
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Free the resources allocated by a reactor (including the timers, but not the other file descriptors).
+ * @param reactor The reactor.
+ */
+
+void reactor_terminate(struct reactor *reactor) {
+    for (int i=0; i<reactor->size; i++) {
+        if (NULL != reactor->sources[i].handler) {
+            remove_source(reactor, &reactor->sources[i]);
+        }
+    }
+    close(reactor->epoll_fd);
+    free(reactor->sources);
+    reactor->sources = NULL;
+    reactor->size    = 0;
+}
@@ -0,0 +1,58 @@
+#ifndef REACTOR_H
+#define REACTOR_H
+
+#include <stdint.h>
+
+/** Value returned by a handler to stop watching its source. */
+#define REACTOR_DONE 1
+
+/** The events watched on a file descriptor (see `reactor_watch_fd()`): readable, writable. */
+#define REACTOR_READ  1
+#define REACTOR_WRITE 2
+
+/**
+ * Function called when a source is ready.
+ * @param context The context given when the source was added.
+ * @param expirations For a timer, the number of expirations since the previous call (more than 1 means that
+ *        deadlines were missed). For a file descriptor, 0.
+ * @return 0 to keep watching the source, `REACTOR_DONE` to remove it, or -1 in case of error.
+ */
+
+typedef int (*reactor_handler)(void *context, uint64_t expirations);
+
+struct reactor_source {
+    /** The file descriptor (a timerfd, for timers). */
+    int             fd;
+    /** Tell whether the file descriptor is a timerfd created (and owned) by the reactor. */
+    int             timer;
+    reactor_handler handler;
+    void            *context;
+};
+
+/**
+ * Event loop that multiplexes periodic deadlines (timerfd) and file descriptors (GPIO edge events...) with epoll,
+ * so that any number of outputs and inputs are handled by one thread, with one wakeup per actual event.
+ */
+
+struct reactor {
+    int                   epoll_fd;
+    struct reactor_source *sources;
+    int                   capacity;
+    int                   size;
+    /** The number of sources that are still watched. */
+    int                   active;
+    /** The number of wakeups (returns from `epoll_wait()`). */
+    long                  wakeups;
+    /** 1 once `reactor_stop()` has been called. */
+    int                   stopped;
+};
+
+int reactor_init(struct reactor *reactor, int capacity);
+int reactor_add_timer(struct reactor *reactor, int64_t epoch, int64_t period, reactor_handler handler, void *context);
+int reactor_add_fd(struct reactor *reactor, int fd, reactor_handler handler, void *context);
+int reactor_watch_fd(struct reactor *reactor, int fd, int events);
+void reactor_stop(struct reactor *reactor);
+int reactor_run(struct reactor *reactor);
+void reactor_terminate(struct reactor *reactor);
+
+#endif // REACTOR_H
@@ -0,0 +1,166 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "rt.h"
+
+/**
+ * Initialise a profile with the default attributes (no real-time feature).
+ * @param profile The profile to initialise.
+ */
+
+void rt_profile_init(struct rt_profile *profile) {
+    profile->policy         = SCHED_OTHER;
+    profile->priority       = 0;
+    profile->cpu            = -1;
+    profile->lock_memory    = 0;
+    profile->prefault_stack = 0;
+}
+
+/**
+ * Set the scheduling policy and priority of a profile from a specification such as "fifo:80", "rr:50" or "other".
+ * @param profile The profile.
+ * @param specification The specification.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1.
+ */
+
+int rt_profile_parse_policy(struct rt_profile *profile, const char *specification) {
+    const char *separator = strchr(specification, ':');
+    size_t length = NULL == separator ? strlen(specification) : (size_t)(separator - specification);
+
+    if (0 == strncmp(specification, "other", length) && 5 == length) {
+        profile->policy   = SCHED_OTHER;
+        profile->priority = 0;
+        return 0;
+    }
+    if (0 == strncmp(specification, "fifo", length) && 4 == length) {
+        profile->policy = SCHED_FIFO;
+    } else if (0 == strncmp(specification, "rr", length) && 2 == length) {
+        profile->policy = SCHED_RR;
+    } else {
+        return -1;
+    }
+    profile->priority = NULL == separator ? 50 : atoi(separator + 1);
+    if (profile->priority < sched_get_priority_min(profile->policy)
+        || profile->priority > sched_get_priority_max(profile->policy)) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Set the CPU of a profile. The specification is a CPU number, or "auto" to select the first isolated CPU
+ * (see the `isolcpus` kernel parameter) or, if no CPU is isolated, the last CPU.
+ * @param profile The profile.
+ * @param specification The specification.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1.
+ */
+
+int rt_profile_parse_cpu(struct rt_profile *profile, const char *specification) {
+    if (0 == strcmp(specification, "auto")) {
+        FILE *isolated = fopen("/sys/devices/system/cpu/isolated", "r");
+        int cpu = -1;
+
+        if (NULL != isolated) {
+            if (1 != fscanf(isolated, "%d", &cpu)) {
+                cpu = -1;
+            }
+            fclose(isolated);
+        }
+        profile->cpu = -1 != cpu ? cpu : (int)sysconf(_SC_NPROCESSORS_ONLN) - 1;
+        return 0;
+    }
+    profile->cpu = atoi(specification);
+    return profile->cpu < 0 || profile->cpu >= CPU_SETSIZE ? -1 : 0;
+}
+
+/**
+ * Lock the current and future memory of the process, if the profile requests it.
+ * If the process is not allowed to lock its memory, a warning is printed and the program continues.
+ * @param profile The profile.
+ */
+
+void rt_lock_memory(const struct rt_profile *profile) {
+    if (profile->lock_memory && -1 == mlockall(MCL_CURRENT | MCL_FUTURE)) {
+        fprintf(stderr, "Warning: cannot lock the memory (mlockall() - errno: %d)\n", errno);
+    }
+}
+
+static void prefault_stack(size_t size) {
+    volatile char stack[size];
+    size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+
+    // One write per page, through the volatile array: the compiler cannot remove the writes.
+    for (size_t i=0; i<size; i+=page_size) {
+        stack[i] = 0;
+    }
+    stack[size - 1] = 0;
+    (void)stack[0];
+}
+
+/**
+ * Apply a profile to the calling thread: scheduling policy and priority, CPU pinning and stack prefaulting.
+ *
+ * If the process lacks the privileges (CAP_SYS_NICE) for the requested policy, a warning is printed and the
+ * thread keeps the default policy: the program still works, without real-time guarantees.
+ * @param profile The profile.
+ * @param state Receives the state of the thread, used by `rt_thread_report()`.
+ */
+
+void rt_thread_enter(const struct rt_profile *profile, struct rt_thread_state *state) {
+    int status;
+
+    state->policy = SCHED_OTHER;
+    if (SCHED_OTHER != profile->policy) {
+        struct sched_param parameter = { .sched_priority = profile->priority };
+
+        status = pthread_setschedparam(pthread_self(), profile->policy, &parameter);
+        if (0 == status) {
+            state->policy = profile->policy;
+        } else {
+            fprintf(stderr, "Warning: cannot set the real-time scheduling policy (pthread_setschedparam() - "
+                            "errno: %d). Running with the default policy.\n", status);
+        }
+    }
+
+    if (-1 != profile->cpu) {
+        cpu_set_t cpus;
+
+        CPU_ZERO(&cpus);
+        CPU_SET(profile->cpu, &cpus);
+        status = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (0 != status) {
+            fprintf(stderr, "Warning: cannot pin the thread to CPU %d (pthread_setaffinity_np() - errno: %d)\n",
+                    profile->cpu, status);
+        }
+    }
+
+    if (profile->prefault_stack > 0) {
+        prefault_stack(profile->prefault_stack);
+    }
+    getrusage(RUSAGE_THREAD, &state->start);
+}
+
+/**
+ * Print the page faults and the context switches of the calling thread since it called `rt_thread_enter()`.
+ * @param stream The stream to print to.
+ * @param name The name of the thread.
+ * @param state The state of the thread.
+ */
+
+void rt_thread_report(FILE *stream, const char *name, const struct rt_thread_state *state) {
+    struct rusage now;
+
+    getrusage(RUSAGE_THREAD, &now);
+    fprintf(stream, "%s: policy %s, CPU %d, %ld minor / %ld major page faults, "
+                    "%ld voluntary / %ld involuntary context switches\n",
+            name,
+            SCHED_FIFO == state->policy ? "FIFO" : SCHED_RR == state->policy ? "RR" : "OTHER",
+            sched_getcpu(),
+            now.ru_minflt - state->start.ru_minflt, now.ru_majflt - state->start.ru_majflt,
+            now.ru_nvcsw - state->start.ru_nvcsw, now.ru_nivcsw - state->start.ru_nivcsw);
+}
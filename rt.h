@@ -0,0 +1,46 @@
+#ifndef RT_H
+#define RT_H
+
+#include <stddef.h>
+#include <stdio.h>
+#include <sys/resource.h>
+
+/** The number of bytes of stack touched by `rt_thread_enter()` when memory locking is requested. */
+#define RT_PREFAULT_STACK_SIZE (64 * 1024)
+
+/**
+ * Real-time execution profile, applied to the threads that drive the lines.
+ */
+
+struct rt_profile {
+    /** The scheduling policy (SCHED_OTHER, SCHED_FIFO or SCHED_RR). */
+    int    policy;
+    /** The scheduling priority (only for SCHED_FIFO and SCHED_RR). */
+    int    priority;
+    /** The CPU the threads are pinned to (-1: no pinning). */
+    int    cpu;
+    /** Tell whether the memory of the process must be locked (see `mlockall()`). */
+    int    lock_memory;
+    /** The number of bytes of stack to prefault when a thread starts. */
+    size_t prefault_stack;
+};
+
+/**
+ * The state of a thread running with a real-time profile.
+ */
+
+struct rt_thread_state {
+    /** The resource usage of the thread when it entered its real-time section. */
+    struct rusage start;
+    /** The policy actually applied (it may differ from the requested one, if the process lacks privileges). */
+    int           policy;
+};
+
+void rt_profile_init(struct rt_profile *profile);
+int rt_profile_parse_policy(struct rt_profile *profile, const char *specification);
+int rt_profile_parse_cpu(struct rt_profile *profile, const char *specification);
+void rt_lock_memory(const struct rt_profile *profile);
+void rt_thread_enter(const struct rt_profile *profile, struct rt_thread_state *state);
+void rt_thread_report(FILE *stream, const char *name, const struct rt_thread_state *state);
+
+#endif // RT_H
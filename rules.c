@@ -0,0 +1,414 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+#include "rules.h"
+
+/**
+ * Initialise an engine without rules.
+ * @param engine The engine to initialise.
+ */
+
+void rules_init(struct rule_engine *engine) {
+    memset(engine, 0, sizeof(*engine));
+}
+
+/**
+ * Add a rule. The rules take effect once compiled (see `rules_compile()`). When several rules of an input line
+ * drive the same output, they are applied in the order in which they have been added.
+ * @param engine The engine.
+ * @param input The offset of the input line.
+ * @param kind RULE_MIRROR, RULE_INVERT, RULE_TOGGLE, RULE_PULSE, RULE_LATCH or RULE_UNLATCH.
+ * @param output The offset of the output line.
+ * @param duration The duration of the pulses, in nano seconds (RULE_PULSE only).
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int rules_add(struct rule_engine *engine, unsigned int input, int kind, unsigned int output, int64_t duration) {
+    if (kind < RULE_MIRROR || kind > RULE_UNLATCH || (RULE_PULSE == kind && duration <= 0)) {
+        errno = EINVAL;
+        return -1;
+    }
+    if (engine->size == engine->capacity) {
+        size_t capacity = 0 == engine->capacity ? 16 : 2 * engine->capacity;
+        struct rule *rules = realloc(engine->rules, capacity * sizeof(struct rule));
+
+        if (NULL == rules) {
+            errno = ENOMEM;
+            return -1;
+        }
+        engine->rules    = rules;
+        engine->capacity = capacity;
+    }
+    engine->rules[engine->size].input    = input;
+    engine->rules[engine->size].kind     = kind;
+    engine->rules[engine->size].output   = output;
+    engine->rules[engine->size].duration = RULE_PULSE == kind ? duration : 0;
+    engine->size++;
+    return 0;
+}
+
+static const char *skip_blanks(const char *cursor, const char *end) {
+    while (cursor < end && (' ' == *cursor || '\t' == *cursor || '\r' == *cursor)) {
+        cursor++;
+    }
+    return cursor;
+}
+
+/**
+ * Add the rules described by a text. Each line is a rule: the input line, the kind of rule (`mirror`, `invert`,
+ * `toggle`, `pulse`, `latch` or `unlatch`), the output line and, for a pulse, its duration. Empty lines and lines
+ * that start with '#' are ignored.
+ *
+ *     # input  kind     output  duration
+ *     21       toggle   17
+ *     22       mirror   18
+ *     23       pulse    19      5ms
+ *     24       latch    20
+ *     25       unlatch  20
+ *
+ * @param engine The engine.
+ * @param text The text to parse.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int rules_parse(struct rule_engine *engine, const char *text) {
+    static const char *all_kinds[] = { "mirror", "invert", "toggle", "pulse", "latch", "unlatch" };
+
+    while ('\0' != *text) {
+        const char *end = strchr(text, '\n');
+        const char *cursor = text;
+
+        if (NULL == end) {
+            end = text + strlen(text);
+        }
+        cursor = skip_blanks(cursor, end);
+        if (cursor < end && '#' != *cursor) {
+            unsigned long input, output;
+            int64_t duration = 0;
+            int kind = -1;
+            char *next;
+
+            input = strtoul(cursor, &next, 10);
+            if (next == cursor) {
+                errno = EINVAL;
+                return -1;
+            }
+            cursor = skip_blanks(next, end);
+            for (int i=RULE_MIRROR; i<=RULE_UNLATCH; i++) {
+                size_t length = strlen(all_kinds[i]);
+
+                if (0 == strncmp(cursor, all_kinds[i], length)
+                    && (' ' == cursor[length] || '\t' == cursor[length])) {
+                    kind    = i;
+                    cursor += length;
+                    break;
+                }
+            }
+            if (-1 == kind) {
+                errno = EINVAL;
+                return -1;
+            }
+            cursor = skip_blanks(cursor, end);
+            output = strtoul(cursor, &next, 10);
+            if (next == cursor) {
+                errno = EINVAL;
+                return -1;
+            }
+            cursor = skip_blanks(next, end);
+            if (RULE_PULSE == kind
+                && (cursor >= end || NULL == (cursor = timing_parse_duration(cursor, &duration)))) {
+                errno = EINVAL;
+                return -1;
+            }
+            if (skip_blanks(cursor, end) != end) {
+                errno = EINVAL;
+                return -1;
+            }
+            if (-1 == rules_add(engine, (unsigned int)input, kind, (unsigned int)output, duration)) {
+                return -1;
+            }
+        }
+        text = '\0' == *end ? end : end + 1;
+    }
+    return 0;
+}
+
+static void free_compiled(struct rule_engine *engine) {
+    free(engine->table);
+    free(engine->actions);
+    free(engine->output_ids);
+    free(engine->values);
+    free(engine->dirty);
+    free(engine->changes);
+    free(engine->write_lines);
+    free(engine->write_values);
+    free(engine->pulse_ends);
+    free(engine->pulses);
+    engine->table        = NULL;
+    engine->actions      = NULL;
+    engine->output_ids   = NULL;
+    engine->values       = NULL;
+    engine->dirty        = NULL;
+    engine->changes      = NULL;
+    engine->write_lines  = NULL;
+    engine->write_values = NULL;
+    engine->pulse_ends   = NULL;
+    engine->pulses       = NULL;
+    engine->table_size   = 0;
+    engine->output_count = 0;
+    engine->change_count = 0;
+    engine->pulse_count  = 0;
+}
+
+/**
+ * Compile the rules: build the dispatch table of the input lines and number the output lines (in the order of
+ * their first rule). All the outputs start low. The engine can be recompiled after new rules have been added.
+ * @param engine The engine.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int rules_compile(struct rule_engine *engine) {
+    unsigned int table_size = 0;
+    uint32_t first = 0;
+    size_t slots;
+
+    if (0 == engine->size) {
+        errno = EINVAL;
+        return -1;
+    }
+    for (size_t i=0; i<engine->size; i++) {
+        if (engine->rules[i].input + 1 > table_size) {
+            table_size = engine->rules[i].input + 1;
+        }
+    }
+
+    free_compiled(engine);
+    slots = engine->size;
+    engine->table        = calloc(table_size, sizeof(struct rule_entry));
+    engine->actions      = calloc(slots, sizeof(struct rule_action));
+    engine->output_ids   = calloc(slots, sizeof(unsigned int));
+    engine->values       = calloc(slots, sizeof(int));
+    engine->dirty        = calloc(slots, sizeof(uint8_t));
+    engine->changes      = calloc(slots, sizeof(int));
+    engine->write_lines  = calloc(slots, sizeof(int));
+    engine->write_values = calloc(slots, sizeof(int));
+    engine->pulse_ends   = calloc(slots, sizeof(int64_t));
+    engine->pulses       = calloc(slots, sizeof(int));
+    if (NULL == engine->table || NULL == engine->actions || NULL == engine->output_ids || NULL == engine->values
+        || NULL == engine->dirty || NULL == engine->changes || NULL == engine->write_lines
+        || NULL == engine->write_values || NULL == engine->pulse_ends || NULL == engine->pulses) {
+        free_compiled(engine);
+        errno = ENOMEM;
+        return -1;
+    }
+    engine->table_size = table_size;
+
+    // Number the outputs.
+    for (size_t i=0; i<engine->size; i++) {
+        int index = 0;
+
+        while (index < engine->output_count && engine->output_ids[index] != engine->rules[i].output) {
+            index++;
+        }
+        if (index == engine->output_count) {
+            engine->output_ids[engine->output_count++] = engine->rules[i].output;
+        }
+    }
+
+    // Group the actions by input line, in the order of the rules.
+    for (size_t i=0; i<engine->size; i++) {
+        engine->table[engine->rules[i].input].count++;
+    }
+    for (unsigned int offset=0; offset<table_size; offset++) {
+        engine->table[offset].first = first;
+        first += engine->table[offset].count;
+        engine->table[offset].count = 0;
+    }
+    for (size_t i=0; i<engine->size; i++) {
+        const struct rule *rule = &engine->rules[i];
+        struct rule_entry *entry = &engine->table[rule->input];
+        struct rule_action *action = &engine->actions[entry->first + entry->count++];
+        int index = 0;
+
+        while (engine->output_ids[index] != rule->output) {
+            index++;
+        }
+        action->kind     = rule->kind;
+        action->output   = index;
+        action->duration = rule->duration;
+    }
+    return 0;
+}
+
+/**
+ * Set the object that writes the outputs. Call it once the rules are compiled and the outputs are requested.
+ * @param engine The engine.
+ * @param backend The object used to change the value of the lines (the line IDs are the offsets of the outputs).
+ */
+
+void rules_attach(struct rule_engine *engine, const struct output_backend *backend) {
+    engine->backend = *backend;
+}
+
+static void change(struct rule_engine *engine, int output, int value) {
+    engine->values[output] = value;
+    if (!engine->dirty[output]) {
+        engine->dirty[output] = 1;
+        engine->changes[engine->change_count++] = output;
+    }
+}
+
+/**
+ * Apply the rules of an input line to one of its edges. The outputs are only updated in memory: see
+ * `rules_commit()`.
+ * @param engine The compiled engine.
+ * @param event The edge (the edges of the lines without rule are ignored).
+ * @return The number of actions run.
+ */
+
+int rules_apply(struct rule_engine *engine, const struct gpio_event *event) {
+    const struct rule_entry *entry;
+    int rising = event->rising != 0;
+    int run = 0;
+
+    if (event->offset >= engine->table_size || 0 == (entry = &engine->table[event->offset])->count) {
+        return 0;
+    }
+    engine->events++;
+    for (uint32_t i=entry->first; i<entry->first + entry->count; i++) {
+        const struct rule_action *action = &engine->actions[i];
+        int output = action->output;
+
+        switch (action->kind) {
+            case RULE_MIRROR: change(engine, output, rising); break;
+            case RULE_INVERT: change(engine, output, !rising); break;
+            case RULE_TOGGLE: change(engine, output, !engine->values[output]); break;
+            case RULE_PULSE: {
+                if (!rising) {
+                    continue;
+                }
+                if (0 == engine->pulse_ends[output]) {
+                    engine->pulses[engine->pulse_count++] = output;
+                }
+                engine->pulse_ends[output] = event->timestamp + action->duration;
+                change(engine, output, 1);
+            }; break;
+            default: {
+                if (!rising) {
+                    continue;
+                }
+                change(engine, output, RULE_LATCH == action->kind);
+            }; break;
+        }
+        run++;
+    }
+    engine->triggered += run;
+    return run;
+}
+
+/**
+ * Apply the rules to a batch of edges.
+ * @param engine The compiled engine.
+ * @param events The edges.
+ * @param count The number of edges.
+ */
+
+void rules_dispatch(struct rule_engine *engine, const struct gpio_event *events, int count) {
+    for (int i=0; i<count; i++) {
+        rules_apply(engine, &events[i]);
+    }
+}
+
+/**
+ * End the pulses that are over. The outputs are only updated in memory: see `rules_commit()`.
+ * @param engine The compiled engine.
+ * @param now The current time (see `timing_now()`, the clock of the kernel timestamps of the edges).
+ * @return The end of the next pulse, or 0 if no pulse is in progress.
+ */
+
+int64_t rules_expire(struct rule_engine *engine, int64_t now) {
+    int64_t next = 0;
+
+    for (int i=0; i<engine->pulse_count; ) {
+        int output = engine->pulses[i];
+
+        if (engine->pulse_ends[output] <= now) {
+            engine->pulse_ends[output] = 0;
+            engine->pulses[i] = engine->pulses[--engine->pulse_count];
+            change(engine, output, 0);
+            continue;
+        }
+        if (0 == next || engine->pulse_ends[output] < next) {
+            next = engine->pulse_ends[output];
+        }
+        i++;
+    }
+    return next;
+}
+
+/**
+ * End the pulses in progress and set all the outputs low, their initial value (ex: before the outputs are released).
+ * The outputs are only updated in memory: see `rules_commit()`.
+ * @param engine The compiled engine.
+ */
+
+void rules_idle(struct rule_engine *engine) {
+    for (int i=0; i<engine->pulse_count; i++) {
+        engine->pulse_ends[engine->pulses[i]] = 0;
+    }
+    engine->pulse_count = 0;
+    for (int output=0; output<engine->output_count; output++) {
+        if (0 != engine->values[output]) {
+            change(engine, output, 0);
+        }
+    }
+}
+
+/**
+ * Write the outputs changed since the previous commit, with a single call to the backend if it supports bulk
+ * writes.
+ * @param engine The compiled engine.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int rules_commit(struct rule_engine *engine) {
+    struct output_backend *backend = &engine->backend;
+    int count = engine->change_count;
+
+    if (0 == count) {
+        return 0;
+    }
+    for (int i=0; i<count; i++) {
+        int output = engine->changes[i];
+
+        engine->dirty[output]  = 0;
+        engine->write_lines[i]  = (int)engine->output_ids[output];
+        engine->write_values[i] = engine->values[output];
+    }
+    engine->change_count = 0;
+    if (NULL != backend->set_values) {
+        engine->commits++;
+        return backend->set_values(backend->context, count, engine->write_lines, engine->write_values);
+    }
+    for (int i=0; i<count; i++) {
+        engine->commits++;
+        if (-1 == backend->set_value(backend->context, engine->write_lines[i], engine->write_values[i])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Free the resources allocated by an engine.
+ * @param engine The engine.
+ */
+
+void rules_terminate(struct rule_engine *engine) {
+    free_compiled(engine);
+    free(engine->rules);
+    engine->rules    = NULL;
+    engine->size     = 0;
+    engine->capacity = 0;
+}
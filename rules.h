@@ -0,0 +1,108 @@
+#ifndef RULES_H
+#define RULES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gpio.h"
+#include "scheduler.h"
+
+/** Kinds of rules (see `rules_add()`). The output follows the input. */
+#define RULE_MIRROR  0
+/** The output is the opposite of the input. */
+#define RULE_INVERT  1
+/** The output changes on every edge of the input. */
+#define RULE_TOGGLE  2
+/** The output is high for a given duration after each rising edge of the input (retriggerable). */
+#define RULE_PULSE   3
+/** The output goes high on a rising edge of the input, and stays high. */
+#define RULE_LATCH   4
+/** The output goes low on a rising edge of the input (the reset of a latch). */
+#define RULE_UNLATCH 5
+
+/**
+ * A reaction of an output line to the edges of an input line, as given by the configuration.
+ */
+
+struct rule {
+    unsigned int input;
+    int          kind;
+    unsigned int output;
+    /** The duration of the pulses, in nano seconds (RULE_PULSE only). */
+    int64_t      duration;
+};
+
+/**
+ * A compiled rule: the output is given by its index in the engine.
+ */
+
+struct rule_action {
+    int     kind;
+    int     output;
+    int64_t duration;
+};
+
+/**
+ * The actions of an input line: `actions[first]`...`actions[first + count - 1]`.
+ */
+
+struct rule_entry {
+    uint32_t first;
+    uint32_t count;
+};
+
+/**
+ * Input-to-output rule engine.
+ *
+ * The rules are loaded (see `rules_add()` and `rules_parse()`), then compiled into a flat dispatch table indexed by
+ * the offset of the input lines: the actions of an edge are found with a single indexed lookup, whatever the number
+ * of rules. The actions only update the values of the outputs, in memory. Once a batch of edges has been applied,
+ * `rules_commit()` writes the outputs that have changed with a single call to the backend.
+ *
+ * The engine keeps the values of all the outputs, by index (the order of `output_ids`): a backend that can only
+ * write all the lines at once (ex: `gpio_output_set_values()`) may ignore its arguments and write `values`.
+ */
+
+struct rule_engine {
+    /** The rules, in the order of the configuration. */
+    struct rule        *rules;
+    size_t             size;
+    size_t             capacity;
+    /** The dispatch table: `table[offset]`, for all offsets up to the greatest input offset. */
+    struct rule_entry  *table;
+    unsigned int       table_size;
+    struct rule_action *actions;
+    /** The outputs, by index, and their values (all the outputs start low). */
+    unsigned int       *output_ids;
+    int                *values;
+    int                output_count;
+    /** The outputs changed since the last commit: `dirty[i]` is 1 for the outputs of `changes`. */
+    uint8_t            *dirty;
+    int                *changes;
+    int                change_count;
+    /** The arguments of the backend. */
+    int                *write_lines;
+    int                *write_values;
+    /** The end of the pulse of each output (0: no pulse), and the outputs with a pulse in progress. */
+    int64_t            *pulse_ends;
+    int                *pulses;
+    int                pulse_count;
+    struct output_backend backend;
+    /** The number of edges applied, of actions run and of calls to the backend. */
+    long               events;
+    long               triggered;
+    long               commits;
+};
+
+void rules_init(struct rule_engine *engine);
+int rules_add(struct rule_engine *engine, unsigned int input, int kind, unsigned int output, int64_t duration);
+int rules_parse(struct rule_engine *engine, const char *text);
+int rules_compile(struct rule_engine *engine);
+void rules_attach(struct rule_engine *engine, const struct output_backend *backend);
+int rules_apply(struct rule_engine *engine, const struct gpio_event *event);
+void rules_dispatch(struct rule_engine *engine, const struct gpio_event *events, int count);
+int64_t rules_expire(struct rule_engine *engine, int64_t now);
+void rules_idle(struct rule_engine *engine);
+int rules_commit(struct rule_engine *engine);
+void rules_terminate(struct rule_engine *engine);
+
+#endif // RULES_H
@@ -0,0 +1,241 @@
+#include <errno.h>
+#include <stdlib.h>
+#include "timing.h"
+#include "scheduler.h"
+
+static int64_t key(const struct scheduler *scheduler, size_t heap_index) {
+    return scheduler->outputs[scheduler->heap[heap_index]].next;
+}
+
+static void swap(struct scheduler *scheduler, size_t a, size_t b) {
+    size_t tmp = scheduler->heap[a];
+    scheduler->heap[a] = scheduler->heap[b];
+    scheduler->heap[b] = tmp;
+}
+
+static void sift_down(struct scheduler *scheduler, size_t i) {
+    for (;;) {
+        size_t left = 2 * i + 1;
+        size_t smallest = i;
+
+        if (left < scheduler->heap_size && key(scheduler, left) < key(scheduler, smallest)) {
+            smallest = left;
+        }
+        if (left + 1 < scheduler->heap_size && key(scheduler, left + 1) < key(scheduler, smallest)) {
+            smallest = left + 1;
+        }
+        if (smallest == i) {
+            break;
+        }
+        swap(scheduler, smallest, i);
+        i = smallest;
+    }
+}
+
+static int commit(struct scheduler *scheduler, int count) {
+    struct output_backend *backend = &scheduler->backend;
+    int64_t first = 0;
+
+    if (0 == count) {
+        return 0;
+    }
+    if (NULL != backend->set_values) {
+        // The lines change within the single call: its duration bounds the skew.
+        scheduler->commits++;
+        first = timing_now();
+        if (-1 == backend->set_values(backend->context, count, scheduler->due_lines, scheduler->due_values)) {
+            return -1;
+        }
+        if (count > 1) {
+            histogram_record(&scheduler->skew, timing_now() - first);
+        }
+        return 0;
+    }
+
+    for (int i=0; i<count; i++) {
+        scheduler->commits++;
+        if (-1 == backend->set_value(backend->context, scheduler->due_lines[i], scheduler->due_values[i])) {
+            return -1;
+        }
+        if (0 == i) {
+            first = timing_now();
+        }
+    }
+    if (count > 1) {
+        histogram_record(&scheduler->skew, timing_now() - first);
+    }
+    return 0;
+}
+
+/** Collect the transitions that are due, commit them and reschedule their outputs. */
+static int serve(struct scheduler *scheduler, int64_t epoch, int64_t now) {
+    int count = 0;
+    int64_t done;
+
+    while (scheduler->heap_size > 0 && key(scheduler, 0) <= now) {
+        struct scheduled_output *output = &scheduler->outputs[scheduler->heap[0]];
+
+        // After a late wakeup, the missed changes of state are skipped (by whole periods): each output contributes a
+        // single transition per wakeup, to the latest state due.
+        if (output->period > 0) {
+            output->cycle += (now - output->next) / output->period;
+        } else {
+            output->cycle = output->count;
+        }
+        if (output->cycle > output->count) {
+            output->cycle = output->count;
+        }
+        output->next = epoch + output->cycle * output->period;
+
+        scheduler->due_outputs[count]   = scheduler->heap[0];
+        scheduler->due_deadlines[count] = output->next;
+        scheduler->due_lines[count]     = output->line_id;
+        scheduler->due_values[count]    = output->cycle < output->count ? (output->cycle & 0x1) != 0 : 0;
+        count++;
+
+        if (output->cycle++ < output->count) {
+            output->next = epoch + output->cycle * output->period;
+        } else {
+            scheduler->heap[0] = scheduler->heap[--scheduler->heap_size];
+        }
+        sift_down(scheduler, 0);
+    }
+
+    if (-1 == commit(scheduler, count)) {
+        return -1;
+    }
+    done = timing_now();
+    for (int i=0; i<count; i++) {
+        stats_record(scheduler->outputs[scheduler->due_outputs[i]].stats, scheduler->due_deadlines[i], done);
+    }
+    scheduler->transitions += count;
+    return 0;
+}
+
+/**
+ * Initialise a scheduler.
+ * @param scheduler The scheduler to initialise.
+ * @param capacity The maximum number of outputs.
+ * @param backend The object used to change the value of the lines.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int scheduler_init(struct scheduler *scheduler, size_t capacity, const struct output_backend *backend) {
+    scheduler->outputs       = calloc(capacity, sizeof(struct scheduled_output));
+    scheduler->heap          = calloc(capacity, sizeof(size_t));
+    scheduler->due_outputs   = calloc(capacity, sizeof(size_t));
+    scheduler->due_deadlines = calloc(capacity, sizeof(int64_t));
+    scheduler->due_lines     = calloc(capacity, sizeof(int));
+    scheduler->due_values    = calloc(capacity, sizeof(int));
+    scheduler->heap_size     = 0;
+    scheduler->size          = 0;
+    scheduler->capacity      = capacity;
+    scheduler->backend       = *backend;
+    scheduler->wakeups       = 0;
+    scheduler->transitions   = 0;
+    scheduler->commits       = 0;
+    scheduler->lateness_sum  = 0;
+    scheduler->lateness_max  = 0;
+    histogram_init(&scheduler->skew);
+    if (NULL == scheduler->outputs || NULL == scheduler->heap || NULL == scheduler->due_outputs
+        || NULL == scheduler->due_deadlines || NULL == scheduler->due_lines || NULL == scheduler->due_values) {
+        scheduler_terminate(scheduler);
+        errno = ENOMEM;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Add a periodic output to a scheduler.
+ * @param scheduler The scheduler.
+ * @param duration_sec The number of seconds to wait for the line to change its state.
+ * @param duration_nano_sec The number of nano seconds to wait for the line to change its state.
+ *        This value must be in the range [0, 999999999].
+ * @param count The number of changes of state.
+ * @param line_id The (GPIO) line ID.
+ * @param stats If not NULL, receives the timing of every change of state.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int scheduler_add(struct scheduler *scheduler, time_t duration_sec, long duration_nano_sec, long count, int line_id,
+                  struct line_stats *stats) {
+    struct scheduled_output *output;
+
+    if (scheduler->size == scheduler->capacity) {
+        errno = ENOSPC;
+        return -1;
+    }
+    if (duration_nano_sec < 0 || duration_nano_sec >= NSEC_PER_SEC) {
+        errno = EINVAL;
+        return -1;
+    }
+    output = &scheduler->outputs[scheduler->size++];
+    output->period  = (int64_t)duration_sec * NSEC_PER_SEC + duration_nano_sec;
+    output->count   = count;
+    output->line_id = line_id;
+    output->cycle   = 0;
+    output->next    = 0;
+    output->stats   = stats;
+    return 0;
+}
+
+/**
+ * Run the scheduler until all outputs performed all their changes of state.
+ *
+ * Like the thread that controls a LED, an output goes through `count` changes of state (down, up, down...)
+ * and is then set down, in order to avoid useless current drain.
+ * @param scheduler The scheduler.
+ * @param epoch The instant of the first change of state (see `timing_now()`).
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int scheduler_run(struct scheduler *scheduler, int64_t epoch) {
+    scheduler->heap_size = 0;
+    for (size_t i=0; i<scheduler->size; i++) {
+        scheduler->outputs[i].cycle = 0;
+        scheduler->outputs[i].next  = epoch;
+        scheduler->heap[scheduler->heap_size++] = i;
+    }
+    // All keys are equal: the array is already a heap.
+
+    while (scheduler->heap_size > 0) {
+        int64_t deadline = key(scheduler, 0);
+        int64_t now;
+        int64_t late;
+
+        if (-1 == timing_sleep_until(deadline)) {
+            return -1;
+        }
+        now  = timing_now();
+        late = now - deadline;
+        scheduler->wakeups++;
+        scheduler->lateness_sum += late;
+        if (late > scheduler->lateness_max) {
+            scheduler->lateness_max = late;
+        }
+
+        if (-1 == serve(scheduler, epoch, now)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Free the resources allocated by a scheduler.
+ * @param scheduler The scheduler.
+ */
+
+void scheduler_terminate(struct scheduler *scheduler) {
+    free(scheduler->outputs);
+    free(scheduler->heap);
+    free(scheduler->due_outputs);
+    free(scheduler->due_deadlines);
+    free(scheduler->due_lines);
+    free(scheduler->due_values);
+    scheduler->outputs  = NULL;
+    scheduler->heap     = NULL;
+    scheduler->size     = 0;
+    scheduler->capacity = 0;
+}
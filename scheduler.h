@@ -0,0 +1,96 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "histogram.h"
+#include "stats.h"
+
+/**
+ * The object that actually changes the value of the lines.
+ * This makes the scheduler independent of libgpiod (and lets it run against an in-memory backend).
+ */
+
+struct output_backend {
+    /** Opaque data passed to the functions below. */
+    void *context;
+    /**
+     * Change the value of a line.
+     * Must return 0 upon successful completion, or -1 in case of error.
+     */
+    int (*set_value)(void *context, int line_id, int value);
+    /**
+     * Optional (may be NULL): change the values of several lines at once (ex: `gpiod_line_set_value_bulk()`).
+     * If set, all the transitions due at the same instant are committed with a single call.
+     * Must return 0 upon successful completion, or -1 in case of error.
+     */
+    int (*set_values)(void *context, int count, const int *line_ids, const int *values);
+};
+
+/**
+ * A periodic output driven by the scheduler.
+ * The fields that describe the signal are the ones of `struct issuer_args`.
+ */
+
+struct scheduled_output {
+    /** The period, in nano seconds. */
+    int64_t period;
+    /** The number of changes of state. */
+    long    count;
+    /** The (GPIO) line ID. */
+    int     line_id;
+    /** The index of the next change of state. */
+    long    cycle;
+    /** The deadline of the next change of state (CLOCK_MONOTONIC, in nano seconds). */
+    int64_t next;
+    /** If not NULL, receives the timing of every change of state. */
+    struct line_stats *stats;
+};
+
+/**
+ * Single-thread scheduler that drives any number of periodic outputs.
+ *
+ * Pending outputs are kept in a binary min-heap keyed on their next deadline: the thread sleeps until the
+ * earliest deadline, then serves every output that is due. The cost of a wakeup is O(k log n), where k is
+ * the number of due outputs. If the backend supports it, all the transitions due at a wakeup are committed
+ * together.
+ */
+
+struct scheduler {
+    /** The outputs (in the order they were added). */
+    struct scheduled_output *outputs;
+    /** The heap of pending outputs (indexes in `outputs`). */
+    size_t  *heap;
+    size_t  heap_size;
+    /** The transitions due at the current wakeup: outputs (indexes in `outputs`), deadlines, lines and values. */
+    size_t  *due_outputs;
+    int64_t *due_deadlines;
+    int     *due_lines;
+    int     *due_values;
+    size_t  size;
+    size_t  capacity;
+    struct output_backend backend;
+    /** The number of wakeups. */
+    long    wakeups;
+    /** The number of changes of state. */
+    long    transitions;
+    /** The number of calls to the backend (that is, the number of ioctls, for a GPIO backend). */
+    long    commits;
+    /**
+     * The skew of the transitions due at the same instant: the time between the completion of the first and the
+     * last write (in nano seconds). With `set_values()`, the transitions are committed at once and the skew is 0.
+     */
+    struct histogram skew;
+    /** The sum and the maximum of the lateness of the wakeups (in nano seconds). */
+    int64_t lateness_sum;
+    int64_t lateness_max;
+};
+
+int scheduler_init(struct scheduler *scheduler, size_t capacity, const struct output_backend *backend);
+int scheduler_add(struct scheduler *scheduler, time_t duration_sec, long duration_nano_sec, long count, int line_id,
+                  struct line_stats *stats);
+int scheduler_run(struct scheduler *scheduler, int64_t epoch);
+void scheduler_terminate(struct scheduler *scheduler);
+
+#endif // SCHEDULER_H
@@ -0,0 +1,120 @@
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "stats.h"
+
+static struct line_stats ALL_STATS[STATS_MAX_LINES];
+static int ALL_STATS_COUNT = 0;
+
+/**
+ * Register a line to instrument.
+ * @param name The name of the line.
+ * @param line_id The (GPIO) line ID.
+ * @return The statistics of the line, or NULL if too many lines are registered.
+ */
+
+struct line_stats *stats_register(const char *name, int line_id) {
+    int index = __atomic_fetch_add(&ALL_STATS_COUNT, 1, __ATOMIC_ACQ_REL);
+    struct line_stats *stats;
+
+    if (index >= STATS_MAX_LINES) {
+        return NULL;
+    }
+    stats = &ALL_STATS[index];
+    strncpy(stats->name, name, STATS_NAME_SIZE - 1);
+    stats->name[STATS_NAME_SIZE - 1] = 0;
+    stats->line_id       = line_id;
+    stats->last_deadline = 0;
+    stats->last_done     = 0;
+    histogram_init(&stats->lateness);
+    __atomic_store_n(&stats->ready, 1, __ATOMIC_RELEASE);
+    return stats;
+}
+
+/**
+ * Record a cycle.
+ * @param stats The statistics of the line. If NULL, nothing is recorded.
+ * @param deadline The intended instant of the change of state.
+ * @param done The instant `gpiod_line_set_value()` returned.
+ */
+
+void stats_record(struct line_stats *stats, int64_t deadline, int64_t done) {
+    if (NULL == stats) {
+        return;
+    }
+    __atomic_store_n(&stats->last_deadline, deadline, __ATOMIC_RELAXED);
+    __atomic_store_n(&stats->last_done, done, __ATOMIC_RELAXED);
+    histogram_record(&stats->lateness, done - deadline);
+}
+
+/**
+ * Print the statistics of all registered lines. This function can be called while the lines are running.
+ * @param stream The stream to print to.
+ */
+
+void stats_dump(FILE *stream) {
+    int count = __atomic_load_n(&ALL_STATS_COUNT, __ATOMIC_ACQUIRE);
+
+    if (count > STATS_MAX_LINES) {
+        count = STATS_MAX_LINES;
+    }
+    for (int i=0; i<count; i++) {
+        char title[STATS_NAME_SIZE + 64];
+
+        if (!__atomic_load_n(&ALL_STATS[i].ready, __ATOMIC_ACQUIRE)) {
+            continue; // Registered, but not initialised yet.
+        }
+        snprintf(title, sizeof(title), "%.*s (line %d) output lateness (ns)",
+                 STATS_NAME_SIZE, ALL_STATS[i].name, ALL_STATS[i].line_id);
+        histogram_print(stream, title, &ALL_STATS[i].lateness);
+    }
+    fflush(stream);
+}
+
+static void* signal_thread(void *in_args) {
+    sigset_t *signals = (sigset_t*)in_args;
+    int signal;
+
+    for (;;) {
+        if (0 != sigwait(signals, &signal)) {
+            continue;
+        }
+        stats_dump(stdout);
+        if (SIGUSR1 != signal) {
+            // The other threads still use the lines: the exit handlers (ex: the reset of the GPIO, which closes the
+            // chip) must not run under them. The kernel releases the lines with the process.
+            _exit(1);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Start the thread that prints the statistics on SIGUSR1 (and on SIGINT or SIGTERM, before terminating the program
+ * immediately, with `_exit()`).
+ *
+ * The signals are blocked in the calling thread: this function must be called before any other thread is created,
+ * so that all threads inherit the mask and the signals are only delivered to the dedicated thread.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int stats_start_signal_thread(void) {
+    static sigset_t signals;
+    pthread_t thread;
+    int status;
+
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGUSR1);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    if (0 != (status = pthread_sigmask(SIG_BLOCK, &signals, NULL))
+        || 0 != (status = pthread_create(&thread, NULL, &signal_thread, &signals))) {
+        errno = status;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "histogram.h"
+
+/** The maximum number of lines that can be instrumented. */
+#define STATS_MAX_LINES 64
+#define STATS_NAME_SIZE 32
+
+/**
+ * Timing statistics of an output line.
+ *
+ * For every cycle, the owner of the line records the intended deadline of the change of state and the instant
+ * `gpiod_line_set_value()` returned. The difference (the lateness of the output) is aggregated into a histogram.
+ */
+
+struct line_stats {
+    char             name[STATS_NAME_SIZE];
+    int              line_id;
+    /** The deadline of the last recorded cycle (CLOCK_MONOTONIC, in nano seconds). */
+    int64_t          last_deadline;
+    /** The instant the value of the line was changed, for the last recorded cycle. */
+    int64_t          last_done;
+    /** The lateness of the changes of state (in nano seconds). */
+    struct histogram lateness;
+    /** Set (with release semantics) once the entry is initialised: `stats_dump()` skips the entries being filled. */
+    int              ready;
+};
+
+struct line_stats *stats_register(const char *name, int line_id);
+void stats_record(struct line_stats *stats, int64_t deadline, int64_t done);
+void stats_dump(FILE *stream);
+int stats_start_signal_thread(void);
+
+#endif // STATS_H
@@ -0,0 +1,39 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "text_file.h"
+
+/**
+ * Read a whole (small) text file.
+ * @param path The path of the file.
+ * @param max_size The maximum size of the file.
+ * @return The content of the file (to be freed), or NULL on error (EFBIG: the file is larger than `max_size`).
+ */
+
+char *read_text_file(const char *path, size_t max_size) {
+    FILE *file = fopen(path, "r");
+    char *text;
+    size_t size;
+    int status = 0;
+
+    if (NULL == file) {
+        return NULL;
+    }
+    // One more byte than allowed: a file that fills it is too large (a part of it would be a different content).
+    text = malloc(max_size + 1);
+    if (NULL != text) {
+        size = fread(text, 1, max_size + 1, file);
+        if (ferror(file) || size > max_size) {
+            status = ferror(file) ? EIO : EFBIG;
+            free(text);
+            text = NULL;
+        } else {
+            text[size] = '\0';
+        }
+    }
+    fclose(file);
+    if (0 != status) {
+        errno = status;
+    }
+    return text;
+}
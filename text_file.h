@@ -0,0 +1,10 @@
+#ifndef TEXT_FILE_H
+#define TEXT_FILE_H
+
+#include <stddef.h>
+
+// Reading of the small text files given on the command line (ex: a pattern, rules).
+
+char *read_text_file(const char *path, size_t max_size);
+
+#endif // TEXT_FILE_H
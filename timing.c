@@ -0,0 +1,224 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "timing.h"
+
+/**
+ * Return the current value of the monotonic clock.
+ * @return The current instant, in nano seconds.
+ */
+
+int64_t timing_now(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return timing_to_ns(&now);
+}
+
+/**
+ * Convert a `struct timespec` into a number of nano seconds.
+ * @param ts The value to convert.
+ * @return The number of nano seconds.
+ */
+
+int64_t timing_to_ns(const struct timespec *ts) {
+    return (int64_t)ts->tv_sec * NSEC_PER_SEC + ts->tv_nsec;
+}
+
+/**
+ * Convert a (positive) number of nano seconds into a `struct timespec`.
+ * @param ns The number of nano seconds.
+ * @param ts The converted value.
+ */
+
+void timing_from_ns(int64_t ns, struct timespec *ts) {
+    ts->tv_sec  = (time_t)(ns / NSEC_PER_SEC);
+    ts->tv_nsec = (long)(ns % NSEC_PER_SEC);
+}
+
+/**
+ * Sleep until a given instant.
+ * @param deadline The instant to wake up at (CLOCK_MONOTONIC, in nano seconds). If it is already over, the function
+ *        returns immediately.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int timing_sleep_until(int64_t deadline) {
+    struct timespec target;
+    int status;
+
+    timing_from_ns(deadline, &target);
+
+    // Unlike `nanosleep()`, the target is absolute: an interrupted wait is simply restarted.
+    while (0 != (status = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &target, NULL))) {
+        if (EINTR != status) {
+            errno = status;
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Sleep until a given margin before an instant, then busy-wait until the instant.
+ *
+ * The wakeup delay of the scheduler is absorbed by the margin, at the cost of keeping the CPU busy during the
+ * margin.
+ * @param deadline The instant to wake up at (CLOCK_MONOTONIC, in nano seconds).
+ * @param spin_margin The duration of the busy-wait, in nano seconds. If 0, the function only sleeps.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int timing_sleep_until_precise(int64_t deadline, int64_t spin_margin) {
+    if (spin_margin > 0 && timing_now() < deadline - spin_margin) {
+        if (-1 == timing_sleep_until(deadline - spin_margin)) {
+            return -1;
+        }
+    } else if (spin_margin <= 0) {
+        return timing_sleep_until(deadline);
+    }
+    while (timing_now() < deadline) {
+        // Busy-wait.
+    }
+    return 0;
+}
+
+/**
+ * Return the CPU time consumed by the calling thread.
+ * @return The CPU time, in nano seconds.
+ */
+
+int64_t timing_thread_cpu(void) {
+    struct timespec cpu;
+
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cpu);
+    return timing_to_ns(&cpu);
+}
+
+/**
+ * Parse a duration: a number of nano seconds, optionally followed by a unit ("ns", "us", "ms" or "s").
+ * @param text The text to parse.
+ * @param duration Receives the duration, in nano seconds.
+ * @return The end of the duration in `text`, or NULL if `text` does not start with a duration.
+ */
+
+const char *timing_parse_duration(const char *text, int64_t *duration) {
+    static const struct { const char *unit; int64_t scale; } all_units[] = {
+        { "ns", 1 }, { "us", 1000 }, { "ms", 1000000 }, { "s", NSEC_PER_SEC }
+    };
+    char *end;
+    long long value = strtoll(text, &end, 10);
+
+    if (end == text) {
+        return NULL;
+    }
+    *duration = value;
+    for (size_t i=0; i<sizeof(all_units)/sizeof(all_units[0]); i++) {
+        size_t length = strlen(all_units[i].unit);
+
+        if (0 == strncmp(end, all_units[i].unit, length)) {
+            *duration = value * all_units[i].scale;
+            return end + length;
+        }
+    }
+    return end;
+}
+
+/**
+ * Measure the overshoot of the sleeps, in order to calibrate the precision timing mode.
+ * @param samples The number of sleeps to perform.
+ * @return The margin to use with `timing_sleep_until_precise()`: the 99th percentile of the observed overshoots.
+ *         If the sleeps cannot be performed, the function returns -1.
+ */
+
+int64_t timing_calibrate(int samples) {
+    static struct histogram overshoot;
+    const int64_t sleep_duration = 200000; // 200 us
+
+    histogram_init(&overshoot);
+    for (int i=0; i<samples; i++) {
+        int64_t target = timing_now() + sleep_duration;
+
+        if (-1 == timing_sleep_until(target)) {
+            return -1;
+        }
+        histogram_record(&overshoot, timing_now() - target);
+    }
+    return histogram_percentile(&overshoot, 99.0);
+}
+
+/**
+ * Initialise a schedule.
+ * @param schedule The schedule to initialise.
+ * @param epoch The instant of cycle 0, as returned by `timing_now()`. Threads that share an epoch stay in phase.
+ * @param period_sec The number of seconds in a period.
+ * @param period_nano_sec The number of nano seconds in a period. This value must be in the range [0, 999999999].
+ */
+
+void deadline_init(struct deadline *schedule, int64_t epoch, time_t period_sec, long period_nano_sec) {
+    schedule->epoch        = epoch;
+    schedule->period       = (int64_t)period_sec * NSEC_PER_SEC + period_nano_sec;
+    schedule->cycle        = 1;
+    schedule->waits        = 0;
+    schedule->lateness_sum = 0;
+    schedule->lateness_max = 0;
+    schedule->spin_margin  = 0;
+    schedule->start        = timing_now();
+    schedule->cpu_start    = timing_thread_cpu();
+    histogram_init(&schedule->jitter);
+}
+
+/**
+ * Wait for the deadline of the next cycle.
+ *
+ * If the deadline is already over (the previous cycle took longer than a period), the function returns immediately:
+ * the schedule catches up instead of shifting.
+ * @param schedule The schedule.
+ * @param lateness If not NULL, receives the difference (in nano seconds) between the instant the wait returned
+ *        and the deadline.
+ * @return Upon successful completion, the function returns 0. Otherwise, it returns -1 and `errno` is set.
+ */
+
+int deadline_wait(struct deadline *schedule, int64_t *lateness) {
+    int64_t deadline = schedule->epoch + schedule->cycle * schedule->period;
+    int64_t late;
+
+    if (-1 == timing_sleep_until_precise(deadline, schedule->spin_margin)) {
+        return -1;
+    }
+
+    late = timing_now() - deadline;
+    schedule->cycle++;
+    schedule->waits++;
+    schedule->lateness_sum += late;
+    if (late > schedule->lateness_max) {
+        schedule->lateness_max = late;
+    }
+    histogram_record(&schedule->jitter, late);
+    if (NULL != lateness) {
+        *lateness = late;
+    }
+    return 0;
+}
+
+/**
+ * Print the lateness statistics of a schedule, and the CPU usage of the calling thread since the schedule was
+ * initialised.
+ * @param stream The stream to print to.
+ * @param name The name of the schedule.
+ * @param schedule The schedule.
+ */
+
+void deadline_print(FILE *stream, const char *name, const struct deadline *schedule) {
+    int64_t average = schedule->waits > 0 ? schedule->lateness_sum / schedule->waits : 0;
+    int64_t elapsed = timing_now() - schedule->start;
+    int64_t cpu     = timing_thread_cpu() - schedule->cpu_start;
+    char    title[128];
+
+    fprintf(stream, "%s: %ld cycles, lateness average %lld ns, max %lld ns, CPU %.2f%% (%s)\n",
+            name, schedule->waits, (long long)average, (long long)schedule->lateness_max,
+            elapsed > 0 ? 100.0 * (double)cpu / (double)elapsed : 0.0,
+            schedule->spin_margin > 0 ? "sleep then spin" : "sleep");
+    snprintf(title, sizeof(title), "%s lateness (ns)", name);
+    histogram_print(stream, title, &schedule->jitter);
+}
@@ -0,0 +1,60 @@
+#ifndef TIMING_H
+#define TIMING_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include "histogram.h"
+
+#define NSEC_PER_SEC 1000000000LL
+
+/** The number of sleeps performed to calibrate the precision timing mode. */
+#define CALIBRATION_SAMPLES 200
+
+/**
+ * Schedule of a periodic task, based on absolute deadlines.
+ *
+ * The deadline of cycle N is `epoch + N * period`. Since deadlines never depend on the time at which the
+ * previous wait returned, the delays introduced by the work done between two waits (printf, ioctl, wakeup...)
+ * do not accumulate: the loop stays phase-locked to the epoch, whatever the duration of the run.
+ */
+
+struct deadline {
+    /** The instant of cycle 0 (CLOCK_MONOTONIC, in nano seconds). */
+    int64_t epoch;
+    /** The period, in nano seconds. */
+    int64_t period;
+    /** The index of the cycle that will start when the next wait returns. */
+    long    cycle;
+    /** The number of waits. */
+    long    waits;
+    /** The sum of the lateness values (in nano seconds). */
+    int64_t lateness_sum;
+    /** The greatest lateness (in nano seconds). */
+    int64_t lateness_max;
+    /**
+     * Precision timing: the thread sleeps until `spin_margin` nano seconds before the deadline, then
+     * busy-waits. If 0, the thread only sleeps (see `timing_calibrate()`).
+     */
+    int64_t spin_margin;
+    /** The distribution of the lateness (in nano seconds). */
+    struct histogram jitter;
+    /** The instant the schedule was initialised and the CPU time consumed by the thread at that instant. */
+    int64_t start;
+    int64_t cpu_start;
+};
+
+int64_t timing_now(void);
+int64_t timing_to_ns(const struct timespec *ts);
+void timing_from_ns(int64_t ns, struct timespec *ts);
+int timing_sleep_until(int64_t deadline);
+int timing_sleep_until_precise(int64_t deadline, int64_t spin_margin);
+int64_t timing_thread_cpu(void);
+int64_t timing_calibrate(int samples);
+const char *timing_parse_duration(const char *text, int64_t *duration);
+
+void deadline_init(struct deadline *schedule, int64_t epoch, time_t period_sec, long period_nano_sec);
+int deadline_wait(struct deadline *schedule, int64_t *lateness);
+void deadline_print(FILE *stream, const char *name, const struct deadline *schedule);
+
+#endif // TIMING_H